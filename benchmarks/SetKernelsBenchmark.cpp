@@ -0,0 +1,76 @@
+/**
+ * Throughput of the sorted set kernels (see src/SetKernels.h),
+ * in input ids per second, for each instruction set the CPU supports
+ *
+ * usage: set-kernels-benchmark [set size] [repetitions]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "SetKernels.h"
+
+/**
+ * A random set of ids with roughly the given
+ * fraction of a range of the size ids / density
+ */
+static std::vector<uint32_t> randomSet(std::mt19937 &random, size_t size, double density) {
+    std::uniform_int_distribution<uint32_t> id(0, size / density);
+    std::vector<uint32_t> set;
+
+    for (size_t i = 0; i < size; i++) {
+        set.push_back(id(random));
+    }
+
+    std::sort(set.begin(), set.end());
+    set.erase(std::unique(set.begin(), set.end()), set.end());
+
+    return set;
+}
+
+int main(int argc, char **argv) {
+    using Clock = std::chrono::steady_clock;
+
+    size_t size = argc > 1 ? std::atol(argv[1]) : 100000;
+    unsigned int repetitions = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    std::mt19937 random(42);
+    std::vector<const SetKernels *> kernels = SetKernels::getSupported();
+
+    // sparse sets rarely share an id, dense ones mostly do
+    for (double density: { 0.01, 0.5 }) {
+        std::vector<uint32_t> a = randomSet(random, size, density);
+        std::vector<uint32_t> b = randomSet(random, size, density);
+        std::vector<uint32_t> out(a.size() + b.size());
+
+        std::printf("%zu and %zu ids, density %.2f\n", a.size(), b.size(), density);
+
+        for (auto const *kernel: kernels) {
+            auto measure = [&] (const char *name, size_t (*function)(const uint32_t *, size_t, const uint32_t *,
+                                                                    size_t, uint32_t *)) {
+                size_t result = 0;
+                Clock::time_point start = Clock::now();
+
+                for (unsigned int i = 0; i < repetitions; i++) {
+                    result += function(a.data(), a.size(), b.data(), b.size(), out.data());
+                }
+
+                double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                double throughput = (double)(a.size() + b.size()) * repetitions / seconds;
+
+                std::printf("  %-7s %-12s %8.1f M ids/s (%zu ids)\n",
+                            kernel->name, name, throughput / 1e6, result / repetitions);
+            };
+
+            measure("intersect", kernel->intersect);
+            measure("merge", kernel->merge);
+            measure("difference", kernel->difference);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#!/bin/bash
+# Process scaling of the distributed backend on Andersen.datalog,
+# against the native backend on a single thread
+#
+# usage: distributed.sh <DatalogAA.so> <module.ll> [process counts...]
+# (default process counts: 1 2 4 8)
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <DatalogAA.so> <module.ll> [process counts...]"
+    exit 1
+fi
+
+PLUGIN=$1
+MODULE=$2
+shift 2
+
+PROCESSES=${@:-1 2 4 8}
+OPT=${OPT:-opt}
+
+run() {
+    $OPT -load "$PLUGIN" -datalog-aa \
+         -datalog-aa-algorithm=andersen \
+         -datalog-aa-print-points-to=false \
+         -datalog-aa-print-stats \
+         -disable-output "$@" < "$MODULE" 2>&1
+}
+
+baseline=$(run -datalog-aa-backend=native | grep "^load: " | sed 's/load: \(.*\)s/\1/')
+echo "native: ${baseline}s"
+
+for n in $PROCESSES; do
+    output=$(run -datalog-aa-backend=distributed -datalog-aa-processes=$n)
+    time=$(echo "$output" | grep "^load: " | sed 's/load: \(.*\)s/\1/')
+    exchanged=$(echo "$output" | grep "^distributed evaluation: " | sed 's/.*, \(.*\) exchanged/\1/')
+
+    echo "$n process(es): ${time}s, speedup $(awk "BEGIN { printf \"%.2f\", $baseline / $time }")x, $exchanged exchanged"
+done
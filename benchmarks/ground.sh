@@ -0,0 +1,30 @@
+#!/bin/bash
+# Ground alias(a, b) queries asked one at a time vs in a batch,
+# on each backend that answers them
+#
+# usage: ground.sh <DatalogAA.so> <module.ll> [queries] [backends]
+# (default: 10000 queries, on the z3 native bdd and compiled backends)
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <DatalogAA.so> <module.ll> [queries] [backends]"
+    exit 1
+fi
+
+PLUGIN=$1
+MODULE=$2
+QUERIES=${3:-10000}
+BACKENDS=${4:-"z3 native bdd compiled"}
+OPT=${OPT:-opt}
+
+for backend in $BACKENDS; do
+    result=$($OPT -load "$PLUGIN" -datalog-aa \
+                  -datalog-aa-algorithm=andersen \
+                  -datalog-aa-backend=$backend \
+                  -datalog-aa-print-points-to=false \
+                  -datalog-aa-ground-queries=$QUERIES \
+                  -disable-output < "$MODULE" 2>&1 | grep "^ground queries: " | sed "s/ground queries: //")
+
+    echo "$backend: $result"
+done
@@ -0,0 +1,51 @@
+#!/bin/bash
+# Interpreted vs JIT-compiled join plans of the native backend on Andersen.datalog
+# (the plugin has to be built with -DDATALOG_AA_JIT=ON)
+#
+# usage: jit.sh <DatalogAA.so> <module.ll> [runs]
+# (default: 3 runs of each mode, the fastest is reported)
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <DatalogAA.so> <module.ll> [runs]"
+    exit 1
+fi
+
+PLUGIN=$1
+MODULE=$2
+RUNS=${3:-3}
+OPT=${OPT:-opt}
+
+run() {
+    $OPT -load "$PLUGIN" -datalog-aa \
+         -datalog-aa-algorithm=andersen \
+         -datalog-aa-backend=native \
+         -datalog-aa-print-points-to=false \
+         -datalog-aa-print-stats \
+         -disable-output "$@" < "$MODULE" 2>&1
+}
+
+# fastest value of a statistic over the runs
+best() {
+    local name=$1
+    shift
+
+    for i in $(seq $RUNS); do
+        run "$@" | grep "^$name: " | sed "s/$name: \([0-9.]*\)s.*/\1/"
+    done | sort -n | head -1
+}
+
+interpreted=$(best load)
+jit=$(best load -datalog-aa-jit)
+compilation=$(best "jit compilation" -datalog-aa-jit)
+
+if [ -z "$compilation" ]; then
+    echo "the plugin was built without DATALOG_AA_JIT"
+    exit 1
+fi
+
+echo "interpreted: ${interpreted}s"
+echo "jit: ${jit}s (compilation ${compilation}s, evaluation $(awk "BEGIN { printf \"%.3f\", $jit - $compilation }")s)"
+echo "speedup: $(awk "BEGIN { printf \"%.2f\", $interpreted / $jit }")x," \
+     "excluding compilation $(awk "BEGIN { printf \"%.2f\", $interpreted / ($jit - $compilation) }")x"
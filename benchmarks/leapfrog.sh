@@ -0,0 +1,48 @@
+#!/bin/bash
+# Pairwise joins vs leapfrog triejoin in the native backend on Andersen.datalog
+#
+# usage: leapfrog.sh <DatalogAA.so> <module.ll> [runs]
+# (default: 3 runs of each join strategy, the fastest is reported)
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <DatalogAA.so> <module.ll> [runs]"
+    exit 1
+fi
+
+PLUGIN=$1
+MODULE=$2
+RUNS=${3:-3}
+OPT=${OPT:-opt}
+
+run() {
+    $OPT -load "$PLUGIN" -datalog-aa \
+         -datalog-aa-algorithm=andersen \
+         -datalog-aa-backend=native \
+         -datalog-aa-print-points-to=false \
+         -datalog-aa-print-stats \
+         -disable-output "$@" < "$MODULE" 2>&1
+}
+
+# fastest value of a statistic over the runs
+best() {
+    local name=$1
+    shift
+
+    for i in $(seq $RUNS); do
+        run "$@" | grep "^$name: " | sed "s/$name: \([0-9.]*\)s.*/\1/"
+    done | sort -n | head -1
+}
+
+binary=$(best load -datalog-aa-join-strategy=binary)
+
+echo "binary: ${binary}s"
+
+for strategy in auto leapfrog; do
+    time=$(best load -datalog-aa-join-strategy=$strategy)
+    rules=$(run -datalog-aa-join-strategy=$strategy | grep "^leapfrog triejoin: " | sed "s/leapfrog triejoin: //")
+
+    echo "$strategy: ${time}s ($rules by leapfrog triejoin," \
+         "$(awk "BEGIN { printf \"%.2f\", $binary / $time }")x)"
+done
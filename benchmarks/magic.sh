@@ -0,0 +1,52 @@
+#!/bin/bash
+# Full evaluation vs magic-sets rewriting for the points-to and alias
+# sets of a single pointer (named as in the printed points-to relation)
+#
+# usage: magic.sh <DatalogAA.so> <module.ll> <value> [runs]
+# (default: 3 runs of each query, the fastest is reported;
+# the backend can be set with BACKEND, native by default)
+
+set -e
+
+if [ $# -lt 3 ]; then
+    echo "usage: $0 <DatalogAA.so> <module.ll> <value> [runs]"
+    exit 1
+fi
+
+PLUGIN=$1
+MODULE=$2
+VALUE=$3
+RUNS=${4:-3}
+OPT=${OPT:-opt}
+BACKEND=${BACKEND:-native}
+
+run() {
+    $OPT -load "$PLUGIN" -datalog-aa \
+         -datalog-aa-algorithm=andersen \
+         -datalog-aa-backend=$BACKEND \
+         -datalog-aa-print-points-to=false \
+         -datalog-aa-print-stats \
+         -datalog-aa-query="$VALUE" \
+         -disable-output "$@" < "$MODULE" 2>&1
+}
+
+# fastest value of a statistic (or the sum of
+# the values of several statistics) over the runs
+best() {
+    local pattern=$1
+    shift
+
+    for i in $(seq $RUNS); do
+        run "$@" | grep -E "^($pattern): " | sed "s/^[^:]*: \([0-9.]*\)s.*/\1/" | awk '{ s += $1 } END { print s }'
+    done | sort -n | head -1
+}
+
+full=$(best "load|query")
+
+for relation in pointsTo alias; do
+    magic=$(best "magic-sets query" -datalog-aa-query-relation=$relation)
+    answers=$(run -datalog-aa-query-relation=$relation | sed -n '/^=* query$/,/^=* query$/p' | grep -vc "^=" || true)
+
+    echo "$relation($VALUE, _): full evaluation ${full}s, magic sets ${magic}s" \
+         "($(awk "BEGIN { printf \"%.2f\", $full / $magic }")x, $answers answers)"
+done
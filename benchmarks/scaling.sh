@@ -0,0 +1,38 @@
+#!/bin/bash
+# Thread scaling of the native backend on Andersen.datalog
+#
+# usage: scaling.sh <DatalogAA.so> <module.ll> [thread counts...]
+# (default thread counts: 1 2 4 8 16)
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <DatalogAA.so> <module.ll> [thread counts...]"
+    exit 1
+fi
+
+PLUGIN=$1
+MODULE=$2
+shift 2
+
+THREADS=${@:-1 2 4 8 16}
+OPT=${OPT:-opt}
+
+baseline=
+
+for n in $THREADS; do
+    time=$($OPT -load "$PLUGIN" -datalog-aa \
+                -datalog-aa-algorithm=andersen \
+                -datalog-aa-backend=native \
+                -datalog-aa-threads=$n \
+                -datalog-aa-print-points-to=false \
+                -datalog-aa-print-stats \
+                -disable-output < "$MODULE" 2>&1 |
+           grep "^load: " | sed 's/load: \(.*\)s/\1/')
+
+    if [ -z "$baseline" ]; then
+        baseline=$time
+    fi
+
+    echo "$n thread(s): ${time}s, speedup $(awk "BEGIN { printf \"%.2f\", $baseline / $time }")x"
+done
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Points-to sets of any addressable object kept as a top vs derived
+# object by object, on modules with external globals or int-to-ptr casts
+#
+# usage: top.sh <DatalogAA.so> <module.ll> [runs]
+# (default: 3 runs of each, the fastest is reported;
+# the backend can be set with BACKEND, native by default)
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <DatalogAA.so> <module.ll> [runs]"
+    exit 1
+fi
+
+PLUGIN=$1
+MODULE=$2
+RUNS=${3:-3}
+OPT=${OPT:-opt}
+BACKEND=${BACKEND:-native}
+
+run() {
+    $OPT -load "$PLUGIN" -datalog-aa \
+         -datalog-aa-algorithm=andersen \
+         -datalog-aa-backend=$BACKEND \
+         -datalog-aa-print-points-to=false \
+         -datalog-aa-print-stats \
+         -disable-output "$@" < "$MODULE" 2>&1
+}
+
+# fastest value of a statistic over the runs
+best() {
+    local name=$1
+    shift
+
+    for i in $(seq $RUNS); do
+        run "$@" | grep "^$name: " | sed "s/$name: \([0-9.]*\)s.*/\1/"
+    done | sort -n | head -1
+}
+
+expanded=$(best load -datalog-aa-top-elements=false)
+tuples=$(run -datalog-aa-top-elements=false | grep "^points-to tuples: " | sed "s/points-to tuples: //")
+
+echo "expanded: ${expanded}s ($tuples points-to tuples)"
+
+time=$(best load)
+tuples=$(run | grep "^points-to tuples: " | sed "s/points-to tuples: //")
+
+echo "top: ${time}s ($tuples points-to tuples, $(awk "BEGIN { printf \"%.2f\", $expanded / $time }")x)"
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * A bump allocator whose memory is only freed all at once, when
+ * it's destroyed. Allocations never move, so pointers into them
+ * stay valid as long as the arena lives (even if it's moved)
+ */
+class Arena {
+    // chunks double in size up to the maximum (the constants have no
+    // definition, so they are only used by value, not by reference)
+    static const size_t MIN_CHUNK_SIZE = 1 << 12;
+    static const size_t MAX_CHUNK_SIZE = 1 << 20;
+    static const size_t ALIGNMENT = alignof(std::max_align_t);
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunk_size = MIN_CHUNK_SIZE;
+    char *next = nullptr;
+    size_t available = 0;
+    size_t num_bytes = 0; // of all chunks
+
+public:
+    Arena() {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t bytes) {
+        bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+        if (bytes > available) {
+            // larger allocations get a chunk of their own
+            size_t size = std::max(bytes, chunk_size);
+
+            chunks.emplace_back(new char[size]);
+            num_bytes += size;
+
+            if (size == bytes) {
+                return chunks.back().get();
+            }
+
+            chunk_size = std::min(chunk_size * 2, size_t(MAX_CHUNK_SIZE));
+
+            next = chunks.back().get();
+            available = size;
+        }
+
+        void *result = next;
+        next += bytes;
+        available -= bytes;
+
+        return result;
+    }
+
+    template<typename T>
+    T *allocate(size_t count) {
+        return static_cast<T *>(allocate(count * sizeof(T)));
+    }
+
+    size_t getMemoryUsage() const { return num_bytes; }
+};
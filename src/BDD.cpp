@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <cassert>
+
+#include "BDD.h"
+
+#define INITIAL_BUCKETS (1 << 16)
+#define FREE_VAR (~0u - 1)
+
+const BDDManager::Node BDDManager::ZERO;
+const BDDManager::Node BDDManager::ONE;
+const unsigned int BDDManager::TERMINAL_VAR;
+const BDDManager::Node BDDManager::NO_NODE;
+
+BDDManager::BDDManager(unsigned int num_vars): num_vars(num_vars) {
+    nodes.push_back({ TERMINAL_VAR, ZERO, ZERO, NO_NODE });
+    nodes.push_back({ TERMINAL_VAR, ONE, ONE, NO_NODE });
+    rehash(INITIAL_BUCKETS);
+}
+
+void BDDManager::setNumVars(unsigned int num_vars) {
+    assert(num_vars >= this->num_vars && "cannot remove variables");
+    this->num_vars = num_vars;
+}
+
+size_t BDDManager::hash(unsigned int a, unsigned int b, unsigned int c) {
+    size_t hash_value = a * 12582917ull + b * 4256249ull + c * 741457ull;
+    return hash_value ^ (hash_value >> 17);
+}
+
+void BDDManager::rehash(size_t num_buckets) {
+    buckets.assign(num_buckets, NO_NODE);
+
+    for (Node node = ONE + 1; node < nodes.size(); node++) {
+        NodeData &data = nodes[node];
+
+        if (data.var != FREE_VAR) {
+            size_t bucket = hash(data.var, data.low, data.high) & (num_buckets - 1);
+            data.next = buckets[bucket];
+            buckets[bucket] = node;
+        }
+    }
+
+    cache.assign(num_buckets, { OP_AND, NO_NODE, NO_NODE, NO_NODE, NO_NODE });
+}
+
+BDDManager::Node BDDManager::makeNode(unsigned int var, Node low, Node high) {
+    if (low == high) {
+        return low;
+    }
+
+    assert(var < num_vars && "variable out of range");
+    assert(var < nodes[low].var && var < nodes[high].var && "variable order violated");
+
+    size_t bucket = hash(var, low, high) & (buckets.size() - 1);
+
+    for (Node node = buckets[bucket]; node != NO_NODE; node = nodes[node].next) {
+        const NodeData &data = nodes[node];
+
+        if (data.var == var && data.low == low && data.high == high) {
+            return node;
+        }
+    }
+
+    Node node;
+
+    if (!free_nodes.empty()) {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[node] = { var, low, high, buckets[bucket] };
+    } else {
+        node = nodes.size();
+        nodes.push_back({ var, low, high, buckets[bucket] });
+    }
+
+    buckets[bucket] = node;
+
+    if (size() > buckets.size() * 2) {
+        // this also clears the cache, which is fine since
+        // the callers of makeNode only insert results after
+        rehash(buckets.size() * 2);
+    }
+
+    return node;
+}
+
+bool BDDManager::lookupCache(unsigned int op, Node a, Node b, Node c, Node &result) const {
+    const CacheEntry &entry = cache[hash(a, b, c + op) & (cache.size() - 1)];
+
+    if (entry.op == op && entry.a == a && entry.b == b && entry.c == c) {
+        result = entry.result;
+        return true;
+    }
+
+    return false;
+}
+
+void BDDManager::insertCache(unsigned int op, Node a, Node b, Node c, Node result) {
+    cache[hash(a, b, c + op) & (cache.size() - 1)] = { op, a, b, c, result };
+}
+
+BDDManager::Node BDDManager::ithVar(unsigned int var) {
+    return makeNode(var, ZERO, ONE);
+}
+
+BDDManager::Node BDDManager::nithVar(unsigned int var) {
+    return makeNode(var, ONE, ZERO);
+}
+
+BDDManager::Node BDDManager::cube(std::vector<unsigned int> vars) {
+    std::sort(vars.begin(), vars.end());
+
+    Node result = ONE;
+
+    for (auto it = vars.rbegin(); it != vars.rend(); it++) {
+        result = makeNode(*it, ZERO, result);
+    }
+
+    return result;
+}
+
+BDDManager::Node BDDManager::applyAnd(Node a, Node b) {
+    return apply(OP_AND, a, b);
+}
+
+BDDManager::Node BDDManager::applyOr(Node a, Node b) {
+    return apply(OP_OR, a, b);
+}
+
+BDDManager::Node BDDManager::applyDiff(Node a, Node b) {
+    return apply(OP_DIFF, a, b);
+}
+
+BDDManager::Node BDDManager::apply(Operation op, Node a, Node b) {
+    switch (op) {
+        case OP_AND:
+            if (a == ZERO || b == ZERO) return ZERO;
+            if (a == ONE || a == b) return b;
+            if (b == ONE) return a;
+            if (a > b) std::swap(a, b);
+            break;
+
+        case OP_OR:
+            if (a == ONE || b == ONE) return ONE;
+            if (a == ZERO || a == b) return b;
+            if (b == ZERO) return a;
+            if (a > b) std::swap(a, b);
+            break;
+
+        case OP_DIFF:
+            if (a == ZERO || b == ONE || a == b) return ZERO;
+            if (b == ZERO) return a;
+            break;
+
+        default:
+            assert(0 && "not a binary operation");
+    }
+
+    Node result;
+
+    if (lookupCache(op, a, b, 0, result)) {
+        return result;
+    }
+
+    unsigned int var = std::min(nodes[a].var, nodes[b].var);
+
+    Node a_low = nodes[a].var == var ? nodes[a].low : a;
+    Node a_high = nodes[a].var == var ? nodes[a].high : a;
+    Node b_low = nodes[b].var == var ? nodes[b].low : b;
+    Node b_high = nodes[b].var == var ? nodes[b].high : b;
+
+    Node low = apply(op, a_low, b_low);
+    Node high = apply(op, a_high, b_high);
+
+    result = makeNode(var, low, high);
+    insertCache(op, a, b, 0, result);
+
+    return result;
+}
+
+BDDManager::Node BDDManager::ite(Node f, Node g, Node h) {
+    if (f == ONE) return g;
+    if (f == ZERO) return h;
+    if (g == h) return g;
+    if (g == ONE && h == ZERO) return f;
+    if (g == ZERO && h == ONE) return applyNot(f);
+    if (g == ONE) return applyOr(f, h);
+    if (h == ZERO) return applyAnd(f, g);
+
+    Node result;
+
+    if (lookupCache(OP_ITE, f, g, h, result)) {
+        return result;
+    }
+
+    unsigned int var = std::min(nodes[f].var, std::min(nodes[g].var, nodes[h].var));
+
+    auto low_of = [&] (Node node) { return nodes[node].var == var ? nodes[node].low : node; };
+    auto high_of = [&] (Node node) { return nodes[node].var == var ? nodes[node].high : node; };
+
+    Node low = ite(low_of(f), low_of(g), low_of(h));
+    Node high = ite(high_of(f), high_of(g), high_of(h));
+
+    result = makeNode(var, low, high);
+    insertCache(OP_ITE, f, g, h, result);
+
+    return result;
+}
+
+BDDManager::Node BDDManager::exists(Node f, Node cube) {
+    if (isTerminal(f)) {
+        return f;
+    }
+
+    // skip quantified variables above f
+    while (cube != ONE && nodes[cube].var < nodes[f].var) {
+        cube = nodes[cube].high;
+    }
+
+    if (cube == ONE) {
+        return f;
+    }
+
+    Node result;
+
+    if (lookupCache(OP_EXISTS, f, cube, 0, result)) {
+        return result;
+    }
+
+    const NodeData &data = nodes[f];
+    unsigned int var = data.var;
+    Node low_of_f = data.low, high_of_f = data.high;
+
+    if (var == nodes[cube].var) {
+        Node rest = nodes[cube].high;
+        Node low = exists(low_of_f, rest);
+
+        result = low == ONE ? ONE : applyOr(low, exists(high_of_f, rest));
+    } else {
+        Node low = exists(low_of_f, cube);
+        Node high = exists(high_of_f, cube);
+        result = makeNode(var, low, high);
+    }
+
+    insertCache(OP_EXISTS, f, cube, 0, result);
+
+    return result;
+}
+
+BDDManager::Node BDDManager::relprod(Node f, Node g, Node cube) {
+    if (f == ZERO || g == ZERO) return ZERO;
+    if (f == ONE) return exists(g, cube);
+    if (g == ONE || f == g) return exists(f, cube);
+
+    if (f > g) {
+        std::swap(f, g);
+    }
+
+    unsigned int var = std::min(nodes[f].var, nodes[g].var);
+
+    while (cube != ONE && nodes[cube].var < var) {
+        cube = nodes[cube].high;
+    }
+
+    if (cube == ONE) {
+        return applyAnd(f, g);
+    }
+
+    Node result;
+
+    if (lookupCache(OP_RELPROD, f, g, cube, result)) {
+        return result;
+    }
+
+    Node f_low = nodes[f].var == var ? nodes[f].low : f;
+    Node f_high = nodes[f].var == var ? nodes[f].high : f;
+    Node g_low = nodes[g].var == var ? nodes[g].low : g;
+    Node g_high = nodes[g].var == var ? nodes[g].high : g;
+
+    if (var == nodes[cube].var) {
+        Node rest = nodes[cube].high;
+        Node low = relprod(f_low, g_low, rest);
+
+        result = low == ONE ? ONE : applyOr(low, relprod(f_high, g_high, rest));
+    } else {
+        Node low = relprod(f_low, g_low, cube);
+        Node high = relprod(f_high, g_high, cube);
+        result = makeNode(var, low, high);
+    }
+
+    insertCache(OP_RELPROD, f, g, cube, result);
+
+    return result;
+}
+
+unsigned int BDDManager::addPermutation(const std::vector<unsigned int> &target) {
+    assert(target.size() <= num_vars && "permutation out of range");
+    permutations.push_back(target);
+    return permutations.size() - 1;
+}
+
+BDDManager::Node BDDManager::replace(Node f, unsigned int permutation) {
+    if (isTerminal(f)) {
+        return f;
+    }
+
+    Node result;
+
+    if (lookupCache(OP_REPLACE, f, permutation, 0, result)) {
+        return result;
+    }
+
+    const std::vector<unsigned int> &target = permutations[permutation];
+    unsigned int var = nodes[f].var;
+    unsigned int new_var = var < target.size() ? target[var] : var;
+
+    Node low = replace(nodes[f].low, permutation);
+    Node high = replace(nodes[f].high, permutation);
+
+    // the new variable may be anywhere in the order
+    result = ite(ithVar(new_var), high, low);
+    insertCache(OP_REPLACE, f, permutation, 0, result);
+
+    return result;
+}
+
+void BDDManager::forEachSat(Node f, const std::vector<unsigned int> &vars,
+                            const std::function<void (const std::vector<bool> &)> &callback) {
+    std::vector<bool> assignment(vars.size());
+    forEachSatRec(f, vars, 0, assignment, callback);
+}
+
+void BDDManager::forEachSatRec(Node f, const std::vector<unsigned int> &vars, unsigned int index,
+                               std::vector<bool> &assignment,
+                               const std::function<void (const std::vector<bool> &)> &callback) {
+    if (f == ZERO) {
+        return;
+    }
+
+    if (index == vars.size()) {
+        assert(f == ONE && "support is not a subset of the variables");
+        callback(assignment);
+        return;
+    }
+
+    assert(nodes[f].var >= vars[index] && "support is not a subset of the variables");
+
+    if (nodes[f].var == vars[index]) {
+        assignment[index] = false;
+        forEachSatRec(nodes[f].low, vars, index + 1, assignment, callback);
+        assignment[index] = true;
+        forEachSatRec(nodes[f].high, vars, index + 1, assignment, callback);
+    } else {
+        // don't care
+        assignment[index] = false;
+        forEachSatRec(f, vars, index + 1, assignment, callback);
+        assignment[index] = true;
+        forEachSatRec(f, vars, index + 1, assignment, callback);
+    }
+}
+
+void BDDManager::collectGarbage(const std::vector<Node> &roots) {
+    std::vector<bool> marked(nodes.size(), false);
+    std::vector<Node> stack(roots.begin(), roots.end());
+
+    marked[ZERO] = marked[ONE] = true;
+
+    while (!stack.empty()) {
+        Node node = stack.back();
+        stack.pop_back();
+
+        if (marked[node]) {
+            continue;
+        }
+
+        marked[node] = true;
+        stack.push_back(nodes[node].low);
+        stack.push_back(nodes[node].high);
+    }
+
+    for (Node node = ONE + 1; node < nodes.size(); node++) {
+        if (!marked[node] && nodes[node].var != FREE_VAR) {
+            nodes[node].var = FREE_VAR;
+            free_nodes.push_back(node);
+        }
+    }
+
+    // rebuild the unique table without the freed nodes
+    // and drop all cached results referring to them
+    rehash(buckets.size());
+}
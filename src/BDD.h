@@ -0,0 +1,141 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+/**
+ * A small reduced ordered BDD package
+ *
+ * Nodes are shared through a unique table and identified
+ * by their index. Variables are identified by their level,
+ * so the variable order is fixed by whoever allocates them.
+ * Results of the recursive operations are memoized in a
+ * direct-mapped operation cache
+ *
+ * There is no reference counting: nodes are only reclaimed
+ * by collectGarbage, which keeps everything reachable from
+ * the given roots
+ */
+class BDDManager {
+public:
+    using Node = unsigned int;
+
+    static const Node ZERO = 0;
+    static const Node ONE = 1;
+
+private:
+    static const unsigned int TERMINAL_VAR = ~0u;
+    static const Node NO_NODE = ~0u;
+
+    struct NodeData {
+        unsigned int var;
+        Node low;
+        Node high;
+        Node next; // next node in the same bucket of the unique table
+    };
+
+    enum Operation {
+        OP_AND,
+        OP_OR,
+        OP_DIFF,
+        OP_ITE,
+        OP_EXISTS,
+        OP_RELPROD,
+        OP_REPLACE,
+    };
+
+    struct CacheEntry {
+        unsigned int op;
+        Node a, b, c;
+        Node result;
+    };
+
+    unsigned int num_vars;
+
+    std::vector<NodeData> nodes;
+    std::vector<Node> buckets;
+    std::vector<Node> free_nodes;
+
+    std::vector<CacheEntry> cache;
+
+    // variable substitutions registered for replace
+    std::vector<std::vector<unsigned int>> permutations;
+
+public:
+    BDDManager(unsigned int num_vars = 0);
+
+    unsigned int getNumVars() const { return num_vars; }
+    void setNumVars(unsigned int num_vars);
+
+    /**
+     * Number of live nodes (including the terminals)
+     */
+    size_t size() const { return nodes.size() - free_nodes.size(); }
+
+    bool isTerminal(Node node) const { return node <= ONE; }
+    unsigned int getVar(Node node) const { return nodes[node].var; }
+    Node getLow(Node node) const { return nodes[node].low; }
+    Node getHigh(Node node) const { return nodes[node].high; }
+
+    Node ithVar(unsigned int var);
+    Node nithVar(unsigned int var);
+
+    /**
+     * Conjunction of all (positive) variables, used
+     * to specify the variables to quantify
+     */
+    Node cube(std::vector<unsigned int> vars);
+
+    Node applyAnd(Node a, Node b);
+    Node applyOr(Node a, Node b);
+    Node applyDiff(Node a, Node b); // a and not b
+    Node applyNot(Node a) { return applyDiff(ONE, a); }
+    Node ite(Node f, Node g, Node h);
+
+    Node exists(Node f, Node cube);
+
+    /**
+     * Relational product: exists cube. (f and g)
+     */
+    Node relprod(Node f, Node g, Node cube);
+
+    /**
+     * Register a simultaneous substitution of variables
+     * (var -> target[var]) to be used with replace
+     */
+    unsigned int addPermutation(const std::vector<unsigned int> &target);
+    Node replace(Node f, unsigned int permutation);
+
+    /**
+     * Enumerate all satisfying assignments over the given
+     * variables (in ascending order). The support of f
+     * must be a subset of vars
+     */
+    void forEachSat(Node f, const std::vector<unsigned int> &vars,
+                    const std::function<void (const std::vector<bool> &)> &callback);
+
+    /**
+     * Free all nodes not reachable from the roots.
+     * Node ids of the remaining nodes do not change
+     */
+    void collectGarbage(const std::vector<Node> &roots);
+
+private:
+    Node makeNode(unsigned int var, Node low, Node high);
+
+    Node apply(Operation op, Node a, Node b);
+
+    void forEachSatRec(Node f, const std::vector<unsigned int> &vars, unsigned int index,
+                       std::vector<bool> &assignment,
+                       const std::function<void (const std::vector<bool> &)> &callback);
+
+    static size_t hash(unsigned int a, unsigned int b, unsigned int c);
+
+    /**
+     * Grow the unique table (and the cache along with it)
+     */
+    void rehash(size_t num_buckets);
+
+    bool lookupCache(unsigned int op, Node a, Node b, Node c, Node &result) const;
+    void insertCache(unsigned int op, Node a, Node b, Node c, Node result);
+};
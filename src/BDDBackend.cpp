@@ -0,0 +1,637 @@
+#include <algorithm>
+#include <cassert>
+#include <set>
+#include <sstream>
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include "BDDBackend.h"
+
+// collect garbage when the number of nodes
+// doubles since the last collection
+#define MIN_GC_THRESHOLD (1 << 20)
+
+unsigned int BDDBackend::getBitWidth(unsigned int size) {
+    unsigned int width = 1;
+
+    while (width < 32 && (size >> width) != 0) {
+        width++;
+    }
+
+    return width;
+}
+
+/**
+ * Domains and variable ordering
+ */
+
+void BDDBackend::initDomains(const StandardDatalog::Program &program) {
+    // number of physical domains each sort needs
+    std::map<std::string, unsigned int> num_domains;
+
+    for (auto const &item: program.getRelations()) {
+        std::map<std::string, unsigned int> count;
+
+        for (auto const &sort_name: item.second.getArgumentSortNames()) {
+            num_domains[sort_name] = std::max(num_domains[sort_name], ++count[sort_name]);
+        }
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        std::map<std::string, std::string> var_sorts;
+
+        auto collect = [&] (const StandardDatalog::Formula &atom) {
+            const StandardDatalog::Relation &relation = program.getRelation(atom.getRelationName());
+
+            for (unsigned int i = 0; i < atom.getArity(); i++) {
+                if (atom.getArgument(i).isVariable()) {
+                    const std::string &sort_name = relation.getArgumentSortName(i);
+                    auto inserted = var_sorts.insert(std::make_pair(atom.getArgument(i).getVariable(), sort_name));
+                    assert(inserted.first->second == sort_name && "variable used with different sorts");
+                }
+            }
+        };
+
+        collect(formula);
+
+        for (auto const &atom: formula.getBody()) {
+            collect(atom);
+        }
+
+        std::map<std::string, unsigned int> count;
+
+        for (auto const &item: var_sorts) {
+            num_domains[item.second] = std::max(num_domains[item.second], ++count[item.second]);
+        }
+    }
+
+    std::map<std::string, unsigned int> domain_ids;
+
+    for (auto const &item: num_domains) {
+        const StandardDatalog::Sort &sort = program.getSorts().at(item.first);
+        unsigned int width = getBitWidth(sort.getSize());
+
+        for (unsigned int i = 0; i < item.second; i++) {
+            Domain domain;
+            domain.name = item.first + std::to_string(i);
+            domain.bits.resize(width);
+
+            domain_ids[domain.name] = domains.size();
+            sort_domains[item.first].push_back(domains.size());
+            domains.push_back(domain);
+        }
+    }
+
+    // parse the ordering into groups of interleaved domains
+    std::vector<std::vector<unsigned int>> groups;
+    std::set<unsigned int> ordered;
+    std::stringstream group_stream(ordering);
+    std::string group_text;
+
+    while (std::getline(group_stream, group_text, '_')) {
+        std::stringstream domain_stream(group_text);
+        std::string domain_name;
+        std::vector<unsigned int> group;
+
+        while (std::getline(domain_stream, domain_name, 'x')) {
+            auto found = domain_ids.find(domain_name);
+
+            if (found == domain_ids.end() || ordered.count(found->second)) {
+                std::string names;
+
+                for (auto const &domain: domains) {
+                    names += (names.empty() ? "" : ", ") + domain.name;
+                }
+
+                llvm::report_fatal_error("domain " + domain_name +
+                                         (found == domain_ids.end() ? " does not exist" : " is ordered twice") +
+                                         " in the BDD variable ordering (the domains are " + names + ")", false);
+            }
+
+            group.push_back(found->second);
+            ordered.insert(found->second);
+        }
+
+        if (!group.empty()) {
+            groups.push_back(group);
+        }
+    }
+
+    for (auto const &item: sort_domains) {
+        std::vector<unsigned int> group;
+
+        for (unsigned int domain: item.second) {
+            if (ordered.find(domain) == ordered.end()) {
+                group.push_back(domain);
+            }
+        }
+
+        if (!group.empty()) {
+            groups.push_back(group);
+        }
+    }
+
+    // interleave bits within a group, starting from the most significant bit
+    unsigned int num_vars = 0;
+
+    for (auto const &group: groups) {
+        unsigned int width = 0;
+
+        for (unsigned int domain: group) {
+            width = std::max(width, (unsigned int)domains[domain].bits.size());
+        }
+
+        for (unsigned int bit = 0; bit < width; bit++) {
+            for (unsigned int domain: group) {
+                if (bit < domains[domain].bits.size()) {
+                    domains[domain].bits[bit] = num_vars++;
+                }
+            }
+        }
+    }
+
+    manager.setNumVars(num_vars);
+
+    for (auto &domain: domains) {
+        domain.cube = manager.cube(domain.bits);
+        pinned.push_back(domain.cube);
+    }
+}
+
+void BDDBackend::initRelations(const StandardDatalog::Program &program) {
+    for (auto const &item: program.getRelations()) {
+        Relation relation;
+        std::map<std::string, unsigned int> count;
+
+        // the i-th column of a sort is stored on the i-th domain of the sort
+        for (auto const &sort_name: item.second.getArgumentSortNames()) {
+            unsigned int domain = sort_domains.at(sort_name).at(count[sort_name]++);
+            relation.columns.push_back(domain);
+            relation.vars.insert(relation.vars.end(),
+                                 domains[domain].bits.begin(), domains[domain].bits.end());
+        }
+
+        std::sort(relation.vars.begin(), relation.vars.end());
+
+        relation_ids[item.first] = relations.size();
+        relations.push_back(relation);
+    }
+}
+
+BDDBackend::Node BDDBackend::encode(unsigned int domain, unsigned int value) {
+    const std::vector<unsigned int> &bits = domains[domain].bits;
+    assert((bits.size() >= 32 || (value >> bits.size()) == 0) && "value out of range");
+
+    Node result = BDDManager::ONE;
+
+    for (unsigned int i = 0; i < bits.size(); i++) {
+        bool bit = (value >> (bits.size() - 1 - i)) & 1;
+        result = manager.applyAnd(result, bit ? manager.ithVar(bits[i]) : manager.nithVar(bits[i]));
+    }
+
+    return result;
+}
+
+BDDBackend::Node BDDBackend::encodeTuple(const Relation &relation, const StandardDatalog::Formula &atom) {
+    assert(atom.getArity() == relation.columns.size() &&
+           "number of terms does not match the arity");
+
+    Node result = BDDManager::ONE;
+
+    for (unsigned int i = 0; i < atom.getArity(); i++) {
+        assert(!atom.getArgument(i).isVariable() && "tuple must be ground");
+        result = manager.applyAnd(result, encode(relation.columns[i], atom.getArgument(i).getValue()));
+    }
+
+    return result;
+}
+
+BDDBackend::Node BDDBackend::encodeTuple(const Relation &relation, const unsigned int *row) {
+    Node result = BDDManager::ONE;
+
+    for (unsigned int i = 0; i < relation.columns.size(); i++) {
+        result = manager.applyAnd(result, encode(relation.columns[i], row[i]));
+    }
+
+    return result;
+}
+
+BDDBackend::Node BDDBackend::equal(unsigned int domain_a, unsigned int domain_b) {
+    const std::vector<unsigned int> &bits_a = domains[domain_a].bits;
+    const std::vector<unsigned int> &bits_b = domains[domain_b].bits;
+    assert(bits_a.size() == bits_b.size() && "domains of different sizes");
+
+    Node result = BDDManager::ONE;
+
+    for (unsigned int i = 0; i < bits_a.size(); i++) {
+        Node same = manager.ite(manager.ithVar(bits_a[i]),
+                                manager.ithVar(bits_b[i]),
+                                manager.nithVar(bits_b[i]));
+        result = manager.applyAnd(result, same);
+    }
+
+    return result;
+}
+
+/**
+ * Loading and compiling rules
+ */
+
+void BDDBackend::load(const StandardDatalog::Program &program) {
+    manager = BDDManager();
+    sort_domains.clear();
+    domains.clear();
+    relation_ids.clear();
+    relations.clear();
+    rules.clear();
+    pinned.clear();
+
+    initDomains(program);
+    initRelations(program);
+
+    // union the facts of each relation pairwise, which
+    // is much cheaper than adding them one by one
+    std::vector<std::vector<Node>> facts(relations.size());
+
+    for (auto const &item: program.getFacts()) {
+        unsigned int relation = relation_ids.at(item.first);
+
+        for (size_t i = 0; i < item.second->size(); i++) {
+            facts[relation].push_back(encodeTuple(relations[relation], item.second->getRow(i)));
+        }
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        compileRule(program, formula);
+    }
+
+    for (unsigned int i = 0; i < relations.size(); i++) {
+        std::vector<Node> &pending = facts[i];
+
+        while (pending.size() > 1) {
+            for (size_t j = 0; j + 1 < pending.size(); j += 2) {
+                pending[j / 2] = manager.applyOr(pending[j], pending[j + 1]);
+            }
+
+            if (pending.size() % 2 == 1) {
+                pending[pending.size() / 2] = pending.back();
+                pending.resize(pending.size() / 2 + 1);
+            } else {
+                pending.resize(pending.size() / 2);
+            }
+        }
+
+        if (!pending.empty()) {
+            relations[i].full = pending[0];
+        }
+    }
+
+    for (auto const &stratum: program.getStrata()) {
+        evaluateStratum(stratum);
+    }
+}
+
+BDDBackend::Atom BDDBackend::compileAtom(const StandardDatalog::Program &program,
+                                         std::map<std::string, unsigned int> &var_domains,
+                                         const StandardDatalog::Formula &atom,
+                                         bool is_head) {
+    auto found = relation_ids.find(atom.getRelationName());
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    const StandardDatalog::Relation &declaration = program.getRelation(atom.getRelationName());
+    const Relation &relation = relations[found->second];
+
+    assert(atom.getArity() == relation.columns.size() &&
+           "number of terms does not match the arity");
+
+    Atom compiled;
+    compiled.relation = found->second;
+    compiled.negated = atom.isNegated();
+    compiled.constraint = BDDManager::ONE;
+
+    std::vector<unsigned int> quantified;
+    std::vector<unsigned int> renaming(manager.getNumVars());
+    std::map<std::string, unsigned int> first_column;
+
+    for (unsigned int var = 0; var < renaming.size(); var++) {
+        renaming[var] = var;
+    }
+
+    for (unsigned int col = 0; col < atom.getArity(); col++) {
+        const StandardDatalog::Term &term = atom.getArgument(col);
+        unsigned int column_domain = relation.columns[col];
+
+        if (!term.isVariable()) {
+            compiled.constraint = manager.applyAnd(compiled.constraint, encode(column_domain, term.getValue()));
+            quantified.insert(quantified.end(),
+                              domains[column_domain].bits.begin(), domains[column_domain].bits.end());
+            continue;
+        }
+
+        auto first = first_column.find(term.getVariable());
+
+        if (first != first_column.end()) {
+            // repeated variable
+            unsigned int first_domain = relation.columns[first->second];
+            compiled.constraint = manager.applyAnd(compiled.constraint, equal(first_domain, column_domain));
+            quantified.insert(quantified.end(),
+                              domains[column_domain].bits.begin(), domains[column_domain].bits.end());
+            continue;
+        }
+
+        first_column[term.getVariable()] = col;
+
+        auto var_domain = var_domains.find(term.getVariable());
+
+        if (var_domain == var_domains.end()) {
+            assert(!is_head && "variables in the head must appear in the body");
+
+            // the next unused domain of the sort
+            const std::vector<unsigned int> &candidates =
+                sort_domains.at(declaration.getArgumentSortName(col));
+            unsigned int used = 0;
+
+            for (auto const &item: var_domains) {
+                used += std::find(candidates.begin(), candidates.end(), item.second) != candidates.end();
+            }
+
+            var_domain = var_domains.insert(std::make_pair(term.getVariable(), candidates.at(used))).first;
+        }
+
+        const std::vector<unsigned int> &column_bits = domains[column_domain].bits;
+        const std::vector<unsigned int> &var_bits = domains[var_domain->second].bits;
+
+        for (unsigned int i = 0; i < column_bits.size(); i++) {
+            if (is_head) {
+                renaming[var_bits[i]] = column_bits[i];
+            } else {
+                renaming[column_bits[i]] = var_bits[i];
+            }
+        }
+    }
+
+    compiled.quantified = manager.cube(quantified);
+    compiled.renaming = manager.addPermutation(renaming);
+
+    pinned.push_back(compiled.constraint);
+    pinned.push_back(compiled.quantified);
+
+    return compiled;
+}
+
+void BDDBackend::compileRule(const StandardDatalog::Program &program,
+                             const StandardDatalog::Formula &formula) {
+    std::map<std::string, unsigned int> var_domains;
+    Rule rule;
+
+    // positive atoms first so that they bind all the variables
+    std::vector<const StandardDatalog::Formula *> body;
+
+    for (auto const &atom: formula.getBody()) {
+        if (!atom.isNegated()) {
+            body.push_back(&atom);
+        }
+    }
+
+    unsigned int num_positive = body.size();
+
+    for (auto const &atom: formula.getBody()) {
+        if (atom.isNegated()) {
+            body.push_back(&atom);
+        }
+    }
+
+    for (auto const *atom: body) {
+        rule.body.push_back(compileAtom(program, var_domains, *atom, false));
+    }
+
+    unsigned int num_vars = var_domains.size();
+    rule.head = compileAtom(program, var_domains, formula, true);
+
+    assert(var_domains.size() == num_vars &&
+           "variables in the head or negated atoms must appear in a positive atom");
+
+    // a variable can be quantified after the last positive atom
+    // using it, unless it's also used in a negated atom (then after
+    // the negated atoms) or in the head
+    std::map<std::string, unsigned int> last_use;
+
+    for (unsigned int i = 0; i < body.size(); i++) {
+        for (auto const &term: body[i]->getArguments()) {
+            if (term.isVariable()) {
+                last_use[term.getVariable()] = std::min(i, num_positive);
+            }
+        }
+    }
+
+    for (auto const &term: formula.getArguments()) {
+        if (term.isVariable()) {
+            last_use.erase(term.getVariable());
+        }
+    }
+
+    std::vector<std::vector<unsigned int>> quantify_after(num_positive + 1);
+
+    for (auto const &item: last_use) {
+        const std::vector<unsigned int> &bits = domains[var_domains.at(item.first)].bits;
+        quantify_after[item.second].insert(quantify_after[item.second].end(), bits.begin(), bits.end());
+    }
+
+    for (auto const &vars: quantify_after) {
+        rule.quantify_after.push_back(manager.cube(vars));
+        pinned.push_back(rule.quantify_after.back());
+    }
+
+    rules.push_back(rule);
+}
+
+/**
+ * Evaluation
+ */
+
+BDDBackend::Node BDDBackend::evaluateAtom(const Atom &atom, Node source) {
+    Node constrained = manager.relprod(source, atom.constraint, atom.quantified);
+    return manager.replace(constrained, atom.renaming);
+}
+
+BDDBackend::Node BDDBackend::evaluateRule(const Rule &rule, int delta_atom) {
+    Node result = BDDManager::ONE;
+    unsigned int i = 0;
+
+    for (; i < rule.body.size() && !rule.body[i].negated; i++) {
+        const Atom &atom = rule.body[i];
+        const Relation &relation = relations[atom.relation];
+        Node source = (int)i == delta_atom ? relation.delta : relation.full;
+
+        result = manager.relprod(result, evaluateAtom(atom, source), rule.quantify_after[i]);
+
+        if (result == BDDManager::ZERO) {
+            return result;
+        }
+    }
+
+    for (; i < rule.body.size(); i++) {
+        const Atom &atom = rule.body[i];
+        result = manager.applyDiff(result, evaluateAtom(atom, relations[atom.relation].full));
+    }
+
+    result = manager.exists(result, rule.quantify_after.back());
+    result = manager.replace(result, rule.head.renaming);
+
+    return manager.applyAnd(result, rule.head.constraint);
+}
+
+void BDDBackend::evaluateStratum(const StandardDatalog::Stratum &stratum) {
+    std::set<unsigned int> members;
+
+    for (auto const &name: stratum.relations) {
+        members.insert(relation_ids.at(name));
+    }
+
+    std::vector<const Rule *> base_rules;
+    std::vector<std::pair<const Rule *, unsigned int>> delta_rules;
+
+    for (auto const &rule: rules) {
+        if (members.find(rule.head.relation) == members.end()) {
+            continue;
+        }
+
+        bool recursive = false;
+
+        for (unsigned int i = 0; i < rule.body.size(); i++) {
+            if (members.find(rule.body[i].relation) != members.end()) {
+                assert(!rule.body[i].negated && "negation cannot be stratified");
+                delta_rules.push_back(std::make_pair(&rule, i));
+                recursive = true;
+            }
+        }
+
+        if (!recursive) {
+            base_rules.push_back(&rule);
+        }
+    }
+
+    for (auto const *rule: base_rules) {
+        Relation &head = relations[rule->head.relation];
+        head.full = manager.applyOr(head.full, evaluateRule(*rule, -1));
+    }
+
+    if (!stratum.recursive) {
+        return;
+    }
+
+    // everything derived so far is the initial delta
+    for (unsigned int member: members) {
+        relations[member].delta = relations[member].full;
+    }
+
+    bool changed;
+
+    do {
+        for (auto const &item: delta_rules) {
+            Relation &head = relations[item.first->head.relation];
+            head.derived = manager.applyOr(head.derived, evaluateRule(*item.first, item.second));
+        }
+
+        changed = false;
+
+        for (unsigned int member: members) {
+            Relation &relation = relations[member];
+
+            relation.delta = manager.applyDiff(relation.derived, relation.full);
+            relation.full = manager.applyOr(relation.full, relation.delta);
+            relation.derived = BDDManager::ZERO;
+
+            changed |= relation.delta != BDDManager::ZERO;
+        }
+
+        collectGarbage();
+    } while (changed);
+
+    for (unsigned int member: members) {
+        relations[member].delta = BDDManager::ZERO;
+    }
+}
+
+void BDDBackend::collectGarbage() {
+    if (manager.size() < std::max(gc_threshold, (size_t)MIN_GC_THRESHOLD)) {
+        return;
+    }
+
+    std::vector<Node> roots(pinned);
+
+    for (auto const &relation: relations) {
+        roots.push_back(relation.full);
+        roots.push_back(relation.delta);
+        roots.push_back(relation.derived);
+    }
+
+    manager.collectGarbage(roots);
+    gc_threshold = manager.size() * 2;
+}
+
+/**
+ * Queries
+ */
+
+bool BDDBackend::query(const StandardDatalog::Formula &formula) {
+    auto found = relation_ids.find(formula.getRelationName());
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    const Relation &relation = relations[found->second];
+    bool result = manager.applyAnd(relation.full, encodeTuple(relation, formula)) != BDDManager::ZERO;
+
+    return result != formula.isNegated();
+}
+
+StandardDatalog::FormulaVector BDDBackend::query(const Symbol &relation_name) {
+    auto found = relation_ids.find(relation_name);
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    unsigned int arity = relations[found->second].columns.size();
+    StandardDatalog::FormulaVector facts;
+
+    forEachTuple(relation_name, [&] (const unsigned int *row) {
+        facts.push_back(StandardDatalog::Formula(relation_name, StandardDatalog::TermVector(row, row + arity)));
+    });
+
+    return facts;
+}
+
+void BDDBackend::forEachTuple(const Symbol &relation_name,
+                              const std::function<void (const unsigned int *)> &visitor) {
+    auto found = relation_ids.find(relation_name);
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    const Relation &relation = relations[found->second];
+
+    // position of each bit of each column in the assignment
+    std::vector<std::vector<unsigned int>> positions;
+
+    for (unsigned int domain: relation.columns) {
+        std::vector<unsigned int> column_positions;
+
+        for (unsigned int bit: domains[domain].bits) {
+            column_positions.push_back(
+                std::lower_bound(relation.vars.begin(), relation.vars.end(), bit) - relation.vars.begin());
+        }
+
+        positions.push_back(column_positions);
+    }
+
+    std::vector<unsigned int> row(positions.size());
+
+    manager.forEachSat(relation.full, relation.vars, [&] (const std::vector<bool> &assignment) {
+        for (unsigned int col = 0; col < positions.size(); col++) {
+            unsigned int value = 0;
+
+            for (unsigned int position: positions[col]) {
+                value = (value << 1) | assignment[position];
+            }
+
+            row[col] = value;
+        }
+
+        visitor(row.data());
+    });
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BDD.h"
+#include "DatalogIR.h"
+
+/**
+ * A backend storing each relation as a BDD, in the style of bddbddb
+ *
+ * Each sort is encoded in binary using log2(size) + 1 bits.
+ * A sort has a number of physical domains (e.g. Object0, Object1, ...),
+ * each of which is a separate block of BDD variables. Columns of
+ * a relation are stored on the physical domains of their sorts,
+ * and each rule variable is assigned a physical domain, so that
+ * evaluating a rule is a sequence of renamings and relational
+ * products
+ *
+ * The variable order is given in the bddbddb syntax, e.g.
+ * "Object0xObject1_Object2" interleaves the bits of Object0
+ * and Object1 and puts Object2 after them. Domains not mentioned
+ * are appended, with the domains of each sort interleaved
+ */
+class BDDBackend: public StandardDatalog::Backend {
+    using Node = BDDManager::Node;
+
+    struct Domain {
+        std::string name;
+        std::vector<unsigned int> bits; // BDD variables, most significant bit first
+        Node cube;
+    };
+
+    struct Relation {
+        std::vector<unsigned int> columns; // domain of each column
+        std::vector<unsigned int> vars; // all BDD variables of the columns, ascending
+        Node full = BDDManager::ZERO;
+        Node delta = BDDManager::ZERO;
+        Node derived = BDDManager::ZERO;
+    };
+
+    struct Atom {
+        unsigned int relation;
+        bool negated;
+
+        // constants and repeated variables in the atom are
+        // constraints on the columns, after which the columns
+        // they fix are quantified and the rest is renamed onto
+        // the domains of the rule variables (the other way
+        // around for the head)
+        Node constraint;
+        Node quantified;
+        unsigned int renaming;
+    };
+
+    struct Rule {
+        Atom head;
+        std::vector<Atom> body;
+
+        // variables that can be quantified after joining each
+        // positive body atom, and after applying the negated atoms
+        std::vector<Node> quantify_after;
+    };
+
+    std::string ordering;
+    BDDManager manager;
+
+    std::map<std::string, std::vector<unsigned int>> sort_domains;
+    std::vector<Domain> domains;
+
+    std::map<std::string, unsigned int> relation_ids;
+    std::vector<Relation> relations;
+    std::vector<Rule> rules;
+
+    // nodes that must survive garbage collection
+    std::vector<Node> pinned;
+    size_t gc_threshold = 0;
+
+public:
+    BDDBackend(const std::string &ordering = ""): ordering(ordering) {}
+
+    virtual void load(const StandardDatalog::Program &program) override;
+    virtual bool query(const StandardDatalog::Formula &formula) override;
+    virtual StandardDatalog::FormulaVector query(const Symbol &relation_name) override;
+    virtual void forEachTuple(const Symbol &relation_name,
+                              const std::function<void (const unsigned int *)> &visitor) override;
+
+private:
+    static unsigned int getBitWidth(unsigned int size);
+
+    /**
+     * Allocate the physical domains required by the program
+     * and assign BDD variables to them following the ordering
+     */
+    void initDomains(const StandardDatalog::Program &program);
+    void initRelations(const StandardDatalog::Program &program);
+
+    void compileRule(const StandardDatalog::Program &program,
+                     const StandardDatalog::Formula &formula);
+
+    Atom compileAtom(const StandardDatalog::Program &program,
+                     std::map<std::string, unsigned int> &var_domains,
+                     const StandardDatalog::Formula &atom,
+                     bool is_head);
+
+    Node encode(unsigned int domain, unsigned int value);
+    Node encodeTuple(const Relation &relation, const StandardDatalog::Formula &atom);
+    Node encodeTuple(const Relation &relation, const unsigned int *row);
+    Node equal(unsigned int domain_a, unsigned int domain_b);
+
+    /**
+     * An atom of a rule body on the domains of the rule variables
+     */
+    Node evaluateAtom(const Atom &atom, Node source);
+
+    /**
+     * Evaluate a rule where the body atom at delta_atom
+     * (if any) only ranges over the delta
+     */
+    Node evaluateRule(const Rule &rule, int delta_atom);
+
+    void evaluateStratum(const StandardDatalog::Stratum &stratum);
+
+    void collectGarbage();
+};
@@ -0,0 +1,75 @@
+#include <cassert>
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include "CompiledBackend.h"
+
+bool CompiledBackend::hasEvaluator(const StandardDatalog::Program &program) {
+    return CompiledProgramRegistry::find(CompiledProgramRegistry::fingerprint(program)) != nullptr;
+}
+
+void CompiledBackend::load(const StandardDatalog::Program &program) {
+    CompiledProgramRegistry::Factory factory =
+        CompiledProgramRegistry::find(CompiledProgramRegistry::fingerprint(program));
+
+    if (!factory) {
+        llvm::report_fatal_error("no compiled evaluator matches the rules of the program", false);
+    }
+
+    evaluator.reset(factory());
+
+    for (auto const &item: program.getFacts()) {
+        const StandardDatalog::FactTable &facts = *item.second;
+        unsigned int relation = getRelationID(item.first);
+
+        assert(facts.getArity() == evaluator->getArity(relation) &&
+               "number of terms does not match the arity");
+
+        for (size_t i = 0; i < facts.size(); i++) {
+            evaluator->insert(relation, facts.getRow(i));
+        }
+    }
+
+    evaluator->run();
+}
+
+unsigned int CompiledBackend::getRelationID(const std::string &relation_name) const {
+    int relation = evaluator->getRelationID(relation_name);
+    assert(relation >= 0 && "relation does not exist");
+    return relation;
+}
+
+bool CompiledBackend::query(const StandardDatalog::Formula &formula) {
+    std::vector<CompiledProgram::Value> tuple;
+
+    for (auto const &term: formula.getArguments()) {
+        assert(!term.isVariable() && "query must be ground");
+        tuple.push_back(term.getValue());
+    }
+
+    unsigned int relation = getRelationID(formula.getRelationName());
+    assert(tuple.size() == evaluator->getArity(relation) &&
+           "number of terms does not match the arity");
+
+    return evaluator->contains(relation, tuple.data()) != formula.isNegated();
+}
+
+StandardDatalog::FormulaVector CompiledBackend::query(const Symbol &relation_name) {
+    unsigned int arity = evaluator->getArity(getRelationID(relation_name));
+    StandardDatalog::FormulaVector facts;
+
+    forEachTuple(relation_name, [&] (const CompiledProgram::Value *row) {
+        facts.push_back(StandardDatalog::Formula(relation_name, StandardDatalog::TermVector(row, row + arity)));
+    });
+
+    return facts;
+}
+
+void CompiledBackend::forEachTuple(const Symbol &relation_name,
+                                   const std::function<void (const CompiledProgram::Value *)> &visitor) {
+    unsigned int relation = getRelationID(relation_name);
+
+    for (unsigned int id = 0; id < evaluator->size(relation); id++) {
+        visitor(evaluator->getRow(relation, id));
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+
+#include "CompiledRuntime.h"
+#include "DatalogIR.h"
+
+/**
+ * A backend running evaluators generated ahead of time by
+ * datalog-compile. The rules of the loaded program must be
+ * exactly those of one of the analyses compiled into the
+ * plugin; only the facts are loaded at run time
+ */
+class CompiledBackend: public StandardDatalog::Backend {
+    std::unique_ptr<CompiledProgram> evaluator;
+
+public:
+    /**
+     * If an evaluator matches the rules of the program, which
+     * load needs (it stops otherwise)
+     */
+    static bool hasEvaluator(const StandardDatalog::Program &program);
+
+    virtual void load(const StandardDatalog::Program &program) override;
+    virtual bool query(const StandardDatalog::Formula &formula) override;
+    virtual StandardDatalog::FormulaVector query(const Symbol &relation_name) override;
+    virtual void forEachTuple(const Symbol &relation_name,
+                              const std::function<void (const CompiledProgram::Value *)> &visitor) override;
+
+private:
+    unsigned int getRelationID(const std::string &relation_name) const;
+};
@@ -0,0 +1,261 @@
+/**
+ * Runtime support for evaluators generated by datalog-compile
+ * (see Compiler/CppEmitter.h)
+ *
+ * A generated evaluator has one fixed-arity table per relation
+ * and the sorted indices chosen by IndexSelection for its join
+ * loops. Only the facts vary between runs
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "DatalogIR.h"
+
+template<unsigned int N>
+using CompiledTuple = std::array<unsigned int, N>;
+
+template<unsigned int N>
+struct CompiledTupleHash {
+    size_t operator()(const CompiledTuple<N> &tuple) const {
+        uint64_t hash_value = 0x9e3779b97f4a7c15ull;
+
+        for (unsigned int value: tuple) {
+            hash_value ^= value;
+            hash_value *= 0xff51afd7ed558ccdull;
+            hash_value ^= hash_value >> 32;
+        }
+
+        return hash_value;
+    }
+};
+
+/**
+ * Rows are append-only, so the delta of an
+ * iteration is always a suffix of the table
+ */
+template<unsigned int N>
+class CompiledRelation {
+    std::vector<CompiledTuple<N>> rows;
+    std::unordered_set<CompiledTuple<N>, CompiledTupleHash<N>> row_set;
+
+public:
+    unsigned int size() const { return rows.size(); }
+    const CompiledTuple<N> &operator[](unsigned int id) const { return rows[id]; }
+
+    bool contains(const CompiledTuple<N> &tuple) const {
+        return row_set.find(tuple) != row_set.end();
+    }
+
+    bool insert(const CompiledTuple<N> &tuple) {
+        if (!row_set.insert(tuple).second) {
+            return false;
+        }
+
+        rows.push_back(tuple);
+        return true;
+    }
+};
+
+/**
+ * Row ids of a relation sorted by the columns of an order
+ * (see IndexSelection.h), given by a function permuting the
+ * columns of a row into that order. As in NativeBackend, the
+ * ids are bucketed by the first column of the order
+ */
+template<unsigned int N>
+class CompiledIndex {
+    std::unordered_map<unsigned int, std::vector<unsigned int>> buckets;
+    unsigned int indexed_rows = 0;
+
+public:
+    template<typename OrderFunction>
+    void update(const CompiledRelation<N> &relation, OrderFunction order_of) {
+        auto less = [&] (unsigned int a, unsigned int b) {
+            return order_of(relation[a]) < order_of(relation[b]);
+        };
+
+        // buckets with new rows, and their sizes before
+        std::vector<std::pair<std::vector<unsigned int> *, size_t>> updated;
+
+        for (unsigned int id = indexed_rows; id < relation.size(); id++) {
+            std::vector<unsigned int> &bucket = buckets[order_of(relation[id])[0]];
+
+            if (bucket.empty() || bucket.back() < indexed_rows) {
+                updated.push_back(std::make_pair(&bucket, bucket.size()));
+            }
+
+            bucket.push_back(id);
+        }
+
+        // sort the new rows and merge them with the old ones
+        for (auto const &item: updated) {
+            std::vector<unsigned int> &bucket = *item.first;
+
+            std::sort(bucket.begin() + item.second, bucket.end(), less);
+            std::inplace_merge(bucket.begin(), bucket.begin() + item.second, bucket.end(), less);
+        }
+
+        indexed_rows = relation.size();
+    }
+
+    /**
+     * Ids of the rows whose prefix (given by a function taking
+     * the first columns of the order) equals the key
+     */
+    template<typename Key, typename PrefixFunction>
+    std::pair<const unsigned int *, const unsigned int *>
+    find(const CompiledRelation<N> &relation, const Key &key, PrefixFunction prefix_of) const {
+        auto found = buckets.find(key[0]);
+
+        if (found == buckets.end()) {
+            return std::make_pair((const unsigned int *)NULL, (const unsigned int *)NULL);
+        }
+
+        const unsigned int *first = found->second.data();
+        const unsigned int *last = first + found->second.size();
+
+        if (key.size() == 1) {
+            return std::make_pair(first, last);
+        }
+
+        first = std::partition_point(first, last, [&] (unsigned int id) {
+            return prefix_of(relation[id]) < key;
+        });
+
+        last = std::partition_point(first, last, [&] (unsigned int id) {
+            return !(key < prefix_of(relation[id]));
+        });
+
+        return std::make_pair(first, last);
+    }
+};
+
+/**
+ * Interface of a generated evaluator
+ */
+class CompiledProgram {
+public:
+    using Value = unsigned int;
+
+    virtual ~CompiledProgram() {}
+
+    /**
+     * Returns -1 if the relation does not exist
+     */
+    virtual int getRelationID(const std::string &name) const = 0;
+    virtual unsigned int getArity(unsigned int relation) const = 0;
+
+    virtual bool insert(unsigned int relation, const Value *tuple) = 0;
+    virtual bool contains(unsigned int relation, const Value *tuple) const = 0;
+
+    virtual unsigned int size(unsigned int relation) const = 0;
+    virtual const Value *getRow(unsigned int relation, unsigned int row) const = 0;
+
+    /**
+     * Evaluate all rules to the fixpoint
+     */
+    virtual void run() = 0;
+};
+
+/**
+ * Generated evaluators register themselves with
+ * the fingerprint of the rules they are compiled from
+ */
+class CompiledProgramRegistry {
+public:
+    using Factory = CompiledProgram *(*)();
+
+    static std::vector<std::pair<uint64_t, Factory>> &getEntries() {
+        static std::vector<std::pair<uint64_t, Factory>> entries;
+        return entries;
+    }
+
+    CompiledProgramRegistry(uint64_t fingerprint, Factory factory) {
+        getEntries().push_back(std::make_pair(fingerprint, factory));
+    }
+
+    static Factory find(uint64_t fingerprint) {
+        for (auto const &entry: getEntries()) {
+            if (entry.first == fingerprint) {
+                return entry.second;
+            }
+        }
+
+        return NULL;
+    }
+
+    /**
+     * Hash of the sorts, relations and rules (but not the facts)
+     * of a program. The order of the atoms in a body does not
+     * matter, so that the rules can be reordered (see JoinOrdering.h)
+     */
+    static uint64_t fingerprint(const StandardDatalog::Program &program) {
+        std::string text;
+        llvm::raw_string_ostream out(text);
+
+        // by name, since the ids of symbols differ between
+        // datalog-compile and the plugin
+        for (auto const item: sortByName(program.getSorts())) {
+            out << item->second << "\n";
+        }
+
+        for (auto const item: sortByName(program.getRelations())) {
+            out << item->second << "\n";
+        }
+
+        // printing formulas drops the negations
+        auto print_atom = [] (const StandardDatalog::Formula &atom) {
+            std::string text;
+            llvm::raw_string_ostream out(text);
+
+            out << (atom.isNegated() ? "!" : "") << atom.getRelationName() << "(";
+
+            for (auto const &term: atom.getArguments()) {
+                out << term << ",";
+            }
+
+            out << ")";
+            return out.str();
+        };
+
+        for (auto const &formula: program.getFormulas()) {
+            if (!formula.isAtom()) {
+                std::vector<std::string> body;
+
+                for (auto const &atom: formula.getBody()) {
+                    body.push_back(print_atom(atom));
+                }
+
+                std::sort(body.begin(), body.end());
+
+                out << print_atom(formula) << " :- ";
+
+                for (auto const &atom: body) {
+                    out << atom;
+                }
+
+                out << "\n";
+            }
+        }
+
+        out.flush();
+
+        // FNV-1a
+        uint64_t hash_value = 0xcbf29ce484222325ull;
+
+        for (char c: text) {
+            hash_value ^= (unsigned char)c;
+            hash_value *= 0x100000001b3ull;
+        }
+
+        return hash_value;
+    }
+};
@@ -0,0 +1,597 @@
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+#include "llvm/Support/Format.h"
+
+#include "CompiledRuntime.h"
+#include "CppEmitter.h"
+
+using namespace llvm;
+
+static raw_ostream &indent(raw_ostream &out, unsigned int depth) {
+    return out.indent(depth * 4);
+}
+
+static void printAtom(raw_ostream &out, const StandardDatalog::Formula &atom) {
+    out << (atom.isNegated() ? "!" : "") << atom.getRelationName() << "(";
+
+    for (unsigned int i = 0; i < atom.getArity(); i++) {
+        out << (i ? ", " : "") << atom.getArguments()[i];
+    }
+
+    out << ")";
+}
+
+CppEmitter::CppEmitter(const StandardDatalog::Program &program, const std::string &class_name):
+    program(program), class_name(class_name), index_selection(program) {
+    for (auto const &item: program.getRelations()) {
+        relation_ids[item.first] = relation_names.size();
+        relation_names.push_back(item.first);
+        arities.push_back(item.second.getArgumentSortNames().size());
+    }
+
+    for (auto const &item: program.getStrata()) {
+        Stratum stratum;
+        stratum.recursive = item.recursive;
+
+        for (auto const &name: item.relations) {
+            stratum.relations.push_back(relation_ids.at(name));
+        }
+
+        for (auto const &formula: program.getFormulas()) {
+            if (formula.isAtom() || !isInStratum(stratum, relation_ids.at(formula.getRelationName()))) {
+                continue;
+            }
+
+            const StandardDatalog::FormulaVector &body = formula.getBody();
+            bool recursive = false;
+
+            for (unsigned int i = 0; i < body.size(); i++) {
+                bool in_stratum = isInStratum(stratum, relation_ids.at(body[i].getRelationName()));
+
+                assert(!(body[i].isNegated() && in_stratum) && "negation cannot be stratified");
+
+                if (!body[i].isNegated() && in_stratum) {
+                    stratum.delta_plans.push_back(planRule(formula, stratum, i));
+                    recursive = true;
+                }
+            }
+
+            if (!recursive) {
+                stratum.base_plans.push_back(planRule(formula, stratum, -1));
+            }
+        }
+
+        strata.push_back(stratum);
+    }
+}
+
+bool CppEmitter::isInStratum(const Stratum &stratum, unsigned int relation) const {
+    return std::find(stratum.relations.begin(), stratum.relations.end(), relation) !=
+           stratum.relations.end();
+}
+
+CppEmitter::Plan CppEmitter::planRule(const StandardDatalog::Formula &rule,
+                                      const Stratum &stratum, int delta_atom) const {
+    const StandardDatalog::FormulaVector &body = rule.getBody();
+
+    Plan plan;
+    plan.rule = &rule;
+
+    std::set<std::string> bound;
+    std::vector<const StandardDatalog::Formula *> pending;
+
+    auto is_bound = [&] (const StandardDatalog::Formula &atom) {
+        for (auto const &term: atom.getArguments()) {
+            if (term.isVariable() && !bound.count(term.getVariable())) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    // join the delta first, then the rest of the positive atoms in order
+    std::vector<unsigned int> order;
+
+    if (delta_atom >= 0) {
+        order.push_back(delta_atom);
+    }
+
+    for (unsigned int i = 0; i < body.size(); i++) {
+        if (body[i].isNegated()) {
+            if (is_bound(body[i])) {
+                plan.ground_negations.push_back(&body[i]);
+            } else {
+                pending.push_back(&body[i]);
+            }
+        } else if ((int)i != delta_atom) {
+            order.push_back(i);
+        }
+    }
+
+    for (unsigned int i: order) {
+        const StandardDatalog::Formula &atom = body[i];
+        const StandardDatalog::TermVector &args = atom.getArguments();
+
+        Step step;
+        step.atom = &atom;
+        step.relation = relation_ids.at(atom.getRelationName());
+        step.mask = 0;
+
+        assert(args.size() == arities[step.relation] && "number of terms does not match the arity");
+        assert(args.size() <= 32 && "relation arity not supported");
+
+        if (!isInStratum(stratum, step.relation)) {
+            step.range = FULL;
+        } else if ((int)i == delta_atom) {
+            step.range = DELTA;
+        } else if ((int)i < delta_atom) {
+            step.range = OLD;
+        } else {
+            step.range = FULL;
+        }
+
+        for (unsigned int col = 0; col < args.size(); col++) {
+            if (!args[col].isVariable() || bound.count(args[col].getVariable())) {
+                step.mask |= 1u << col;
+            }
+        }
+
+        if (step.mask != 0) {
+            step.index = index_selection.getIndex(atom.getRelationName(), step.mask);
+        }
+
+        for (auto const &term: args) {
+            if (term.isVariable()) {
+                bound.insert(term.getVariable());
+            }
+        }
+
+        // check negated atoms as early as possible
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (is_bound(**it)) {
+                step.negations.push_back(*it);
+                it = pending.erase(it);
+            } else {
+                it++;
+            }
+        }
+
+        plan.steps.push_back(step);
+    }
+
+    assert(pending.empty() && is_bound(rule) &&
+           "variables in the head or negated atoms must appear in a positive atom");
+
+    return plan;
+}
+
+std::set<std::pair<unsigned int, unsigned int>> CppEmitter::getIndices(const std::vector<Plan> &plans) {
+    std::set<std::pair<unsigned int, unsigned int>> indices;
+
+    for (auto const &plan: plans) {
+        for (auto const &step: plan.steps) {
+            if (step.mask != 0) {
+                indices.insert(std::make_pair(step.relation, step.index.index));
+            }
+        }
+    }
+
+    return indices;
+}
+
+const IndexSelection::Order &CppEmitter::getOrder(unsigned int relation, unsigned int index) const {
+    return index_selection.getOrders(relation_names[relation])[index];
+}
+
+std::string CppEmitter::getIndexName(unsigned int relation, unsigned int index) const {
+    std::string name = "i_" + relation_names[relation];
+
+    for (unsigned int col: getOrder(relation, index)) {
+        name += "_" + std::to_string(col);
+    }
+
+    return name;
+}
+
+std::string CppEmitter::getTupleType(unsigned int arity) const {
+    return "CompiledTuple<" + std::to_string(arity) + ">";
+}
+
+std::string CppEmitter::getVariableName(const std::string &var) {
+    return "v_" + var;
+}
+
+std::string CppEmitter::getTuple(const StandardDatalog::Formula &atom) const {
+    std::vector<unsigned int> columns;
+
+    for (unsigned int col = 0; col < atom.getArity(); col++) {
+        columns.push_back(col);
+    }
+
+    return getTuple(atom, columns);
+}
+
+std::string CppEmitter::getTuple(const StandardDatalog::Formula &atom,
+                                 const std::vector<unsigned int> &columns) const {
+    std::string values;
+
+    for (unsigned int col: columns) {
+        const StandardDatalog::Term &term = atom.getArguments()[col];
+
+        values += values.empty() ? " " : ", ";
+        values += term.isVariable() ? getVariableName(term.getVariable())
+                                    : std::to_string(term.getValue()) + "u";
+    }
+
+    return getTupleType(columns.size()) + "{{" + values + (columns.empty() ? "}}" : " }}");
+}
+
+std::string CppEmitter::getProjection(unsigned int relation, unsigned int index, unsigned int length) const {
+    const IndexSelection::Order &order = getOrder(relation, index);
+    std::string values;
+
+    for (unsigned int i = 0; i < length; i++) {
+        values += (i ? ", t[" : " t[") + std::to_string(order[i]) + "]";
+    }
+
+    return "[] (const " + getTupleType(arities[relation]) + " &t) { return " +
+           getTupleType(length) + "{{" + values + " }}; }";
+}
+
+void CppEmitter::emit(raw_ostream &out) const {
+    std::set<std::pair<unsigned int, unsigned int>> indices;
+    std::set<unsigned int> buffered;
+
+    for (auto const &stratum: strata) {
+        auto stratum_indices = getIndices(stratum.base_plans);
+        indices.insert(stratum_indices.begin(), stratum_indices.end());
+
+        stratum_indices = getIndices(stratum.delta_plans);
+        indices.insert(stratum_indices.begin(), stratum_indices.end());
+
+        if (stratum.recursive) {
+            buffered.insert(stratum.relations.begin(), stratum.relations.end());
+        }
+    }
+
+    out << "// Generated by datalog-compile, do not edit\n\n";
+    out << "#include <algorithm>\n";
+    out << "#include <map>\n\n";
+    out << "#include \"CompiledRuntime.h\"\n\n";
+    out << "namespace {\n\n";
+
+    out << "class " << class_name << ": public CompiledProgram {\n";
+
+    for (unsigned int i = 0; i < relation_names.size(); i++) {
+        out << "    CompiledRelation<" << arities[i] << "> r_" << relation_names[i] << ";\n";
+    }
+
+    out << "\n    // tuples derived in the current iteration,\n";
+    out << "    // and the rows derived in the last one [db, de)\n";
+
+    for (unsigned int i: buffered) {
+        out << "    std::vector<" << getTupleType(arities[i]) << "> n_" << relation_names[i] << ";\n";
+        out << "    unsigned int db_" << relation_names[i] << " = 0, de_" << relation_names[i] << " = 0;\n";
+    }
+
+    out << "\n";
+
+    for (auto const &index: indices) {
+        out << "    CompiledIndex<" << arities[index.first] << "> "
+            << getIndexName(index.first, index.second) << ";\n";
+    }
+
+    out << "\npublic:\n";
+
+    emitAccessors(out);
+
+    out << "    virtual void run() override {\n";
+
+    for (unsigned int i = 0; i < strata.size(); i++) {
+        if (!strata[i].base_plans.empty() || !strata[i].delta_plans.empty()) {
+            out << "        evaluateStratum" << i << "();\n";
+        }
+    }
+
+    out << "    }\n\n";
+    out << "private:\n";
+
+    for (unsigned int i = 0; i < strata.size(); i++) {
+        if (!strata[i].base_plans.empty() || !strata[i].delta_plans.empty()) {
+            emitStratum(out, i);
+        }
+    }
+
+    out << "};\n\n";
+
+    out << "CompiledProgramRegistry registration(\n";
+    out << "    " << format_hex(CompiledProgramRegistry::fingerprint(program), 18) << "ull,\n";
+    out << "    [] () -> CompiledProgram * { return new " << class_name << "(); }\n";
+    out << ");\n\n";
+
+    out << "} // namespace\n";
+}
+
+void CppEmitter::emitAccessors(raw_ostream &out) const {
+    out << "    virtual int getRelationID(const std::string &name) const override {\n";
+    out << "        static const std::map<std::string, int> ids = {\n";
+
+    for (unsigned int i = 0; i < relation_names.size(); i++) {
+        out << "            { \"" << relation_names[i] << "\", " << i << " },\n";
+    }
+
+    out << "        };\n\n";
+    out << "        auto found = ids.find(name);\n";
+    out << "        return found == ids.end() ? -1 : found->second;\n";
+    out << "    }\n\n";
+
+    out << "    virtual unsigned int getArity(unsigned int relation) const override {\n";
+    out << "        static const unsigned int arities[] = {";
+
+    for (unsigned int i = 0; i < arities.size(); i++) {
+        out << (i ? ", " : " ") << arities[i];
+    }
+
+    out << " };\n";
+    out << "        return arities[relation];\n";
+    out << "    }\n\n";
+
+    // one switch over the relations per accessor
+    auto emit_switch = [&] (const std::string &signature, const std::string &default_result,
+                            const std::function<std::string (unsigned int)> &get_case) {
+        out << "    virtual " << signature << " override {\n";
+        out << "        switch (relation) {\n";
+
+        for (unsigned int i = 0; i < relation_names.size(); i++) {
+            out << "            case " << i << ": return " << get_case(i) << ";\n";
+        }
+
+        out << "        }\n\n";
+        out << "        assert(0 && \"relation does not exist\");\n";
+        out << "        return " << default_result << ";\n";
+        out << "    }\n\n";
+    };
+
+    auto tuple_of = [&] (unsigned int relation) {
+        std::string values;
+
+        for (unsigned int col = 0; col < arities[relation]; col++) {
+            values += (col ? ", tuple[" : " tuple[") + std::to_string(col) + "]";
+        }
+
+        return getTupleType(arities[relation]) + "{{" + values + (arities[relation] ? " }}" : "}}");
+    };
+
+    emit_switch("bool insert(unsigned int relation, const Value *tuple)", "false", [&] (unsigned int i) {
+        return "r_" + relation_names[i] + ".insert(" + tuple_of(i) + ")";
+    });
+
+    emit_switch("bool contains(unsigned int relation, const Value *tuple) const", "false", [&] (unsigned int i) {
+        return "r_" + relation_names[i] + ".contains(" + tuple_of(i) + ")";
+    });
+
+    emit_switch("unsigned int size(unsigned int relation) const", "0", [&] (unsigned int i) {
+        return "r_" + relation_names[i] + ".size()";
+    });
+
+    emit_switch("const Value *getRow(unsigned int relation, unsigned int row) const", "NULL",
+                [&] (unsigned int i) {
+        return "r_" + relation_names[i] + "[row].data()";
+    });
+}
+
+void CppEmitter::emitIndexUpdates(raw_ostream &out, const std::vector<Plan> &plans, unsigned int depth) const {
+    for (auto const &index: getIndices(plans)) {
+        unsigned int relation = index.first;
+
+        indent(out, depth) << getIndexName(relation, index.second) << ".update(r_" << relation_names[relation]
+                           << ", " << getProjection(relation, index.second, arities[relation]) << ");\n";
+    }
+}
+
+void CppEmitter::emitStratum(raw_ostream &out, unsigned int index) const {
+    const Stratum &stratum = strata[index];
+
+    out << "    // stratum of";
+
+    for (unsigned int relation: stratum.relations) {
+        out << " " << relation_names[relation];
+    }
+
+    out << "\n";
+    out << "    void evaluateStratum" << index << "() {\n";
+
+    // non-recursive rules only need to be evaluated once, and
+    // since they do not read the relations of the stratum, they
+    // can insert into the tables directly
+    emitIndexUpdates(out, stratum.base_plans, 2);
+
+    for (unsigned int i = 0; i < stratum.base_plans.size(); i++) {
+        if (i || !getIndices(stratum.base_plans).empty()) {
+            out << "\n";
+        }
+
+        emitPlan(out, stratum.base_plans[i], 2);
+    }
+
+    if (stratum.recursive) {
+        out << "\n";
+        indent(out, 2) << "// everything derived so far is the initial delta\n";
+
+        for (unsigned int relation: stratum.relations) {
+            const std::string &name = relation_names[relation];
+            indent(out, 2) << "db_" << name << " = 0;\n";
+            indent(out, 2) << "de_" << name << " = r_" << name << ".size();\n";
+        }
+
+        out << "\n";
+        indent(out, 2) << "bool changed;\n\n";
+        indent(out, 2) << "do {\n";
+
+        emitIndexUpdates(out, stratum.delta_plans, 3);
+
+        for (auto const &plan: stratum.delta_plans) {
+            out << "\n";
+            emitPlan(out, plan, 3);
+        }
+
+        out << "\n";
+        indent(out, 3) << "changed = false;\n";
+
+        for (unsigned int relation: stratum.relations) {
+            const std::string &name = relation_names[relation];
+
+            out << "\n";
+            indent(out, 3) << "db_" << name << " = r_" << name << ".size();\n\n";
+            indent(out, 3) << "for (auto const &tuple: n_" << name << ") {\n";
+            indent(out, 4) << "r_" << name << ".insert(tuple);\n";
+            indent(out, 3) << "}\n\n";
+            indent(out, 3) << "n_" << name << ".clear();\n";
+            indent(out, 3) << "de_" << name << " = r_" << name << ".size();\n";
+            indent(out, 3) << "changed |= de_" << name << " != db_" << name << ";\n";
+        }
+
+        indent(out, 2) << "} while (changed);\n";
+    }
+
+    out << "    }\n\n";
+}
+
+void CppEmitter::emitPlan(raw_ostream &out, const Plan &plan, unsigned int depth) const {
+    const StandardDatalog::Formula &head = *plan.rule;
+    const std::string &head_name = head.getRelationName();
+    unsigned int base_depth = depth;
+    bool is_delta = false;
+
+    indent(out, depth) << "// ";
+    printAtom(out, head);
+    out << " :-";
+
+    for (auto const &atom: head.getBody()) {
+        out << " ";
+        printAtom(out, atom);
+    }
+
+    out << "\n";
+
+    auto emit_negations = [&] (const std::vector<const StandardDatalog::Formula *> &negations) {
+        for (auto const *atom: negations) {
+            indent(out, depth++) << "if (!r_" << atom->getRelationName()
+                                 << ".contains(" << getTuple(*atom) << ")) {\n";
+        }
+    };
+
+    indent(out, depth++) << "{\n";
+    emit_negations(plan.ground_negations);
+
+    // variables occurring only once in the rule are not read
+    std::map<std::string, unsigned int> occurrences;
+    std::set<std::string> declared;
+
+    auto count_occurrences = [&] (const StandardDatalog::Formula &atom) {
+        for (auto const &term: atom.getArguments()) {
+            if (term.isVariable()) {
+                occurrences[term.getVariable()]++;
+            }
+        }
+    };
+
+    count_occurrences(head);
+
+    for (auto const &atom: head.getBody()) {
+        count_occurrences(atom);
+    }
+
+    auto is_read = [&] (const StandardDatalog::TermVector &args, unsigned int mask, unsigned int col) {
+        return !((mask >> col) & 1) && args[col].isVariable() && occurrences[args[col].getVariable()] > 1;
+    };
+
+    for (unsigned int k = 0; k < plan.steps.size(); k++) {
+        const Step &step = plan.steps[k];
+        const StandardDatalog::TermVector &args = step.atom->getArguments();
+        const std::string &name = relation_names[step.relation];
+        std::string row = "row" + std::to_string(k);
+        std::string tuple = "t" + std::to_string(k);
+
+        std::string begin = step.range == DELTA ? "db_" + name : "0";
+        std::string end = step.range == FULL ? "r_" + name + ".size()" :
+                          step.range == OLD ? "db_" + name : "de_" + name;
+
+        bool reads_row = false;
+
+        for (unsigned int col = 0; col < args.size(); col++) {
+            reads_row |= is_read(args, step.mask, col);
+        }
+
+        is_delta |= step.range == DELTA;
+
+        if (step.mask == 0) {
+            indent(out, depth++) << "for (unsigned int " << row << " = " << begin << "; "
+                                 << row << " < " << end << "; " << row << "++) {\n";
+        } else {
+            const IndexSelection::Order &order = getOrder(step.relation, step.index.index);
+            std::vector<unsigned int> key(order.begin(), order.begin() + step.index.prefix_length);
+            std::string range = "range" + std::to_string(k);
+
+            indent(out, depth) << "auto " << range << " = " << getIndexName(step.relation, step.index.index)
+                               << ".find(r_" << name << ", " << getTuple(*step.atom, key) << ",\n";
+            indent(out, depth + 1) << getProjection(step.relation, step.index.index, key.size()) << ");\n\n";
+
+            indent(out, depth++) << "for (const unsigned int *" << row << " = " << range << ".first; "
+                                 << row << " != " << range << ".second; " << row << "++) {\n";
+
+            // the index is sorted by the key, so the rows
+            // out of the range can only be filtered
+            if (step.range == DELTA) {
+                indent(out, depth++) << "if (*" << row << " >= " << begin << " && *" << row << " < " << end << ") {\n";
+            } else if (step.range == OLD) {
+                indent(out, depth++) << "if (*" << row << " < " << end << ") {\n";
+            }
+        }
+
+        if (reads_row) {
+            indent(out, depth) << "const " << getTupleType(args.size()) << " &" << tuple << " = r_" << name
+                               << "[" << (step.mask == 0 ? row : "*" + row) << "];\n";
+        }
+
+        std::string checks;
+
+        for (unsigned int col = 0; col < args.size(); col++) {
+            if (!is_read(args, step.mask, col)) {
+                continue;
+            }
+
+            std::string var = getVariableName(args[col].getVariable());
+            std::string value = tuple + "[" + std::to_string(col) + "]";
+
+            if (declared.insert(var).second) {
+                indent(out, depth) << "const unsigned int " << var << " = " << value << ";\n";
+            } else {
+                // repeated variable in the same atom
+                checks += (checks.empty() ? "" : " && ") + value + " == " + var;
+            }
+        }
+
+        if (!checks.empty()) {
+            indent(out, depth++) << "if (" << checks << ") {\n";
+        }
+
+        emit_negations(step.negations);
+    }
+
+    if (is_delta) {
+        indent(out, depth) << "const " << getTupleType(head.getArity()) << " tuple = " << getTuple(head) << ";\n\n";
+        indent(out, depth++) << "if (!r_" << head_name << ".contains(tuple)) {\n";
+        indent(out, depth) << "n_" << head_name << ".push_back(tuple);\n";
+        indent(out, --depth) << "}\n";
+    } else {
+        indent(out, depth) << "r_" << head_name << ".insert(" << getTuple(head) << ");\n";
+    }
+
+    while (depth > base_depth) {
+        indent(out, --depth) << "}\n";
+    }
+}
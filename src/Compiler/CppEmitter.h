@@ -0,0 +1,105 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "DatalogIR.h"
+#include "IndexSelection.h"
+
+/**
+ * Translates the rules of a datalog program into a C++ evaluator
+ * specialized to them (see CompiledRuntime.h for the interface)
+ *
+ * Each relation becomes a table of fixed-arity tuples and each rule
+ * a nest of loops, one per positive atom, where atoms with bound
+ * columns are looked up in the sorted index chosen for them by
+ * IndexSelection.
+ * Negated atoms are checked as soon as their variables are bound.
+ * Strata are evaluated semi-naively as in NativeBackend, except
+ * that the join order, the indices and the ranges scanned are all
+ * fixed at compile time
+ */
+class CppEmitter {
+    enum Range {
+        FULL, // all rows
+        OLD, // rows before the delta
+        DELTA, // rows derived in the last iteration
+    };
+
+    struct Step {
+        const StandardDatalog::Formula *atom;
+        unsigned int relation;
+        unsigned int mask; // columns bound before the step
+        IndexSelection::Index index; // used if mask != 0
+        Range range;
+
+        // negated atoms whose variables are all bound after this step
+        std::vector<const StandardDatalog::Formula *> negations;
+    };
+
+    struct Plan {
+        const StandardDatalog::Formula *rule;
+        std::vector<const StandardDatalog::Formula *> ground_negations;
+        std::vector<Step> steps;
+    };
+
+    struct Stratum {
+        std::vector<unsigned int> relations;
+        bool recursive;
+        std::vector<Plan> base_plans;
+        std::vector<Plan> delta_plans;
+    };
+
+    const StandardDatalog::Program &program;
+    std::string class_name;
+
+    std::map<std::string, unsigned int> relation_ids;
+    std::vector<std::string> relation_names;
+    std::vector<unsigned int> arities;
+
+    IndexSelection index_selection;
+
+    std::vector<Stratum> strata;
+
+public:
+    CppEmitter(const StandardDatalog::Program &program, const std::string &class_name);
+
+    void emit(llvm::raw_ostream &out) const;
+
+private:
+    Plan planRule(const StandardDatalog::Formula &rule, const Stratum &stratum, int delta_atom) const;
+
+    bool isInStratum(const Stratum &stratum, unsigned int relation) const;
+
+    /**
+     * Indices (relation, order) used by the plans
+     */
+    static std::set<std::pair<unsigned int, unsigned int>> getIndices(const std::vector<Plan> &plans);
+
+    const IndexSelection::Order &getOrder(unsigned int relation, unsigned int index) const;
+    std::string getIndexName(unsigned int relation, unsigned int index) const;
+    std::string getTupleType(unsigned int arity) const;
+
+    /**
+     * Tuple literal of the given columns of an atom, where
+     * variables are referred to by their local names
+     */
+    std::string getTuple(const StandardDatalog::Formula &atom) const;
+    std::string getTuple(const StandardDatalog::Formula &atom, const std::vector<unsigned int> &columns) const;
+
+    /**
+     * Lambda taking the first length columns of the order from a row
+     */
+    std::string getProjection(unsigned int relation, unsigned int index, unsigned int length) const;
+
+    static std::string getVariableName(const std::string &var);
+
+    void emitAccessors(llvm::raw_ostream &out) const;
+    void emitStratum(llvm::raw_ostream &out, unsigned int index) const;
+    void emitIndexUpdates(llvm::raw_ostream &out, const std::vector<Plan> &plans, unsigned int depth) const;
+    void emitPlan(llvm::raw_ostream &out, const Plan &plan, unsigned int depth) const;
+};
@@ -0,0 +1,86 @@
+/**
+ * Usage: datalog-compile [-table] <algorithm> <output.cpp>
+ *
+ * Generates a C++ evaluator for one of the analysis programs in
+ * Analysis/, to be built into the plugin and picked up by the
+ * compiled backend (-datalog-aa-backend=compiled), or with -table
+ * the program itself as constant arrays, which the plugin loads
+ * the analysis from (see ProgramTable.h)
+ */
+
+#include <map>
+#include <string>
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "CppEmitter.h"
+#include "TableEmitter.h"
+#include "TopElements.h"
+
+#include "DatalogDSL.h"
+
+struct AnalysisProgram {
+    std::string evaluator_name;
+    std::string table_name;
+    StandardDatalog::Program program;
+};
+
+/**
+ * Programs to compile, and the names of their evaluators and tables
+ */
+static std::map<std::string, AnalysisProgram> programs = {
+    {
+        "andersen",
+        {
+            "AndersenEvaluator",
+            "AndersenProgram",
+            BEGIN
+                #include "Analysis/Andersen.datalog"
+            END
+        }
+    }
+};
+
+#include "DatalogDSL.h" // toggle dsl off
+
+using namespace llvm;
+
+int main(int argc, char **argv) {
+    bool table = argc == 4 && std::string(argv[1]) == "-table";
+
+    if (argc != 3 && !table) {
+        errs() << "usage: " << argv[0] << " [-table] <algorithm> <output.cpp>\n";
+        return 1;
+    }
+
+    const char *algorithm = argv[argc - 2];
+    const char *output = argv[argc - 1];
+
+    auto found = programs.find(algorithm);
+
+    if (found == programs.end()) {
+        errs() << argv[0] << ": unknown algorithm " << algorithm << "\n";
+        return 1;
+    }
+
+    std::error_code error;
+    raw_fd_ostream out(output, error, sys::fs::F_None);
+
+    if (error) {
+        errs() << argv[0] << ": cannot open " << output << ": " << error.message() << "\n";
+        return 1;
+    }
+
+    if (table) {
+        // the program as written, the pass rewrites it itself
+        TableEmitter(found->second.program, found->second.table_name).emit(out);
+        return 0;
+    }
+
+    // tops are rewritten the same way as in the pass
+    TopElements top_elements(found->second.program);
+    CppEmitter(top_elements.getProgram(), found->second.evaluator_name).emit(out);
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <map>
+#include <vector>
+
+#include "TableEmitter.h"
+
+using namespace llvm;
+
+void TableEmitter::emit(raw_ostream &out) const {
+    std::map<Symbol, unsigned int> relation_ids;
+
+    for (auto const &item: program.getRelations()) {
+        relation_ids.insert(std::make_pair(item.first, relation_ids.size()));
+    }
+
+    out << "// Generated by datalog-compile, do not edit\n\n";
+    out << "#include \"ProgramTable.h\"\n\n";
+    out << "namespace {\n\n";
+
+    out << "const ProgramTable::Sort sorts[] = {\n";
+
+    for (auto const &item: program.getSorts()) {
+        out << "    { \"" << item.first << "\", " << item.second.getSize() << " },\n";
+    }
+
+    out << "};\n\n";
+
+    out << "const char *const sort_names[] = {\n";
+
+    for (auto const &item: program.getRelations()) {
+        for (auto const &sort: item.second.getArgumentSortNames()) {
+            out << "    \"" << sort << "\",\n";
+        }
+    }
+
+    out << "};\n\n";
+
+    unsigned int num_sort_names = 0;
+    unsigned int num_tops = 0;
+
+    out << "const ProgramTable::Relation relations[] = {\n";
+
+    for (auto const &item: program.getRelations()) {
+        unsigned int arity = item.second.getArgumentSortNames().size();
+
+        out << "    { \"" << item.first << "\", " << num_sort_names << ", " << arity << " },\n";
+        num_sort_names += arity;
+        num_tops += item.second.getTops().size();
+    }
+
+    out << "};\n\n";
+
+    if (num_tops) {
+        out << "const ProgramTable::Top tops[] = {\n";
+
+        for (auto const &item: program.getRelations()) {
+            for (auto const &top: item.second.getTops()) {
+                assert(relation_ids.count(top.second.domain) && "domain of a top is not a relation");
+
+                out << "    { " << relation_ids.at(item.first) << ", " << top.first << ", "
+                    << top.second.value << ", " << relation_ids.at(top.second.domain) << " },\n";
+            }
+        }
+
+        out << "};\n\n";
+    }
+
+    // rules first, then facts (as formulas with no body), both
+    // in the order they are in the program
+    std::vector<const StandardDatalog::Formula *> atoms;
+    std::vector<StandardDatalog::Formula> facts;
+
+    for (auto const &item: program.getFacts()) {
+        for (size_t i = 0; i < item.second->size(); i++) {
+            facts.push_back(item.second->getFormula(i));
+        }
+    }
+
+    out << "const ProgramTable::Formula formulas[] = {\n";
+
+    auto emit_formula = [&] (const StandardDatalog::Formula &formula) {
+        out << "    { " << atoms.size() << ", " << atoms.size() + 1 << ", " << formula.getBody().size() << " },\n";
+        atoms.push_back(&formula);
+
+        for (auto const &atom: formula.getBody()) {
+            atoms.push_back(&atom);
+        }
+    };
+
+    for (auto const &formula: program.getFormulas()) {
+        emit_formula(formula);
+    }
+
+    for (auto const &fact: facts) {
+        emit_formula(fact);
+    }
+
+    out << "};\n\n";
+
+    unsigned int num_terms = 0;
+
+    out << "const ProgramTable::Atom atoms[] = {\n";
+
+    for (auto const *atom: atoms) {
+        out << "    { " << relation_ids.at(atom->getRelationName()) << ", "
+            << (atom->isNegated() ? "true" : "false") << ", " << num_terms << ", " << atom->getArity() << " },\n";
+        num_terms += atom->getArity();
+    }
+
+    out << "};\n\n";
+
+    out << "const ProgramTable::Term terms[] = {\n";
+
+    for (auto const *atom: atoms) {
+        for (auto const &term: atom->getArguments()) {
+            if (term.isVariable()) {
+                out << "    { \"" << term.getVariable() << "\", 0 },\n";
+            } else {
+                out << "    { nullptr, " << term.getValue() << " },\n";
+            }
+        }
+    }
+
+    out << "};\n\n";
+
+    out << "} // namespace\n\n";
+
+    out << "extern const ProgramTable " << table_name << " = {\n";
+    out << "    sorts, " << program.getSorts().size() << ",\n";
+    out << "    sort_names, relations, " << program.getRelations().size() << ",\n";
+    out << "    " << (num_tops ? "tops" : "nullptr") << ", " << num_tops << ",\n";
+    out << "    terms, atoms, formulas, " << program.getFormulas().size() + facts.size() << "\n";
+    out << "};\n";
+}
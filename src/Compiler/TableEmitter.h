@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "DatalogIR.h"
+
+/**
+ * Writes a datalog program as the constant arrays of a ProgramTable
+ * (see ProgramTable.h), defined as a global of the given name. The
+ * arrays are constant-initialized, so nothing runs before the
+ * program is loaded from them
+ */
+class TableEmitter {
+    const StandardDatalog::Program &program;
+    std::string table_name;
+
+public:
+    TableEmitter(const StandardDatalog::Program &program, const std::string &table_name):
+        program(program), table_name(table_name) {}
+
+    void emit(llvm::raw_ostream &out) const;
+};
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cassert>
+
+#include "CompressedRelation.h"
+
+const unsigned int CompressedRelation::SAMPLE_RATE;
+
+CompressedRelation::CompressedRelation(std::vector<std::pair<uint32_t, uint32_t>> tuples) {
+    std::sort(tuples.begin(), tuples.end());
+    tuples.erase(std::unique(tuples.begin(), tuples.end()), tuples.end());
+
+    assert(tuples.size() <= UINT32_MAX && "too many tuples");
+
+    uint64_t num_bits = 0;
+
+    for (size_t begin = 0, end; begin < tuples.size(); begin = end) {
+        end = begin + 1;
+
+        while (end < tuples.size() && tuples[end].first == tuples[begin].first) {
+            end++;
+        }
+
+        uint32_t max_gap = 0;
+
+        for (size_t i = begin + 1; i < end; i++) {
+            max_gap = std::max(max_gap, tuples[i].second - tuples[i - 1].second - 1);
+        }
+
+        // all gaps of 1 take no bits (e.g. consecutive objects)
+        unsigned int width = 0;
+
+        while (width < 32 && (max_gap >> width) != 0) {
+            width++;
+        }
+
+        assert(num_bits <= UINT32_MAX && "too many bits");
+
+        keys.push_back(tuples[begin].first);
+        offsets.push_back(begin);
+        bases.push_back(tuples[begin].second);
+        bit_offsets.push_back(num_bits);
+        widths.push_back(width);
+
+        num_bits += (uint64_t)(end - begin - 1) * width;
+    }
+
+    offsets.push_back(tuples.size());
+
+    // one more word, so that a gap can always be read as two words
+    bits.assign(num_bits / 64 + 2, 0);
+
+    for (size_t row = 0; row < keys.size(); row++) {
+        uint64_t position = bit_offsets[row];
+        unsigned int width = widths[row];
+
+        for (size_t i = offsets[row] + 1; i < offsets[row + 1] && width != 0; i++, position += width) {
+            uint64_t gap = tuples[i].second - tuples[i - 1].second - 1;
+            size_t word = position / 64;
+            unsigned int shift = position % 64;
+
+            bits[word] |= gap << shift;
+
+            if (shift + width > 64) {
+                bits[word + 1] |= gap >> (64 - shift);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < tuples.size(); i += SAMPLE_RATE) {
+        samples.push_back(tuples[i].second);
+    }
+}
+
+long CompressedRelation::findRow(uint32_t first) const {
+    auto found = std::lower_bound(keys.begin(), keys.end(), first);
+
+    if (found == keys.end() || *found != first) {
+        return -1;
+    }
+
+    return found - keys.begin();
+}
+
+bool CompressedRelation::contains(uint32_t first, uint32_t second) const {
+    long row = findRow(first);
+
+    if (row < 0 || second < bases[row]) {
+        return false;
+    }
+
+    // start from the last sample of the row not after the value
+    uint32_t begin = offsets[row], end = offsets[row + 1];
+    uint32_t position = begin;
+    uint32_t value = bases[row];
+
+    size_t first_sample = (begin + SAMPLE_RATE - 1) / SAMPLE_RATE;
+    size_t last_sample = (end + SAMPLE_RATE - 1) / SAMPLE_RATE;
+
+    auto sample = std::upper_bound(samples.begin() + first_sample, samples.begin() + last_sample, second);
+
+    if (sample != samples.begin() + first_sample) {
+        sample--;
+        position = (sample - samples.begin()) * SAMPLE_RATE;
+        value = *sample;
+    }
+
+    while (value < second && ++position < end) {
+        value += getGap(row, position - begin);
+    }
+
+    return value == second;
+}
+
+void CompressedRelation::getRow(uint32_t first, std::vector<uint32_t> &values) const {
+    values.clear();
+
+    long row = findRow(first);
+
+    if (row < 0) {
+        return;
+    }
+
+    uint32_t value = bases[row];
+    values.push_back(value);
+
+    for (uint32_t i = 1; i < offsets[row + 1] - offsets[row]; i++) {
+        value += getGap(row, i);
+        values.push_back(value);
+    }
+}
+
+size_t CompressedRelation::getMemoryUsage() const {
+    return keys.size() * sizeof(uint32_t) +
+           offsets.size() * sizeof(uint32_t) +
+           bases.size() * sizeof(uint32_t) +
+           bit_offsets.size() * sizeof(uint32_t) +
+           widths.size() * sizeof(uint8_t) +
+           bits.size() * sizeof(uint64_t) +
+           samples.size() * sizeof(uint32_t);
+}
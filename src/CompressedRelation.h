@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * A read-only binary relation stored in compressed sparse rows
+ *
+ * The distinct values of the first column are sorted, and each has
+ * a row of the values of the second column, also sorted. The first
+ * value of a row is stored as is, and the others as the gaps to the
+ * one before, bit-packed with the fewest bits that fit the largest
+ * gap of the row. Every 64th tuple is also sampled, so that a
+ * membership test only decodes a few gaps after a binary search
+ *
+ * A tuple takes a few bits in dense rows, against about 48 bytes
+ * as a node of a std::set of pairs
+ */
+class CompressedRelation {
+    std::vector<uint32_t> keys; // first column
+    std::vector<uint32_t> offsets; // first tuple of each row, and the number of tuples
+    std::vector<uint32_t> bases; // first value of each row
+    std::vector<uint32_t> bit_offsets; // of the gaps of each row
+    std::vector<uint8_t> widths; // of the gaps of each row
+    std::vector<uint64_t> bits;
+    std::vector<uint32_t> samples; // value of every 64th tuple
+
+public:
+    static const unsigned int SAMPLE_RATE = 64;
+
+    CompressedRelation() { offsets.push_back(0); }
+
+    /**
+     * Compress a set of tuples, in any order and with duplicates
+     */
+    CompressedRelation(std::vector<std::pair<uint32_t, uint32_t>> tuples);
+
+    size_t size() const { return offsets.back(); }
+    size_t getNumRows() const { return keys.size(); }
+
+    /**
+     * Values of the first column, one per row (sorted)
+     */
+    const std::vector<uint32_t> &getKeys() const { return keys; }
+
+    bool contains(uint32_t first, uint32_t second) const;
+
+    /**
+     * Values of the second column in the row of a value of the first
+     * (sorted, and empty if there is no such row)
+     */
+    void getRow(uint32_t first, std::vector<uint32_t> &values) const;
+
+    /**
+     * Call a function on each tuple (first, second), in order
+     */
+    template<typename Function>
+    void forEach(Function function) const {
+        for (size_t row = 0; row < keys.size(); row++) {
+            uint32_t value = bases[row];
+            function(keys[row], value);
+
+            for (uint32_t i = 1; i < offsets[row + 1] - offsets[row]; i++) {
+                value += getGap(row, i);
+                function(keys[row], value);
+            }
+        }
+    }
+
+    /**
+     * Bytes taken by the relation (excluding the object itself)
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    /**
+     * Index of the row of a value of the first column, or -1
+     */
+    long findRow(uint32_t first) const;
+
+    /**
+     * Gap between the values at i - 1 and i of a row (for 0 < i)
+     */
+    uint32_t getGap(size_t row, uint32_t i) const {
+        unsigned int width = widths[row];
+
+        if (width == 0) {
+            return 1;
+        }
+
+        uint64_t position = bit_offsets[row] + (uint64_t)(i - 1) * width;
+        size_t word = position / 64;
+        unsigned int shift = position % 64;
+
+        // one word of padding at the end keeps the read in bounds
+        uint64_t value = bits[word] >> shift;
+
+        if (shift + width > 64) {
+            value |= bits[word + 1] << (64 - shift);
+        }
+
+        // gaps are at least 1, so 1 less is stored
+        return (uint32_t)(value & ((1ull << width) - 1)) + 1;
+    }
+};
@@ -1,7 +1,28 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 
+#include "BDDBackend.h"
+#include "CompiledBackend.h"
 #include "DatalogAAPass.h"
 #include "DatalogIR.h"
+#include "DistributedBackend.h"
+#include "JoinOrdering.h"
+#include "MagicSets.h"
+#include "NativeBackend.h"
+#include "ProgramImage.h"
+#include "ProgramOptimizer.h"
+#include "ProgramTable.h"
+#include "SetKernels.h"
+#include "TopElements.h"
 #include "ValuePrinter.h"
 #include "Z3Backend.h"
 
@@ -16,12 +37,71 @@ static cl::opt<bool> optionPrintProgram(
     cl::init(false)
 );
 
+static cl::opt<std::string> optionDumpProgram(
+    "datalog-aa-dump-program", cl::NotHidden,
+    cl::desc("Write the program with the facts of the module to a file, as a binary image (see ProgramImage.h)"),
+    cl::value_desc("file"),
+    cl::init("")
+);
+
+static cl::opt<std::string> optionLoadProgram(
+    "datalog-aa-load-program", cl::NotHidden,
+    cl::desc("Run the program of an image written by -datalog-aa-dump-program, "
+             "instead of generating the facts of the module (which must be the same)"),
+    cl::value_desc("file"),
+    cl::init("")
+);
+
+static cl::opt<bool> optionDropDuplicateFacts(
+    "datalog-aa-drop-duplicate-facts", cl::NotHidden,
+    cl::desc("Keep each generated fact once, instead of leaving duplicates to the backend (which keeps sets)"),
+    cl::init(false)
+);
+
+static cl::opt<bool> optionOptimize(
+    "datalog-aa-optimize", cl::NotHidden,
+    cl::desc("Inline rules and remove empty and unused relations before loading the program"),
+    cl::init(true)
+);
+
+static cl::opt<bool> optionReorderJoins(
+    "datalog-aa-reorder-joins", cl::NotHidden,
+    cl::desc("Order the atoms of rule bodies by the estimated cardinalities of the relations"),
+    cl::init(true)
+);
+
+static cl::opt<bool> optionTopElements(
+    "datalog-aa-top-elements", cl::NotHidden,
+    cl::desc("Keep the top of points-to sets that may hold any addressable object, "
+             "instead of deriving each of the objects"),
+    cl::init(true)
+);
+
+static cl::opt<std::string> optionQuery(
+    "datalog-aa-query", cl::NotHidden,
+    cl::desc("Answer a goal-directed query on a value (named as in the points-to relation) "
+             "by magic-sets rewriting"),
+    cl::init("")
+);
+
+static cl::opt<std::string> optionQueryRelation(
+    "datalog-aa-query-relation", cl::NotHidden,
+    cl::desc("Relation queried by -datalog-aa-query, e.g. pointsTo or alias"),
+    cl::init("pointsTo")
+);
+
 static cl::opt<bool> optionPrintPointsTo(
     "datalog-aa-print-points-to", cl::NotHidden,
     cl::desc("Print the entire (may) points-to relation"),
     cl::init(true)
 );
 
+static cl::opt<bool> optionPrintStats(
+    "datalog-aa-print-stats", cl::NotHidden,
+    cl::desc("Print the time spent in each phase of the analysis"),
+    cl::init(false)
+);
+
 static cl::opt<DatalogAAResult::Algorithm> optionAlgorithm(
     "datalog-aa-algorithm", cl::NotHidden,
     cl::desc("Choose the analysis algorithm to use"),
@@ -32,23 +112,158 @@ static cl::opt<DatalogAAResult::Algorithm> optionAlgorithm(
     )
 );
 
-#include "DatalogDSL.h"
+static cl::opt<DatalogAAResult::BackendType> optionBackend(
+    "datalog-aa-backend", cl::NotHidden,
+    cl::desc("Choose the datalog solver to use"),
+    cl::init(DatalogAAResult::Z3),
+    cl::values(
+        clEnumValN(DatalogAAResult::Z3, "z3", "Z3's fixedpoint engine"),
+        clEnumValN(DatalogAAResult::Native, "native", "In-house semi-naive bottom-up evaluation"),
+        clEnumValN(DatalogAAResult::BDD, "bdd", "Relations stored as BDDs, in the style of bddbddb"),
+        clEnumValN(DatalogAAResult::Compiled, "compiled", "Evaluator generated ahead of time by datalog-compile"),
+        clEnumValN(DatalogAAResult::Distributed, "distributed", "Native evaluation across processes, "
+                                                                "with the relations hash-partitioned")
+    )
+);
+
+// for the tests, which must run the generated evaluators
+static cl::opt<bool> optionCompiledFallback(
+    "datalog-aa-compiled-fallback", cl::Hidden,
+    cl::desc("Use the native backend if no compiled evaluator matches the rules (instead of stopping)"),
+    cl::init(true)
+);
+
+static cl::opt<std::string> optionBDDOrdering(
+    "datalog-aa-bdd-order", cl::NotHidden,
+    cl::desc("Variable ordering of the BDD backend in the bddbddb syntax, e.g. Object0xObject1_Object2"),
+    cl::init("")
+);
+
+static cl::opt<bool> optionJIT(
+    "datalog-aa-jit", cl::NotHidden,
+    cl::desc("Compile the join plans of the native backend with the ORC JIT"),
+    cl::init(false)
+);
+
+static cl::opt<NativeBackend::JoinStrategy> optionJoinStrategy(
+    "datalog-aa-join-strategy", cl::NotHidden,
+    cl::desc("Choose how the native backend joins rule bodies"),
+    cl::init(NativeBackend::AutoJoin),
+    cl::values(
+        clEnumValN(NativeBackend::BinaryJoin, "binary", "One atom at a time"),
+        clEnumValN(NativeBackend::LeapfrogJoin, "leapfrog", "Leapfrog triejoin for bodies of three or more atoms"),
+        clEnumValN(NativeBackend::AutoJoin, "auto", "Leapfrog triejoin for those bodies that are cyclic "
+                                                    "or have a variable in three or more atoms")
+    )
+);
+
+static cl::opt<unsigned int> optionThreads(
+    "datalog-aa-threads", cl::NotHidden,
+    cl::desc("Number of threads used by the native backend (0 for all cores)"),
+    cl::init(1)
+);
+
+static cl::opt<unsigned int> optionProcesses(
+    "datalog-aa-processes", cl::NotHidden,
+    cl::desc("Number of processes used by the distributed backend"),
+    cl::init(2)
+);
+
+static cl::opt<std::string> optionMemoryLimit(
+    "datalog-aa-memory-limit", cl::NotHidden,
+    cl::desc("Memory the tables of the native backend may take on the heap, in bytes or "
+             "with a suffix K, M or G (e.g. 512M), past which they move to scratch files"),
+    cl::init("")
+);
+
+static cl::opt<std::string> optionScratchDir(
+    "datalog-aa-scratch-dir", cl::NotHidden,
+    cl::desc("Directory of the scratch files of -datalog-aa-memory-limit (TMPDIR by default)"),
+    cl::init("")
+);
+
+static cl::list<std::string> optionUpdateFunctions(
+    "datalog-aa-update-functions", cl::NotHidden, cl::CommaSeparated,
+    cl::desc("Retract the facts of these functions after solving and add them back, "
+             "updating the result incrementally (to test and time updates)")
+);
+
+static cl::opt<unsigned int> optionGroundQueries(
+    "datalog-aa-ground-queries", cl::NotHidden,
+    cl::desc("Ask this many alias(a, b) questions of random pointers after solving, "
+             "one at a time and then in a batch (to test and time ground queries)"),
+    cl::init(0)
+);
+
+/**
+ * Parse a size with an optional suffix K, M or G, or return 0
+ */
+static size_t parseSize(const std::string &text) {
+    char *end;
+    unsigned long long size = std::strtoull(text.c_str(), &end, 10);
+
+    if (end == text.c_str()) {
+        return 0;
+    }
+
+    const char *units = "KMG";
+    const char *unit = *end ? std::strchr(units, std::toupper(*end)) : NULL;
+
+    if (unit) {
+        size <<= 10 * (unit - units + 1);
+        end++;
+    }
+
+    return *end == '\0' ? size : 0;
+}
+
+/**
+ * The program of an image written by -datalog-aa-dump-program
+ */
+static StandardDatalog::Program loadProgram(const std::string &path) {
+    ProgramImage image;
+    std::string errors;
+    raw_string_ostream out(errors);
+
+    if (!image.open(path, out)) {
+        report_fatal_error(Twine("cannot load the program image ") + path + ": " +
+                           StringRef(out.str()).rtrim(), false);
+    }
+
+    return image.load();
+}
+
+/**
+ * Backends assume a well-formed program, so stop (with what is
+ * wrong) before one is given anything else
+ */
+static void checkProgram(const StandardDatalog::Program &program) {
+    std::string errors;
+    raw_string_ostream out(errors);
+
+    if (!program.isWellFormed(out)) {
+        report_fatal_error(Twine("the program is not well-formed:\n") + StringRef(out.str()).rtrim(), false);
+    }
+}
+
+// analysis programs written by datalog-compile -table (see CMakeLists.txt)
+extern const ProgramTable AndersenProgram;
 
 /**
- * Load analysis programs to be referenced by their names
- * (currently only andersen's is supported)
+ * Analysis programs are loaded from their tables the first time
+ * they are used (currently only andersen's is supported)
  */
-std::map<DatalogAAResult::Algorithm, StandardDatalog::Program>
-DatalogAAResult::analysisMap = {
-    {
-        DatalogAAResult::Andersen,
-        BEGIN
-            #include "Analysis/Andersen.datalog"
-        END
+const StandardDatalog::Program &DatalogAAResult::getAnalysis(Algorithm algorithm) {
+    switch (algorithm) {
+        case Andersen: {
+            static const StandardDatalog::Program program = AndersenProgram.load();
+            return program;
+        }
     }
-};
 
-#include "DatalogDSL.h" // toggle dsl off
+    assert(0 && "unknown algorithm");
+    return getAnalysis(Andersen);
+}
 
 char DatalogAAPass::ID = 0;
 
@@ -61,37 +276,272 @@ static RegisterPass<DatalogAAPass> X(
 );
 
 DatalogAAResult::DatalogAAResult(const llvm::Module &unit):
-    unit(&unit), backend(new Z3Backend()), factGenerator(unit) {
-    StandardDatalog::Program program = analysisMap[optionAlgorithm.getValue()];
+    unit(&unit), factGenerator(unit), backend(createBackend(optionBackend.getValue())) {
+    using Clock = std::chrono::steady_clock;
+
+    bool replay = !optionLoadProgram.getValue().empty();
+    StandardDatalog::Program program =
+        replay ? loadProgram(optionLoadProgram.getValue()) : getAnalysis(optionAlgorithm.getValue());
+
+    auto const &tops = program.getRelation("pointsTo").getTops();
+    auto top = tops.find(1);
+
+    if (top != tops.end()) {
+        pointsToTop.reset(new StandardDatalog::Relation::Top(top->second));
+    }
+
+    Clock::time_point start = Clock::now();
+
+    // the facts of a loaded image are those of the module already
+    if (!replay) {
+        program.setDropDuplicateFacts(optionDropDuplicateFacts.getValue());
+        factGenerator.generateFacts(program);
+    }
+
+    Clock::time_point facts_generated = Clock::now();
+
+    if (!optionDumpProgram.getValue().empty()) {
+        ProgramImage::write(program, optionDumpProgram.getValue(), errs());
+    }
+
+    size_t num_facts = program.getNumFacts();
+    size_t num_duplicate_facts = program.getNumDuplicateFacts();
+    size_t fact_memory = program.getFactMemoryUsage();
 
-    factGenerator.generateFacts(program);
+    std::unique_ptr<TopElements> top_elements;
+    std::unique_ptr<ProgramOptimizer> optimizer;
+
+    bool expand_tops = !optionTopElements.getValue();
+
+    if (expand_tops && optionBackend.getValue() == Compiled) {
+        errs() << "the rules of the compiled backend keep the tops, ignoring -datalog-aa-top-elements\n";
+        expand_tops = false;
+    }
+
+    // no backend stores tops as such
+    if (TopElements::hasTops(program)) {
+        top_elements.reset(new TopElements(program, expand_tops));
+        program = top_elements->getProgram();
+    }
+
+    // the rules of a compiled evaluator cannot change, and
+    // an optimized program cannot take other facts
+    if (optionOptimize.getValue() && optionBackend.getValue() != Compiled && optionUpdateFunctions.empty()) {
+        std::set<std::string> outputs = { "pointsTo" };
+
+        if (pointsToTop) {
+            outputs.insert(pointsToTop->domain);
+        }
+
+        if (!optionQuery.getValue().empty()) {
+            outputs.insert(optionQueryRelation.getValue());
+        }
+
+        if (optionGroundQueries.getValue() != 0) {
+            outputs.insert("alias");
+        }
+
+        optimizer.reset(new ProgramOptimizer(outputs));
+        optimizer->run(program);
+    }
+
+    Clock::time_point optimized = Clock::now();
+    std::unique_ptr<JoinOrdering> ordering;
+
+    // the join orders of a compiled evaluator are fixed at build time
+    if (optionReorderJoins.getValue() && optionBackend.getValue() != Compiled) {
+        ordering.reset(new JoinOrdering(program));
+        program = ordering->getOrderedProgram();
+    }
+
+    Clock::time_point ordered = Clock::now();
+    checkProgram(program);
+
+    if (optionBackend.getValue() == Compiled && !CompiledBackend::hasEvaluator(program)) {
+        if (!optionCompiledFallback.getValue()) {
+            report_fatal_error("no compiled evaluator matches the rules of the program", false);
+        }
+
+        errs() << "no compiled evaluator matches the rules of the program, using the native backend\n";
+        backend.reset(createBackend(Native));
+    }
 
     backend->load(program);
 
+    Clock::time_point loaded = Clock::now();
+    StandardDatalog::FormulaVector function_facts;
+
+    if (!optionUpdateFunctions.empty() && !backend->isIncremental()) {
+        errs() << "the backend cannot update facts, ignoring -datalog-aa-update-functions\n";
+    } else if (!optionUpdateFunctions.empty()) {
+        function_facts = getFunctionFacts(optionUpdateFunctions);
+        backend->retractFacts(function_facts);
+    }
+
+    Clock::time_point retracted = Clock::now();
+
+    if (!function_facts.empty()) {
+        backend->addFacts(function_facts);
+    }
+
+    Clock::time_point updated = Clock::now();
+
     if (optionPrintProgram.getValue()) {
         dbgs() << "================== program\n";
         dbgs() << program << "\n";
         dbgs() << "================== program\n";
+
+        if (ordering) {
+            dbgs() << "================== join order\n";
+            ordering->printPlan(dbgs());
+            dbgs() << "================== join order\n";
+        }
     }
 
     // fetch points to relation
-    StandardDatalog::FormulaVector points_to = backend->query("pointsTo");
-    DatalogAAResult::ConcreteBinaryRelation<unsigned int> concrete_points_to = getConcreteRelation(points_to);
-    pointsToRelation.swap(concrete_points_to);
+    pointsToRelation = getConcreteRelation("pointsTo");
 
-    // fetch alias relation
-    StandardDatalog::FormulaVector alias = backend->query("alias");
-    DatalogAAResult::ConcreteBinaryRelation<unsigned int> concrete_alias = getConcreteRelation(alias);
-    aliasRelation.swap(concrete_alias);
+    if (pointsToTop) {
+        backend->forEachTuple(pointsToTop->domain, [&] (const unsigned int *row) {
+            topDomain.push_back(row[0]);
+        });
+
+        std::sort(topDomain.begin(), topDomain.end());
+    }
 
     if (optionPrintPointsTo.getValue()) {
         printPointsTo(dbgs());
     }
 
-    // record points to set
-    for (auto pair: pointsToRelation) {
-        pointsToSet[pair.first].insert(pair.second);
+    if (optionPrintStats.getValue()) {
+        std::chrono::duration<double> fact_time = facts_generated - start;
+        std::chrono::duration<double> optimization_time = optimized - facts_generated;
+        std::chrono::duration<double> ordering_time = ordered - optimized;
+        std::chrono::duration<double> load_time = loaded - ordered;
+        std::chrono::duration<double> retract_time = retracted - loaded;
+        std::chrono::duration<double> add_time = updated - retracted;
+        std::chrono::duration<double> query_time = Clock::now() - updated;
+
+        dbgs() << "================== statistics\n";
+        dbgs() << "fact generation: " << format("%.3f", fact_time.count()) << "s\n";
+        dbgs() << "facts: " << num_facts << " in " << format("%.1f", fact_memory / 1048576.0) << " MB, "
+               << num_duplicate_facts << " duplicates dropped\n";
+        dbgs() << "optimization: " << format("%.3f", optimization_time.count()) << "s\n";
+
+        if (top_elements) {
+            top_elements->printStatistics(dbgs());
+        }
+
+        if (optimizer) {
+            optimizer->printStatistics(dbgs());
+        }
+
+        dbgs() << "join ordering: " << format("%.3f", ordering_time.count()) << "s\n";
+        dbgs() << "load: " << format("%.3f", load_time.count()) << "s\n";
+
+        if (!function_facts.empty()) {
+            dbgs() << "update: " << function_facts.size() << " facts retracted in "
+                   << format("%.3f", retract_time.count()) << "s, added back in "
+                   << format("%.3f", add_time.count()) << "s\n";
+        }
+
+        dbgs() << "query: " << format("%.3f", query_time.count()) << "s\n";
+        backend->printStatistics(dbgs());
+        dbgs() << "set kernels: " << SetKernels::get().name << "\n";
+        dbgs() << "points-to tuples: " << pointsToRelation.size() << "\n";
+
+        if (pointsToTop) {
+            dbgs() << "points-to top: " << topDomain.size() << " objects\n";
+        }
+
+        if (pointsToRelation.size() != 0) {
+            dbgs() << "points-to storage: "
+                   << format("%.2f", (double)pointsToRelation.getMemoryUsage() / pointsToRelation.size())
+                   << " bytes per tuple\n";
+        }
+        dbgs() << "================== statistics\n";
+    }
+
+    if (!optionQuery.getValue().empty()) {
+        answerQuery(program);
+    }
+
+    if (optionGroundQueries.getValue() != 0) {
+        timeGroundQueries(optionGroundQueries.getValue());
+    }
+}
+
+StandardDatalog::FormulaVector DatalogAAResult::getFunctionFacts(const std::vector<std::string> &names) {
+    // a program declaring the relations to generate the facts in
+    const StandardDatalog::Program &analysis = getAnalysis(optionAlgorithm.getValue());
+    StandardDatalog::Program program;
+
+    for (auto const &item: analysis.getSorts()) {
+        program.addSort(item.second);
+    }
+
+    for (auto const &item: analysis.getRelations()) {
+        program.addRelation(item.second);
+    }
+
+    // the unsupported instructions were reported with the facts of the module
+    factGenerator.setQuiet(true);
+
+    for (auto const &name: names) {
+        const Function *function = unit->getFunction(name);
+
+        if (!function) {
+            errs() << "function " << name << " does not exist\n";
+            continue;
+        }
+
+        factGenerator.generateFacts(program, *function);
+    }
+
+    factGenerator.setQuiet(false);
+
+    StandardDatalog::FormulaVector facts;
+
+    for (auto const &item: program.getFacts()) {
+        for (size_t i = 0; i < item.second->size(); i++) {
+            facts.push_back(item.second->getFormula(i));
+        }
     }
+
+    return facts;
+}
+
+StandardDatalog::Backend *DatalogAAResult::createBackend(BackendType type) {
+    switch (type) {
+        case Z3: return new Z3Backend();
+        case Native: {
+            unsigned int num_threads = optionThreads.getValue();
+
+            if (num_threads == 0) {
+                num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+
+            size_t memory_limit = 0;
+
+            if (!optionMemoryLimit.getValue().empty()) {
+                memory_limit = parseSize(optionMemoryLimit.getValue());
+
+                if (memory_limit == 0) {
+                    errs() << "invalid memory limit " << optionMemoryLimit.getValue() << ", ignored\n";
+                }
+            }
+
+            return new NativeBackend(num_threads, optionJIT.getValue(), optionJoinStrategy.getValue(),
+                                     memory_limit, optionScratchDir.getValue());
+        }
+
+        case BDD: return new BDDBackend(optionBDDOrdering.getValue());
+        case Compiled: return new CompiledBackend();
+        case Distributed: return new DistributedBackend(std::max(optionProcesses.getValue(), 1u));
+    }
+
+    assert(0 && "unknown backend");
+    return NULL;
 }
 
 AliasResult DatalogAAResult::alias(const MemoryLocation &location_a, const MemoryLocation &location_b) {
@@ -109,13 +559,35 @@ AliasResult DatalogAAResult::alias(const MemoryLocation &location_a, const Memor
     }
 
     // should we fallthrough to other analysis?
-    std::pair<unsigned int, unsigned int> pair = std::make_pair(
-        val_a_id, val_b_id
-    );
+    std::vector<unsigned int> &pts_a = pointsToSetA;
+    std::vector<unsigned int> &pts_b = pointsToSetB;
+
+    pointsToRelation.getRow(val_a_id, pts_a);
+    pointsToRelation.getRow(val_b_id, pts_b);
+
+    bool top_a = hasTop(pts_a);
+    bool top_b = hasTop(pts_b);
 
-    if (aliasRelation.find(pair) != aliasRelation.end()) {
-        if (pointsToSet[val_a_id].size() == 1 &&
-            pointsToSet[val_b_id].size() == 1) {
+    if (top_a || top_b) {
+        // with two or more objects in its domain, the top is never
+        // a singleton set, so the sets may alias if either meets it
+        if (topDomain.size() >= 2) {
+            const std::vector<unsigned int> &other = top_a ? pts_b : pts_a;
+
+            if ((top_a && top_b) ||
+                SetKernels::get().intersects(other.data(), other.size(), topDomain.data(), topDomain.size())) {
+                return MayAlias;
+            }
+        } else {
+            expandTop(pts_a);
+            expandTop(pts_b);
+        }
+    }
+
+    // same as the alias relation of the analysis, but
+    // without materializing it (it's quadratic in size)
+    if (SetKernels::get().intersects(pts_a.data(), pts_a.size(), pts_b.data(), pts_b.size())) {
+        if (pts_a.size() == 1 && pts_b.size() == 1) {
             return MustAlias;
         }
 
@@ -139,7 +611,9 @@ bool DatalogAAResult::pointsToConstantMemory(const llvm::MemoryLocation &loc, bo
     assert(factGenerator.hasValue(val) && "value does not exist");
     unsigned int val_id = factGenerator.getObjectIDOfValue(val);
 
-    const std::set<unsigned int> &pts_to_set = pointsToSet[val_id];
+    std::vector<unsigned int> &pts_to_set = pointsToSetA;
+    pointsToRelation.getRow(val_id, pts_to_set);
+    expandTop(pts_to_set);
 
     for (unsigned int pointee: pts_to_set) {
         const Value *pointee_val = factGenerator.getMainValueOfAffiliatedObjectID(pointee);
@@ -159,48 +633,70 @@ bool DatalogAAResult::pointsToConstantMemory(const llvm::MemoryLocation &loc, bo
 }
 
 /**
- * Converts a form vector to a concrete (binary) relation
+ * Reads a binary relation from the backend, streamed
+ * as rows of values instead of formulas
  */
-DatalogAAResult::ConcreteBinaryRelation<unsigned int>
-DatalogAAResult::getConcreteRelation(const StandardDatalog::FormulaVector &relation) {
-    DatalogAAResult::ConcreteBinaryRelation<unsigned int> concrete_relation;
+CompressedRelation DatalogAAResult::getConcreteRelation(const std::string &relation) {
+    std::vector<std::pair<uint32_t, uint32_t>> tuples;
+
+    backend->forEachTuple(relation, [&] (const unsigned int *row) {
+        tuples.push_back(std::make_pair(row[0], row[1]));
+    });
+
+    return CompressedRelation(std::move(tuples));
+}
 
-    for (const StandardDatalog::Formula &pair: relation) {
-        std::pair<unsigned int, unsigned int> item = std::make_pair(
-            pair.getArgument(0).getValue(),
-            pair.getArgument(1).getValue()
-        );
+bool DatalogAAResult::hasTop(const std::vector<unsigned int> &values) const {
+    return pointsToTop && std::binary_search(values.begin(), values.end(), pointsToTop->value);
+}
 
-        concrete_relation.insert(item);
+void DatalogAAResult::expandTop(std::vector<unsigned int> &values) const {
+    if (!hasTop(values)) {
+        return;
     }
 
-    return concrete_relation;
+    std::vector<unsigned int> expanded;
+
+    values.erase(std::lower_bound(values.begin(), values.end(), pointsToTop->value));
+    std::set_union(values.begin(), values.end(), topDomain.begin(), topDomain.end(),
+                   std::back_inserter(expanded));
+
+    values.swap(expanded);
 }
 
 /**
  * Note: some tests depends on the format of this output
  */
 void DatalogAAResult::printPointsTo(llvm::raw_ostream &os) {
+    const std::vector<uint32_t> &pointers = pointsToRelation.getKeys();
+
+    // printed with the top expanded, as if it were not there
+    std::vector<unsigned int> &values = pointsToSetA;
+
     os << "================== all addressable objects\n";
 
-    for (auto pair: pointsToRelation) {
-        unsigned int value_id = pair.second;
+    pointsToRelation.getRow(ANY_OBJECT, values);
+    expandTop(values);
 
-        if (pair.first == ANY_OBJECT) {
-            printObjectID(os, value_id);
-            os << "\n";
-        }
+    for (unsigned int value_id: values) {
+        printObjectID(os, value_id);
+        os << "\n";
     }
 
     os << "================== all addressable objects\n";
 
     os << "================== points-to relation\n";
 
-    for (auto pair: pointsToRelation) {
-        unsigned int pointer_id = pair.first;
-        unsigned int value_id = pair.second;
+    for (unsigned int pointer_id: pointers) {
+        // the top has contents as a plain value when expanded
+        if (pointer_id == ANY_OBJECT || (pointsToTop && pointer_id == pointsToTop->value)) {
+            continue;
+        }
 
-        if (pointer_id != ANY_OBJECT) {
+        pointsToRelation.getRow(pointer_id, values);
+        expandTop(values);
+
+        for (unsigned int value_id: values) {
             // os << result << " <=> ";
             printObjectID(os, pointer_id);
             os << " -> ";
@@ -212,10 +708,159 @@ void DatalogAAResult::printPointsTo(llvm::raw_ostream &os) {
     os << "================== points-to relation\n";
 }
 
+void DatalogAAResult::answerQuery(const StandardDatalog::Program &program) {
+    using Clock = std::chrono::steady_clock;
+
+    const std::string &name = optionQuery.getValue();
+    const std::string &relation = optionQueryRelation.getValue();
+
+    std::vector<unsigned int> ids;
+
+    for (unsigned int id = NUM_SPECIAL_OBJECTS; factGenerator.isValidObjectID(id); id++) {
+        const llvm::Value *value = factGenerator.getValueOfObjectID(id);
+
+        if (value != NULL) {
+            std::string value_name;
+            raw_string_ostream os(value_name);
+
+            ValuePrinter::printUniqueName(os, value);
+
+            if (os.str() == name) {
+                ids.push_back(id);
+            }
+        }
+    }
+
+    if (ids.size() != 1) {
+        errs() << (ids.empty() ? "no value named " : "more than one value named ") << name << "\n";
+        return;
+    }
+
+    unsigned int id = ids[0];
+
+    if (!program.hasRelation(relation) || program.getRelation(relation).getArgumentSortNames().size() != 2) {
+        errs() << "cannot query " << relation << ", which is not a binary relation\n";
+        return;
+    }
+
+    // the rules of a compiled evaluator are fixed, and
+    // do not include those of the rewritten program
+    BackendType type = optionBackend.getValue();
+
+    if (type == Compiled) {
+        errs() << "the compiled backend cannot evaluate rewritten programs, using the native backend\n";
+        type = Native;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    StandardDatalog::Formula query(relation, { StandardDatalog::Term(id), StandardDatalog::Term(std::string("y")) });
+    MagicSets magic_sets(program, query);
+    StandardDatalog::Program rewritten = magic_sets.getProgram();
+
+    // the bindings are passed in the order chosen by MagicSets, but
+    // joining in that order is slow with the deltas of semi-naive
+    // evaluation first, since the magic atoms share few variables
+    if (optionReorderJoins.getValue()) {
+        rewritten = JoinOrdering(rewritten).getOrderedProgram();
+    }
+
+    std::unique_ptr<StandardDatalog::Backend> query_backend(createBackend(type));
+    checkProgram(rewritten);
+    query_backend->load(rewritten);
+
+    StandardDatalog::FormulaVector answers = magic_sets.getAnswers(*query_backend);
+
+    std::chrono::duration<double> query_time = Clock::now() - start;
+
+    std::vector<unsigned int> values;
+
+    for (auto const &answer: answers) {
+        values.push_back(answer.getArgument(1).getValue());
+    }
+
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
+    // the relations sharing the top of pointsTo
+    const StandardDatalog::Program &analysis = getAnalysis(optionAlgorithm.getValue());
+
+    if (pointsToTop && analysis.hasRelation(relation)) {
+        auto const &tops = analysis.getRelation(relation).getTops();
+        auto top = tops.find(1);
+
+        if (top != tops.end() && top->second.value == pointsToTop->value) {
+            expandTop(values);
+        }
+    }
+
+    dbgs() << "================== query\n";
+
+    for (unsigned int value: values) {
+        printObjectID(dbgs(), id);
+        dbgs() << (relation == "pointsTo" ? " -> " : " " + relation + " ");
+        printObjectID(dbgs(), value);
+        dbgs() << "\n";
+    }
+
+    dbgs() << "================== query\n";
+
+    if (optionPrintStats.getValue()) {
+        dbgs() << "magic-sets query: " << format("%.3f", query_time.count()) << "s\n";
+    }
+}
+
+void DatalogAAResult::timeGroundQueries(unsigned int num_queries) {
+    using Clock = std::chrono::steady_clock;
+
+    // the keys are sorted, so the special objects come first
+    const std::vector<uint32_t> &keys = pointsToRelation.getKeys();
+    std::vector<unsigned int> pointers(std::lower_bound(keys.begin(), keys.end(), NUM_SPECIAL_OBJECTS), keys.end());
+
+    if (pointers.empty()) {
+        errs() << "no pointers to ask ground queries of\n";
+        return;
+    }
+
+    // the same pairs on every run
+    std::mt19937 random(0);
+    StandardDatalog::FormulaVector queries;
+
+    for (unsigned int i = 0; i < num_queries; i++) {
+        unsigned int a = pointers[random() % pointers.size()];
+        unsigned int b = pointers[random() % pointers.size()];
+
+        queries.push_back(StandardDatalog::Formula("alias", { StandardDatalog::Term(a), StandardDatalog::Term(b) }));
+    }
+
+    Clock::time_point start = Clock::now();
+    std::vector<bool> answers;
+
+    for (auto const &query: queries) {
+        answers.push_back(backend->query(query));
+    }
+
+    Clock::time_point answered = Clock::now();
+    std::vector<bool> batch_answers = backend->query(queries);
+
+    std::chrono::duration<double> single_time = answered - start;
+    std::chrono::duration<double> batch_time = Clock::now() - answered;
+
+    if (answers != batch_answers) {
+        errs() << "ground queries answered differently in a batch\n";
+    }
+
+    dbgs() << "ground queries: " << num_queries << " of alias ("
+           << std::count(answers.begin(), answers.end(), true) << " true), one at a time "
+           << format("%.3f", single_time.count()) << "s, batched "
+           << format("%.3f", batch_time.count()) << "s\n";
+}
+
 void DatalogAAResult::printObjectID(raw_ostream &os, unsigned int id) {
     if (id < NUM_SPECIAL_OBJECTS) {
         switch (id) {
             case ANY_OBJECT: os << "any"; break;
+            case TOP_OBJECT: os << "top"; break;
             default: os << "special(" << id << ")";
         }
     } else if (factGenerator.isValidObjectID(id)) {
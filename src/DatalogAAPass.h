@@ -3,10 +3,12 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Pass.h"
 
+#include "CompressedRelation.h"
 #include "FactGenerator.h"
 
 class DatalogAAResult: public llvm::AAResultBase<DatalogAAResult> {
@@ -15,19 +17,29 @@ public:
         Andersen
     };
 
-private:
-    static std::map<Algorithm, StandardDatalog::Program> analysisMap;
+    enum BackendType {
+        Z3,
+        Native,
+        BDD,
+        Compiled,
+        Distributed
+    };
 
+private:
     const llvm::Module *unit;
     FactGenerator factGenerator;
-    std::unique_ptr<StandardDatalog::Backend> backend; // TODO: support different backends?
+    std::unique_ptr<StandardDatalog::Backend> backend;
 
-    template<typename T>
-    using ConcreteBinaryRelation = std::set<std::pair<T, T>>;
+    CompressedRelation pointsToRelation;
 
-    ConcreteBinaryRelation<unsigned int> pointsToRelation;
-    ConcreteBinaryRelation<unsigned int> aliasRelation;
-    std::map<unsigned int, std::set<unsigned int>> pointsToSet;
+    // top of the points-to sets (see TopElements.h) and the
+    // sorted objects it stands for, if the analysis has one
+    std::unique_ptr<StandardDatalog::Relation::Top> pointsToTop;
+    std::vector<unsigned int> topDomain;
+
+    // points-to sets decoded for a query
+    std::vector<unsigned int> pointsToSetA;
+    std::vector<unsigned int> pointsToSetB;
 
 public:
     DatalogAAResult(const llvm::Module &unit);
@@ -36,11 +48,38 @@ public:
     bool pointsToConstantMemory(const llvm::MemoryLocation &loc, bool or_local);
 
 private:
-    ConcreteBinaryRelation<unsigned int>
-    getConcreteRelation(const StandardDatalog::FormulaVector &relation);
+    static const StandardDatalog::Program &getAnalysis(Algorithm algorithm);
+
+    static StandardDatalog::Backend *createBackend(BackendType type);
+
+    CompressedRelation getConcreteRelation(const std::string &relation);
+
+    bool hasTop(const std::vector<unsigned int> &values) const;
+
+    /**
+     * Replaces the top in a sorted points-to set by its domain
+     */
+    void expandTop(std::vector<unsigned int> &values) const;
+
+    /**
+     * Facts generated for some functions (for -datalog-aa-update-functions)
+     */
+    StandardDatalog::FormulaVector getFunctionFacts(const std::vector<std::string> &names);
 
     void printPointsTo(llvm::raw_ostream &os);
 
+    /**
+     * Answer the query of -datalog-aa-query on its own
+     * backend (see MagicSets.h) and print the answers
+     */
+    void answerQuery(const StandardDatalog::Program &program);
+
+    /**
+     * Ask alias questions of random pointers one at a time and in
+     * a batch (for -datalog-aa-ground-queries), and print the times
+     */
+    void timeGroundQueries(unsigned int num_queries);
+
     /**
      * Looks up and prints an object id in a readable format
      * Result of this will also be used in testing
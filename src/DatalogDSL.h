@@ -40,7 +40,7 @@ struct DatalogDSLEnvironment {
     DatalogDSLEnvironment() {}
     DatalogDSLEnvironment(const StandardDatalog::Program &program): program(program) {}
 
-    std::string getFreshVariable() {
+    Symbol getFreshVariable() {
         return "_" + std::to_string(variable_counter++);
     }
 };
@@ -80,9 +80,9 @@ struct DatalogDSLAtom {
 
 struct DatalogDSLRelation {
     DatalogDSLEnvironment *env;
-    std::string name;
+    Symbol name;
 
-    DatalogDSLRelation(DatalogDSLEnvironment &env, const std::string &name):
+    DatalogDSLRelation(DatalogDSLEnvironment &env, const Symbol &name):
         env(&env), name(name) {}
 
     template<typename ...Ts>
@@ -103,7 +103,7 @@ struct DatalogDSLWildcard {
     DatalogDSLEnvironment *env;
     DatalogDSLWildcard(DatalogDSLEnvironment &env): env(&env) {}
 
-    operator std::string() {
+    operator Symbol() {
         return env->getFreshVariable();
     }
 };
@@ -133,6 +133,12 @@ inline void operator<<=(const DatalogDSLAtom &head, const DatalogDSLAtom &body)
     #undef HORN
     #undef FACT
     #undef END
+    #undef VALID_NAME
+    #undef sort
+    #undef rel
+    #undef top
+    #undef var
+    #undef fact
     #undef IN_DSL
 #else
     #define IN_DSL
@@ -146,7 +152,7 @@ inline void operator<<=(const DatalogDSLAtom &head, const DatalogDSLAtom &body)
 
     #define sort(name, size) \
         VALID_NAME(#name); \
-        std::string name = #name; \
+        Symbol name = #name; \
         _env.program.addSort(StandardDatalog::Sort(#name, size))
 
     #define rel(name, ...) \
@@ -157,9 +163,12 @@ inline void operator<<=(const DatalogDSLAtom &head, const DatalogDSLAtom &body)
             return DatalogDSLRelation(_env, #name); \
         })()
 
+    #define top(relation, column, value, domain) \
+        _env.program.addTop(#relation, column, value, #domain)
+
     #define var(name) \
         VALID_NAME(#name); \
-        std::string name = #name
+        Symbol name = #name
 
     #define fact _env.is_next_fact = true;
 
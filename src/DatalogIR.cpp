@@ -72,14 +72,14 @@ raw_ostream &operator<<(raw_ostream &out, const StandardDatalog::Relation &relat
 }
 
 raw_ostream &operator<<(raw_ostream &out, const StandardDatalog::Program &program) {
-    for (auto const &item: program.getSorts()) {
-        out << item.second << "\n";
+    for (auto const item: sortByName(program.getSorts())) {
+        out << item->second << "\n";
     }
 
     out << "\n";
 
-    for (auto const &item: program.getRelations()) {
-        out << item.second << "\n";
+    for (auto const item: sortByName(program.getRelations())) {
+        out << item->second << "\n";
     }
 
     out << "\n";
@@ -88,5 +88,11 @@ raw_ostream &operator<<(raw_ostream &out, const StandardDatalog::Program &progra
         out << formula << ".\n";
     }
 
+    for (auto const item: sortByName(program.getFacts())) {
+        for (size_t i = 0; i < item->second->size(); i++) {
+            out << item->second->getFormula(i) << ".\n";
+        }
+    }
+
     return out;
 }
@@ -5,13 +5,21 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <functional>
 
 #include "llvm/Support/raw_ostream.h"
 
+#include "Arena.h"
+#include "Symbol.h"
+
 /**
  * This is a sorted subset of the language bddbddb supports
  * 
@@ -38,10 +46,13 @@ public:
     class Sort;
     class Term;
     class Formula;
+    class FactTable;
+    struct Stratum;
 
     using SymbolVector = std::vector<S>;
     using TermVector = std::vector<Term>;
     using FormulaVector = std::vector<Formula>;
+    using StratumVector = std::vector<Stratum>;
 
     /**
      * A term is either a constant or a variable
@@ -147,8 +158,21 @@ public:
     };
 
     class Relation {
+    public:
+        /**
+         * A top value of a column stands for every value of a unary
+         * domain relation: a tuple with it holds for each of them
+         * in that column (see TopElements.h)
+         */
+        struct Top {
+            C value;
+            S domain;
+        };
+
+    private:
         S name;
         SymbolVector sort_names;
+        std::map<unsigned int, Top> tops; // by column
 
     public:
         Relation(const S &name, const SymbolVector &sort_names):
@@ -173,6 +197,13 @@ public:
 
         const SymbolVector &getArgumentSortNames() const { return sort_names; }
 
+        void setTop(unsigned int column, const C &value, const S &domain) {
+            assert(column < sort_names.size() && "index out of range");
+            tops[column] = Top { value, domain };
+        }
+
+        const std::map<unsigned int, Top> &getTops() const { return tops; }
+
         template<typename ...Ts>
         Formula operator()(Ts ...args) const {
             TermVector terms = parseTermVector<Ts...>(args...);
@@ -183,10 +214,257 @@ public:
         }
     };
 
+    /**
+     * The ground facts of a relation, kept apart from the rules as
+     * rows of its arity, in blocks from an arena of the table
+     *
+     * A row is only kept once: rows are indexed in an open-addressing
+     * hash table of their ids (+ 1, 0 for an empty slot), filled up to
+     * 3/4, and a row already in it is dropped when appended again.
+     * The index can be left out (see setDropDuplicates)
+     */
+    class FactTable {
+        static const unsigned int BLOCK_BITS = 8; // log2 of the rows per block
+        static const size_t MIN_INDEX_SIZE = 16; // only used by value, it has no definition
+
+        S relation_name;
+        unsigned int arity;
+        size_t num_rows = 0;
+        size_t num_duplicates = 0;
+        bool drop_duplicates = true;
+        Arena arena;
+        std::vector<C *> blocks;
+        std::vector<uint32_t> index;
+        unsigned int index_shift = 64; // 64 - log2 of the size of the index
+
+        /**
+         * Slot of a row in the index: a polynomial of its values, mixed by
+         * a multiplication of which the high bits are taken. The low bits
+         * alone would put rows of consecutive values (as ids are given out)
+         * in runs of slots, which linear probing only makes longer
+         */
+        size_t hash(const C *row) const {
+            uint64_t value = 0;
+
+            for (unsigned int col = 0; col < arity; col++) {
+                value = value * 0x9e3779b1u + row[col];
+            }
+
+            return (value * 0x9e3779b97f4a7c15ull) >> index_shift;
+        }
+
+        /**
+         * Slot of the row in the index, or the empty slot it would take
+         */
+        size_t find(const C *row) const {
+            size_t mask = index.size() - 1;
+
+            for (size_t slot = hash(row);; slot = (slot + 1) & mask) {
+                if (index[slot] == 0 || std::equal(row, row + arity, getRow(index[slot] - 1))) {
+                    return slot;
+                }
+            }
+        }
+
+        void grow(size_t size) {
+            std::vector<uint32_t> old_index(size, 0);
+            index.swap(old_index);
+
+            for (index_shift = 64; size > 1; size >>= 1) {
+                index_shift--;
+            }
+
+            for (uint32_t id: old_index) {
+                if (id != 0) {
+                    index[find(getRow(id - 1))] = id;
+                }
+            }
+        }
+
+    public:
+        FactTable(const S &relation_name, unsigned int arity):
+            relation_name(relation_name), arity(arity) {}
+
+        /**
+         * A copy packs the rows into blocks of its own arena,
+         * with the same ids (so the index stays valid)
+         */
+        FactTable(const FactTable &other):
+            relation_name(other.relation_name), arity(other.arity),
+            num_duplicates(other.num_duplicates), drop_duplicates(other.drop_duplicates),
+            index(other.index), index_shift(other.index_shift) {
+            for (size_t i = 0; i < other.size(); i += 1 << BLOCK_BITS) {
+                size_t count = std::min<size_t>(other.size() - i, 1 << BLOCK_BITS);
+                std::copy(other.getRow(i), other.getRow(i) + count * arity, append());
+                num_rows += count;
+            }
+        }
+
+        FactTable &operator=(const FactTable &) = delete;
+
+        const S &getRelationName() const { return relation_name; }
+        unsigned int getArity() const { return arity; }
+        size_t size() const { return num_rows; }
+
+        const C *getRow(size_t i) const {
+            assert(i < num_rows && "index out of range");
+            return blocks[i >> BLOCK_BITS] + (i & ((1 << BLOCK_BITS) - 1)) * arity;
+        }
+
+        Formula getFormula(size_t i) const {
+            const C *row = getRow(i);
+            return Formula(relation_name, TermVector(row, row + arity));
+        }
+
+        size_t getNumDuplicates() const { return num_duplicates; }
+        bool dropsDuplicates() const { return drop_duplicates; }
+
+        /**
+         * Whether rows are looked up in the index when they are
+         * committed, and dropped if they are already kept. Without
+         * it a row is kept as often as it is committed, but the index
+         * (about the size of the rows) is not kept up either
+         */
+        void setDropDuplicates(bool drop) {
+            drop_duplicates = drop;
+
+            if (!drop) {
+                std::vector<uint32_t>().swap(index);
+                index_shift = 64;
+            } else if (index.empty()) {
+                reserve(num_rows);
+
+                for (size_t i = 0; i < num_rows; i++) {
+                    index[find(getRow(i))] = i + 1;
+                }
+            }
+        }
+
+        /**
+         * Space for a new row, to be filled by the caller and then
+         * kept by commit (the space is reused if it's not)
+         */
+        C *append() {
+            if ((num_rows >> BLOCK_BITS) == blocks.size()) {
+                blocks.push_back(arena.allocate<C>(std::max(arity, 1u) << BLOCK_BITS));
+            }
+
+            return blocks[num_rows >> BLOCK_BITS] + (num_rows & ((1 << BLOCK_BITS) - 1)) * arity;
+        }
+
+        /**
+         * Keep the row filled after append, unless it's a
+         * duplicate of another row. Returns if it was kept
+         */
+        bool commit() {
+            assert(num_rows < UINT32_MAX && "too many facts in a relation");
+
+            if (!drop_duplicates) {
+                num_rows++;
+                return true;
+            }
+
+            if ((num_rows + 1) * 4 > index.size() * 3) {
+                grow(std::max(index.size() * 2, size_t(MIN_INDEX_SIZE)));
+            }
+
+            const C *row = blocks[num_rows >> BLOCK_BITS] + (num_rows & ((1 << BLOCK_BITS) - 1)) * arity;
+            size_t slot = find(row);
+
+            if (index[slot] != 0) {
+                num_duplicates++;
+                return false;
+            }
+
+            index[slot] = ++num_rows;
+            return true;
+        }
+
+        /**
+         * Size the index for a number of rows in total, so
+         * that it's not grown again while they are added
+         */
+        void reserve(size_t size) {
+            if (!drop_duplicates) {
+                return;
+            }
+
+            size_t index_size = std::max(index.size(), size_t(MIN_INDEX_SIZE));
+
+            while (size * 4 > index_size * 3) {
+                index_size *= 2;
+            }
+
+            if (index_size > index.size()) {
+                grow(index_size);
+            }
+        }
+
+        bool insert(const C *row) {
+            std::copy(row, row + arity, append());
+            return commit();
+        }
+
+        size_t getMemoryUsage() const {
+            return arena.getMemoryUsage() + blocks.size() * sizeof(C *) + index.size() * sizeof(uint32_t);
+        }
+    };
+
+    /**
+     * A stratum is a strongly connected component
+     * of the relation dependency graph
+     */
+    struct Stratum {
+        SymbolVector relations;
+        bool recursive; // if any relation depends on the stratum itself
+    };
+
+    /**
+     * Copies of a program share its formulas and fact tables, which
+     * are only copied when one of the programs sharing them adds to
+     * them. The rules of an analysis and the facts of a module are
+     * then kept once, through all the rewritings of the program
+     */
     class Program {
+        using FactTablePointer = std::shared_ptr<const FactTable>;
+
         std::map<S, Sort> sorts;
         std::map<S, Relation> relations;
-        FormulaVector formulas;
+        std::shared_ptr<FormulaVector> formulas; // rules, and atoms that are not ground facts
+        std::map<S, FactTablePointer> facts;
+        bool drop_duplicate_facts = true;
+
+        FormulaVector &getMutableFormulas() {
+            if (!formulas) {
+                formulas = std::make_shared<FormulaVector>();
+            } else if (formulas.use_count() > 1) {
+                formulas = std::make_shared<FormulaVector>(*formulas);
+            }
+
+            return *formulas;
+        }
+
+        FactTable &getFactTable(const S &relation) {
+            FactTablePointer &table = facts[relation];
+
+            if (!table) {
+                assert(hasRelation(relation) && "fact added before the relation has been declared");
+
+                unsigned int arity = relations.at(relation).getArgumentSortNames().size();
+                table = std::make_shared<FactTable>(relation, arity);
+            } else if (table.use_count() > 1) {
+                table = std::make_shared<FactTable>(*table);
+            }
+
+            // tables are only const to the other programs sharing them
+            FactTable &mutable_table = const_cast<FactTable &>(*table);
+
+            if (mutable_table.dropsDuplicates() != drop_duplicate_facts) {
+                mutable_table.setDropDuplicates(drop_duplicate_facts);
+            }
+
+            return mutable_table;
+        }
 
     public:
         void addSort(const Sort &sort) {
@@ -199,15 +477,151 @@ public:
             relations.insert(std::make_pair(relation.getName(), relation));
         }
 
+        void addTop(const S &relation, unsigned int column, const C &value, const S &domain) {
+            assert(hasRelation(relation) && "top of a relation not declared");
+            relations.at(relation).setTop(column, value, domain);
+        }
+
+        /**
+         * Ground facts go into the fact table of their relation,
+         * and only the other formulas into the list of formulas
+         */
         void addFormula(const Formula &formula) {
             assert(hasRelation(formula.getRelationName()) &&
                    "formula added before the relation has been declared");
-            formulas.push_back(formula);
+
+            bool is_fact = formula.isAtom() && !formula.isNegated() &&
+                           formula.getArity() == relations.at(formula.getRelationName()).getArgumentSortNames().size();
+
+            for (auto const &term: formula.getArguments()) {
+                is_fact &= !term.isVariable();
+            }
+
+            if (!is_fact) {
+                getMutableFormulas().push_back(formula);
+                return;
+            }
+
+            FactTable &table = getFactTable(formula.getRelationName());
+            C *row = table.append();
+
+            for (auto const &term: formula.getArguments()) {
+                *row++ = term.getValue();
+            }
+
+            table.commit();
+        }
+
+        /**
+         * Whether a fact already in the program is dropped when it's
+         * added again (the default), or kept as often as it's added,
+         * which saves the indices of the fact tables when there are
+         * few duplicates, or a backend keeps its relations as sets
+         */
+        void setDropDuplicateFacts(bool drop) { drop_duplicate_facts = drop; }
+
+        /**
+         * Add a ground fact as a row of the arity of its relation.
+         * Returns false if the fact is already in the program (and
+         * duplicates are dropped)
+         */
+        bool addFact(const S &relation, const C *row) {
+            return getFactTable(relation).insert(row);
+        }
+
+        /**
+         * e.g. addFact(relation, 1, 2), without building a formula
+         */
+        template<typename ...Ts>
+        bool addFact(const Relation &relation, Ts ...values) {
+            const C row[sizeof...(Ts) + 1] = { C(values)... };
+            assert(sizeof...(Ts) == relation.getArgumentSortNames().size() &&
+                   "number of values does not match the number of sorts");
+
+            return addFact(relation.getName(), row);
+        }
+
+        /**
+         * Add the facts of a table (of another program), which
+         * is shared instead if the relation has no facts yet
+         */
+        void addFacts(const FactTablePointer &table) {
+            if (table->size() == 0) {
+                return;
+            }
+
+            const S &relation = table->getRelationName();
+            auto found = facts.find(relation);
+
+            if (found == facts.end() || found->second->size() == 0) {
+                assert(hasRelation(relation) && "fact added before the relation has been declared");
+                assert(table->getArity() == relations.at(relation).getArgumentSortNames().size() &&
+                       "facts of a different arity");
+
+                facts[relation] = table;
+                return;
+            }
+
+            FactTable &target = getFactTable(relation);
+
+            for (size_t i = 0; i < table->size(); i++) {
+                target.insert(table->getRow(i));
+            }
         }
 
         const std::map<S, Sort> &getSorts() const { return sorts; }
         const std::map<S, Relation> &getRelations() const { return relations; }
-        const FormulaVector &getFormulas() const { return formulas; }
+        const FormulaVector &getFormulas() const {
+            static const FormulaVector empty;
+            return formulas ? *formulas : empty;
+        }
+
+        /**
+         * Fact tables by relation (a relation may have none)
+         */
+        const std::map<S, FactTablePointer> &getFacts() const { return facts; }
+
+        bool hasFacts(const S &relation) const {
+            auto found = facts.find(relation);
+            return found != facts.end() && found->second->size() != 0;
+        }
+
+        size_t getNumFacts() const {
+            size_t num_facts = 0;
+
+            for (auto const &item: facts) {
+                num_facts += item.second->size();
+            }
+
+            return num_facts;
+        }
+
+        /**
+         * Number of facts dropped since they were already in the
+         * program (see setDropDuplicateFacts)
+         */
+        size_t getNumDuplicateFacts() const {
+            size_t num_duplicates = 0;
+
+            for (auto const &item: facts) {
+                num_duplicates += item.second->getNumDuplicates();
+            }
+
+            return num_duplicates;
+        }
+
+        /**
+         * Bytes taken by the fact tables (including those shared)
+         */
+        size_t getFactMemoryUsage() const {
+            size_t num_bytes = 0;
+
+            for (auto const &item: facts) {
+                num_bytes += item.second->getMemoryUsage();
+            }
+
+            return num_bytes;
+        }
 
         bool hasSort(const S &name) const {
             return sorts.find(name) != sorts.end();
@@ -222,11 +636,248 @@ public:
             return relations.at(name);
         }
 
-        // TODO: add well-formness check
-        // to guarantee decidability, need to check
-        //   1. all relations and formulas are well-formed
-        //   2. negations can be stratified
-        bool isWellFormed() const;
+        /**
+         * Compute the strata of all relations in evaluation order,
+         * i.e. a relation only depends on relations in the same
+         * stratum or an earlier one
+         */
+        StratumVector getStrata() const {
+            std::map<S, SymbolVector> dependencies;
+
+            for (auto const &formula: getFormulas()) {
+                SymbolVector &targets = dependencies[formula.getRelationName()];
+
+                for (auto const &atom: formula.getBody()) {
+                    targets.push_back(atom.getRelationName());
+                }
+            }
+
+            // Tarjan's algorithm: an SCC is completed only after
+            // all SCCs it depends on
+            std::map<S, unsigned int> order;
+            std::map<S, unsigned int> low_link;
+            std::set<S> on_stack;
+            SymbolVector stack;
+            StratumVector strata;
+
+            std::function<void (const S &)> visit = [&] (const S &relation) {
+                unsigned int index = order.size();
+                order[relation] = low_link[relation] = index;
+                stack.push_back(relation);
+                on_stack.insert(relation);
+
+                for (auto const &dependency: dependencies[relation]) {
+                    if (order.find(dependency) == order.end()) {
+                        visit(dependency);
+                        low_link[relation] = std::min(low_link[relation], low_link[dependency]);
+                    } else if (on_stack.find(dependency) != on_stack.end()) {
+                        low_link[relation] = std::min(low_link[relation], order[dependency]);
+                    }
+                }
+
+                if (low_link[relation] != order[relation]) {
+                    return;
+                }
+
+                Stratum stratum;
+                S member;
+
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack.erase(member);
+                    stratum.relations.push_back(member);
+                } while (member != relation);
+
+                std::set<S> members(stratum.relations.begin(), stratum.relations.end());
+                stratum.recursive = false;
+
+                for (auto const &member: stratum.relations) {
+                    for (auto const &dependency: dependencies[member]) {
+                        stratum.recursive |= members.find(dependency) != members.end();
+                    }
+                }
+
+                strata.push_back(stratum);
+            };
+
+            for (auto const &item: relations) {
+                if (order.find(item.first) == order.end()) {
+                    visit(item.first);
+                }
+            }
+
+            return strata;
+        }
+
+        /**
+         * Check that the program can be evaluated, printing the
+         * problems found:
+         *   1. relations only use declared sorts, and formulas declared
+         *      relations with the right arities and constants in range
+         *   2. facts are ground, and every variable of a rule is bound
+         *      by a positive atom of its body (range restriction)
+         *   3. negations can be stratified, i.e. no relation depends
+         *      negatively on a relation of its own stratum
+         */
+        bool isWellFormed(llvm::raw_ostream &errors) const {
+            bool well_formed = true;
+
+            for (auto const &item: relations) {
+                for (auto const &sort: item.second.getArgumentSortNames()) {
+                    if (!hasSort(sort)) {
+                        errors << "relation " << item.first << " uses undeclared sort " << sort << "\n";
+                        well_formed = false;
+                    }
+                }
+
+                for (auto const &top: item.second.getTops()) {
+                    const S &domain = top.second.domain;
+                    auto found = relations.find(domain);
+
+                    if (found == relations.end() || found->second.getArgumentSortNames().size() != 1 ||
+                        found->second.getArgumentSortName(0) != item.second.getArgumentSortName(top.first)) {
+                        errors << "top of " << item.first << " has domain " << domain
+                               << ", which is not a unary relation of the sort of its column\n";
+                        well_formed = false;
+                    }
+                }
+            }
+
+            if (!well_formed) {
+                return false;
+            }
+
+            for (auto const &item: facts) {
+                const FactTable &table = *item.second;
+                std::vector<const Sort *> column_sorts;
+
+                for (auto const &sort: relations.at(item.first).getArgumentSortNames()) {
+                    column_sorts.push_back(&sorts.at(sort));
+                }
+
+                for (size_t i = 0; i < table.size(); i++) {
+                    const C *row = table.getRow(i);
+
+                    for (unsigned int col = 0; col < table.getArity(); col++) {
+                        if (row[col] >= column_sorts[col]->getSize()) {
+                            errors << "constant " << row[col] << " in a fact of " << item.first
+                                   << " is out of the range of sort " << column_sorts[col]->getName() << "\n";
+                            well_formed = false;
+                        }
+                    }
+                }
+            }
+
+            auto check_atom = [&] (const Formula &atom, const S &rule_name) {
+                if (!hasRelation(atom.getRelationName())) {
+                    errors << "rule of " << rule_name << " uses undeclared relation "
+                           << atom.getRelationName() << "\n";
+                    return false;
+                }
+
+                const Relation &relation = relations.at(atom.getRelationName());
+
+                if (atom.getArity() != relation.getArgumentSortNames().size()) {
+                    errors << "atom of " << atom.getRelationName() << " in a formula of " << rule_name
+                           << " has " << atom.getArity() << " arguments instead of "
+                           << relation.getArgumentSortNames().size() << "\n";
+                    return false;
+                }
+
+                for (unsigned int i = 0; i < atom.getArity(); i++) {
+                    const Term &term = atom.getArgument(i);
+                    const Sort &sort = sorts.at(relation.getArgumentSortName(i));
+
+                    if (!term.isVariable() && term.getValue() >= sort.getSize()) {
+                        errors << "constant " << term.getValue() << " in a formula of " << rule_name
+                               << " is out of the range of sort " << sort.getName() << "\n";
+                        return false;
+                    }
+                }
+
+                return true;
+            };
+
+            for (auto const &formula: getFormulas()) {
+                const S &name = formula.getRelationName();
+
+                if (!check_atom(formula, name)) {
+                    well_formed = false;
+                    continue;
+                }
+
+                if (formula.isNegated()) {
+                    errors << "formula of " << name << " has a negated head\n";
+                    well_formed = false;
+                    continue;
+                }
+
+                std::set<S> bound;
+
+                for (auto const &atom: formula.getBody()) {
+                    well_formed &= check_atom(atom, name);
+
+                    if (!atom.isNegated()) {
+                        for (auto const &term: atom.getArguments()) {
+                            if (term.isVariable()) {
+                                bound.insert(term.getVariable());
+                            }
+                        }
+                    }
+                }
+
+                auto check_bound = [&] (const Formula &atom) {
+                    for (auto const &term: atom.getArguments()) {
+                        if (term.isVariable() && bound.find(term.getVariable()) == bound.end()) {
+                            errors << (formula.isAtom() ? "fact" : "rule") << " of " << name << " has variable "
+                                   << term.getVariable() << " not bound by a positive atom\n";
+                            return false;
+                        }
+                    }
+
+                    return true;
+                };
+
+                well_formed &= check_bound(formula);
+
+                for (auto const &atom: formula.getBody()) {
+                    if (atom.isNegated()) {
+                        well_formed &= check_bound(atom);
+                    }
+                }
+            }
+
+            if (!well_formed) {
+                return false;
+            }
+
+            std::map<S, unsigned int> stratum_ids;
+            StratumVector strata = getStrata();
+
+            for (unsigned int i = 0; i < strata.size(); i++) {
+                for (auto const &name: strata[i].relations) {
+                    stratum_ids[name] = i;
+                }
+            }
+
+            for (auto const &formula: getFormulas()) {
+                for (auto const &atom: formula.getBody()) {
+                    if (atom.isNegated() &&
+                        stratum_ids.at(atom.getRelationName()) == stratum_ids.at(formula.getRelationName())) {
+                        errors << "negation of " << atom.getRelationName() << " in a rule of "
+                               << formula.getRelationName() << " cannot be stratified\n";
+                        well_formed = false;
+                    }
+                }
+            }
+
+            return well_formed;
+        }
+
+        bool isWellFormed() const {
+            return isWellFormed(llvm::nulls());
+        }
     };
 
     class Backend {
@@ -248,6 +899,65 @@ public:
         virtual FormulaVector query(const Relation &relation) {
             return query(relation.getName());
         }
+
+        /**
+         * Check the truth of many ground formulas at once, which a
+         * backend may answer from a single solve (in the same order)
+         */
+        virtual std::vector<bool> query(const FormulaVector &formulas) {
+            std::vector<bool> answers;
+
+            for (auto const &formula: formulas) {
+                answers.push_back(query(formula));
+            }
+
+            return answers;
+        }
+
+        /**
+         * Visit each tuple of an entire relation as a row of its values,
+         * without building formulas (the row is only valid in the call)
+         */
+        virtual void forEachTuple(const S &relation_name, const std::function<void (const C *)> &visitor) {
+            std::vector<C> row;
+
+            for (auto const &fact: query(relation_name)) {
+                row.clear();
+
+                for (auto const &term: fact.getArguments()) {
+                    row.push_back(term.getValue());
+                }
+
+                visitor(row.data());
+            }
+        }
+
+        /**
+         * If the facts of the loaded program can be changed
+         * by addFacts and retractFacts (without loading it again)
+         */
+        virtual bool isIncremental() const { return false; }
+
+        /**
+         * Add ground facts to the loaded program, and update
+         * the relations derived from them
+         */
+        virtual void addFacts(const FormulaVector &) {
+            assert(0 && "the backend cannot update facts");
+        }
+
+        /**
+         * Remove ground facts from the loaded program (those not in
+         * it are ignored), and update the relations derived from them
+         */
+        virtual void retractFacts(const FormulaVector &) {
+            assert(0 && "the backend cannot update facts");
+        }
+
+        /**
+         * Backend-specific statistics (for -datalog-aa-print-stats)
+         */
+        virtual void printStatistics(llvm::raw_ostream &) const {}
     };
 
     /**
@@ -315,7 +1025,7 @@ public:
     }
 };
 
-using StandardDatalog = Datalog<std::string, unsigned int>;
+using StandardDatalog = Datalog<Symbol, unsigned int>;
 
 /**
  * Prints out the program in the bddbddb syntax
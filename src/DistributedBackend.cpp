@@ -0,0 +1,672 @@
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "llvm/Support/Format.h"
+
+#include "DistributedBackend.h"
+
+#define MAX_ARITY 32
+
+/**
+ * A process cannot go on without the others, so
+ * a failure to communicate with one is fatal
+ */
+static void fail(const char *what) {
+    std::cerr << "distributed backend: " << what << ": " << std::strerror(errno) << std::endl;
+    std::abort();
+}
+
+DistributedBackend::DistributedBackend(unsigned int num_processes):
+    NativeBackend(1, false, BinaryJoin), num_processes(num_processes) {
+    assert(num_processes > 0 && "need at least one process");
+}
+
+void DistributedBackend::load(const StandardDatalog::Program &program) {
+    compileProgram(program);
+    choosePartitionColumns();
+
+    num_rounds = 0;
+    bytes_sent = 0;
+
+    spawnProcesses();
+    partitionTables();
+
+    for (auto const &stratum: strata) {
+        evaluateDistributed(stratum);
+    }
+
+    gather();
+
+    if (rank != 0) {
+        // skip the exit handlers of the process forked from
+        _exit(0);
+    }
+
+    for (unsigned int other = 1; other < num_processes; other++) {
+        int status;
+
+        if (wait(&status) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fail("a process failed");
+        }
+    }
+
+    for (int socket: sockets) {
+        if (socket != -1) {
+            close(socket);
+        }
+    }
+
+    sockets.clear();
+}
+
+void DistributedBackend::choosePartitionColumns() {
+    std::vector<std::vector<unsigned int>> votes(tables.size());
+
+    for (unsigned int relation = 0; relation < tables.size(); relation++) {
+        votes[relation].assign(std::max(tables[relation]->getArity(), 1u), 0);
+    }
+
+    // the plans are the same as in evaluateDistributed
+    for (auto const &stratum: strata) {
+        for (unsigned int i: stratum.rules) {
+            const Rule &rule = rules[i];
+            std::vector<JoinPlan> plans;
+
+            for (unsigned int j = 0; j < rule.body.size(); j++) {
+                if (!rule.body[j].negated && isInStratum(stratum, rule.body[j].relation)) {
+                    plans.push_back(planRule(rule, stratum, j));
+                }
+            }
+
+            if (plans.empty()) {
+                plans.push_back(planRule(rule, stratum, -1));
+            }
+
+            for (auto const &plan: plans) {
+                for (auto const &step: plan.steps) {
+                    unsigned int relation = rule.body[step.atom].relation;
+
+                    for (unsigned int col = 0; col < tables[relation]->getArity(); col++) {
+                        votes[relation][col] += (step.mask >> col) & 1;
+                    }
+                }
+            }
+        }
+    }
+
+    partition_columns.clear();
+
+    for (auto const &relation_votes: votes) {
+        partition_columns.push_back(std::max_element(relation_votes.begin(), relation_votes.end()) -
+                                    relation_votes.begin());
+    }
+}
+
+void DistributedBackend::spawnProcesses() {
+    // a socket pair between each two processes
+    std::vector<std::vector<int>> ends(num_processes, std::vector<int>(num_processes, -1));
+
+    for (unsigned int a = 0; a < num_processes; a++) {
+        for (unsigned int b = a + 1; b < num_processes; b++) {
+            int pair[2];
+
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                fail("cannot create a socket pair");
+            }
+
+            ends[a][b] = pair[0];
+            ends[b][a] = pair[1];
+        }
+    }
+
+    rank = 0;
+
+    for (unsigned int other = 1; other < num_processes; other++) {
+        pid_t pid = fork();
+
+        if (pid == -1) {
+            fail("cannot fork");
+        }
+
+        if (pid == 0) {
+            rank = other;
+            break;
+        }
+    }
+
+    for (unsigned int a = 0; a < num_processes; a++) {
+        for (unsigned int b = 0; b < num_processes; b++) {
+            if (a != rank && ends[a][b] != -1) {
+                close(ends[a][b]);
+            }
+        }
+    }
+
+    sockets = ends[rank];
+
+    for (int socket: sockets) {
+        if (socket != -1) {
+            fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+        }
+    }
+}
+
+void DistributedBackend::partitionTables() {
+    for (unsigned int relation = 0; relation < tables.size(); relation++) {
+        const Table &old_table = *tables[relation];
+        std::unique_ptr<Table> table(new Table(old_table.getArity(), scratch.get()));
+
+        for (auto const &order: index_selection->getOrders(relation_names[relation])) {
+            table->addIndex(order);
+        }
+
+        for (unsigned int id = 0; id < old_table.size(); id++) {
+            const Value *row = old_table.getRow(id);
+
+            if (getOwner(relation, row) == rank) {
+                table->insert(row);
+            }
+        }
+
+        tables[relation] = std::move(table);
+    }
+}
+
+unsigned int DistributedBackend::getOwner(const Atom &atom, const Value *slots) const {
+    if (atom.args.empty()) {
+        return 0;
+    }
+
+    const Argument &arg = atom.args[partition_columns[atom.relation]];
+    Value value = arg.is_var ? slots[arg.value] : arg.value;
+
+    return Table::hash(&value, 1) % num_processes;
+}
+
+unsigned int DistributedBackend::getOwner(unsigned int relation, const Value *row) const {
+    if (tables[relation]->getArity() == 0) {
+        return 0;
+    }
+
+    return Table::hash(&row[partition_columns[relation]], 1) % num_processes;
+}
+
+/**
+ * Evaluation
+ */
+
+void DistributedBackend::Bindings::insert(const std::vector<Value> &slots) {
+    for (unsigned int i = 0; i < live.size(); i++) {
+        projected[i] = live[i] ? slots[i] : 0;
+    }
+
+    table.insert(projected.data());
+}
+
+std::vector<DistributedBackend::Stage> DistributedBackend::getStages(const JoinPlan &plan) const {
+    const Rule &rule = *plan.rule;
+    std::vector<Stage> stages;
+
+    for (unsigned int i = 0; i < plan.steps.size(); i++) {
+        const Atom &atom = rule.body[plan.steps[i].atom];
+        bool broadcast = !atom.args.empty() && !((plan.steps[i].mask >> partition_columns[atom.relation]) & 1);
+
+        stages.push_back({ Stage::JOIN, i, broadcast, {} });
+    }
+
+    for (unsigned int i: plan.negations) {
+        stages.push_back({ Stage::NEGATION, i, false, {} });
+    }
+
+    stages.push_back({ Stage::HEAD, 0, false, {} });
+
+    // backwards from the head, which reads all its variables
+    std::vector<bool> live(rule.num_vars, false);
+
+    for (size_t i = stages.size(); i-- > 0;) {
+        Stage &stage = stages[i];
+
+        auto read = [&] (const Atom &atom, unsigned int mask) {
+            for (unsigned int col = 0; col < atom.args.size(); col++) {
+                if (atom.args[col].is_var && ((mask >> col) & 1)) {
+                    live[atom.args[col].value] = true;
+                }
+            }
+        };
+
+        if (stage.kind == Stage::JOIN) {
+            const JoinStep &step = plan.steps[stage.index];
+
+            // the variables bound by the step are not read before it
+            for (auto const &bind: step.binds) {
+                live[bind.second] = false;
+            }
+
+            read(rule.body[step.atom], step.mask);
+        } else {
+            read(stage.kind == Stage::HEAD ? rule.head : rule.body[stage.index], ~0u);
+        }
+
+        stage.live = live;
+    }
+
+    return stages;
+}
+
+const NativeBackend::Atom &DistributedBackend::getAtom(const JoinPlan &plan, const Stage &stage) const {
+    switch (stage.kind) {
+        case Stage::JOIN: return plan.rule->body[plan.steps[stage.index].atom];
+        case Stage::NEGATION: return plan.rule->body[stage.index];
+        case Stage::HEAD: return plan.rule->head;
+    }
+
+    assert(0 && "unknown stage");
+    return plan.rule->head;
+}
+
+void DistributedBackend::evaluateDistributed(const Stratum &stratum) {
+    std::vector<JoinPlan> base_plans;
+    std::vector<JoinPlan> delta_plans;
+
+    for (unsigned int i: stratum.rules) {
+        const Rule &rule = rules[i];
+        bool recursive = false;
+
+        for (unsigned int j = 0; j < rule.body.size(); j++) {
+            if (!rule.body[j].negated && isInStratum(stratum, rule.body[j].relation)) {
+                delta_plans.push_back(planRule(rule, stratum, j));
+                recursive = true;
+            }
+        }
+
+        if (!recursive) {
+            base_plans.push_back(planRule(rule, stratum, -1));
+        }
+    }
+
+    runPlans(base_plans);
+    commitDerived(stratum);
+
+    if (!stratum.recursive) {
+        return;
+    }
+
+    for (unsigned int relation: stratum.relations) {
+        delta_begin[relation] = 0;
+        delta_end[relation] = tables[relation]->size();
+    }
+
+    // the fixpoint is only reached when no process derives anything new
+    do {
+        runPlans(delta_plans);
+    } while (reduceOr(commitDerived(stratum)));
+}
+
+void DistributedBackend::runPlans(const std::vector<JoinPlan> &plans) {
+    Run run(plans);
+    size_t num_stages = 0;
+
+    for (auto const &plan: plans) {
+        for (auto const &step: plan.steps) {
+            if (step.mask != 0) {
+                tables[plan.rule->body[step.atom].relation]->updateIndex(step.index);
+            }
+        }
+
+        run.stages.push_back(getStages(plan));
+        run.waiting.emplace_back();
+
+        for (auto const &stage: run.stages.back()) {
+            run.waiting.back().emplace_back(new Bindings(stage.live));
+        }
+
+        num_stages = std::max(num_stages, run.stages.back().size());
+    }
+
+    // every plan starts from a single empty binding
+    std::vector<Value> slots;
+
+    if (rank == 0) {
+        for (unsigned int i = 0; i < plans.size(); i++) {
+            slots.assign(plans[i].rule->num_vars, 0);
+            advance(run, i, 0, slots);
+        }
+    }
+
+    std::vector<std::vector<Value>> outgoing(num_processes);
+    std::vector<Value> incoming;
+
+    // the processes go through the same number of rounds, all at once
+    for (unsigned int stage_index = 0; stage_index < num_stages; stage_index++) {
+        // send each binding as a record (plan, slots...)
+        for (unsigned int i = 0; i < plans.size(); i++) {
+            if (stage_index >= run.stages[i].size()) {
+                continue;
+            }
+
+            const Stage &stage = run.stages[i][stage_index];
+            const Rule &rule = *plans[i].rule;
+            const Bindings &bindings = *run.waiting[i][stage_index];
+
+            for (unsigned int j = 0; j < bindings.size(); j++) {
+                const Value *binding = bindings.get(j);
+                unsigned int owner = stage.broadcast ? rank : getOwner(getAtom(plans[i], stage), binding);
+
+                for (unsigned int process = 0; process < num_processes; process++) {
+                    if (process != rank && (stage.broadcast || process == owner)) {
+                        outgoing[process].push_back(i);
+                        outgoing[process].insert(outgoing[process].end(), binding, binding + rule.num_vars);
+                    }
+                }
+            }
+
+            run.waiting[i][stage_index].reset();
+        }
+
+        exchange(outgoing, incoming);
+        num_rounds++;
+
+        for (size_t offset = 0; offset < incoming.size();) {
+            unsigned int i = incoming[offset];
+            unsigned int num_vars = plans[i].rule->num_vars;
+
+            slots.assign(incoming.begin() + offset + 1, incoming.begin() + offset + 1 + num_vars);
+            offset += 1 + num_vars;
+
+            runStage(run, i, stage_index, slots);
+        }
+    }
+}
+
+void DistributedBackend::advance(Run &run, unsigned int plan, unsigned int stage_index, std::vector<Value> &slots) {
+    const Stage &stage = run.stages[plan][stage_index];
+
+    bool local = stage.broadcast || getOwner(getAtom(run.plans[plan], stage), slots.data()) == rank;
+    bool remote = stage.broadcast ? num_processes > 1 : !local;
+
+    if (remote) {
+        run.waiting[plan][stage_index]->insert(slots);
+    }
+
+    if (local) {
+        runStage(run, plan, stage_index, slots);
+    }
+}
+
+void DistributedBackend::runStage(Run &run, unsigned int plan_index, unsigned int stage_index,
+                                  std::vector<Value> &slots) {
+    const JoinPlan &plan = run.plans[plan_index];
+    const Stage &stage = run.stages[plan_index][stage_index];
+    const Atom &atom = getAtom(plan, stage);
+
+    Value tuple[MAX_ARITY];
+
+    for (unsigned int col = 0; col < atom.args.size() && stage.kind != Stage::JOIN; col++) {
+        tuple[col] = atom.args[col].is_var ? slots[atom.args[col].value] : atom.args[col].value;
+    }
+
+    switch (stage.kind) {
+        case Stage::JOIN:
+            extend(plan, plan.steps[stage.index], slots, [&] () {
+                advance(run, plan_index, stage_index + 1, slots);
+            });
+
+            break;
+
+        case Stage::NEGATION:
+            if (!tables[atom.relation]->contains(tuple)) {
+                advance(run, plan_index, stage_index + 1, slots);
+            }
+
+            break;
+
+        case Stage::HEAD:
+            emitTuple(atom.relation, tuple, derived[0]);
+            break;
+    }
+}
+
+template<typename Function>
+void DistributedBackend::extend(const JoinPlan &plan, const JoinStep &step,
+                                std::vector<Value> &slots, Function function) const {
+    const Table &table = *tables[plan.rule->body[step.atom].relation];
+    auto range = getRange(plan, step);
+
+    Value key[MAX_ARITY];
+
+    for (unsigned int i = 0; i < step.key.size(); i++) {
+        key[i] = step.key[i].is_var ? slots[step.key[i].value] : step.key[i].value;
+    }
+
+    auto visit_row = [&] (unsigned int id) {
+        const Value *row = table.getRow(id);
+
+        for (auto const &bind: step.binds) {
+            slots[bind.second] = row[bind.first];
+        }
+
+        for (auto const &check: step.checks) {
+            if (row[check.first] != slots[check.second]) {
+                return;
+            }
+        }
+
+        function();
+    };
+
+    if (step.mask == 0) {
+        for (unsigned int id = range.first; id < range.second; id++) {
+            visit_row(id);
+        }
+    } else {
+        auto candidates = table.lookup(step.index, step.key.size(), key);
+
+        for (const unsigned int *id = candidates.first; id != candidates.second; id++) {
+            if (*id >= range.first && *id < range.second) {
+                visit_row(*id);
+            }
+        }
+    }
+}
+
+/**
+ * Communication
+ */
+
+void DistributedBackend::exchange(std::vector<std::vector<Value>> &outgoing, std::vector<Value> &incoming) {
+    incoming.swap(outgoing[rank]);
+    outgoing[rank].clear();
+
+    // each message is its number of values, then the values
+    struct Transfer {
+        uint64_t send_size = 0;
+        size_t sent = 0;
+        uint64_t receive_size = 0;
+        size_t received = 0;
+        std::vector<Value> values;
+    };
+
+    std::vector<Transfer> transfers(num_processes);
+    unsigned int num_pending = 0;
+
+    for (unsigned int process = 0; process < num_processes; process++) {
+        if (process != rank) {
+            transfers[process].send_size = outgoing[process].size();
+            num_pending += 2;
+        }
+    }
+
+    const size_t header = sizeof(uint64_t);
+
+    // the bytes of a message from an offset, in the header or the values
+    auto message_bytes = [&] (uint64_t &size, std::vector<Value> &values, size_t offset,
+                              char *&data, size_t &length) {
+        if (offset < header) {
+            data = (char *)&size + offset;
+            length = header - offset;
+        } else {
+            data = (char *)values.data() + (offset - header);
+            length = header + size * sizeof(Value) - offset;
+        }
+    };
+
+    std::vector<pollfd> fds;
+
+    while (num_pending != 0) {
+        fds.clear();
+
+        for (unsigned int process = 0; process < num_processes; process++) {
+            Transfer &transfer = transfers[process];
+
+            if (process == rank) {
+                continue;
+            }
+
+            short events = 0;
+
+            if (transfer.sent < header + transfer.send_size * sizeof(Value)) {
+                events |= POLLOUT;
+            }
+
+            if (transfer.received < header || transfer.received < header + transfer.receive_size * sizeof(Value)) {
+                events |= POLLIN;
+            }
+
+            if (events) {
+                fds.push_back({ sockets[process], events, 0 });
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            fail("cannot poll the sockets");
+        }
+
+        for (auto const &fd: fds) {
+            unsigned int process = std::find(sockets.begin(), sockets.end(), fd.fd) - sockets.begin();
+            Transfer &transfer = transfers[process];
+            char *data;
+            size_t length;
+
+            if (fd.revents & POLLOUT) {
+                message_bytes(transfer.send_size, outgoing[process], transfer.sent, data, length);
+                ssize_t count = send(fd.fd, data, length, MSG_NOSIGNAL);
+
+                if (count == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    fail("cannot send to a process");
+                }
+
+                if (count > 0) {
+                    transfer.sent += count;
+                    bytes_sent += count;
+                    num_pending -= transfer.sent == header + transfer.send_size * sizeof(Value);
+                }
+            }
+
+            bool receiving = transfer.received < header ||
+                             transfer.received < header + transfer.receive_size * sizeof(Value);
+
+            if (receiving && (fd.revents & (POLLIN | POLLHUP | POLLERR))) {
+                message_bytes(transfer.receive_size, transfer.values, transfer.received, data, length);
+                ssize_t count = recv(fd.fd, data, length, 0);
+
+                if (count == 0) {
+                    errno = ECONNRESET;
+                    fail("a process exited");
+                }
+
+                if (count == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    fail("cannot receive from a process");
+                }
+
+                if (count > 0) {
+                    transfer.received += count;
+
+                    if (transfer.received == header) {
+                        transfer.values.resize(transfer.receive_size);
+                    }
+
+                    num_pending -= transfer.received == header + transfer.receive_size * sizeof(Value);
+                }
+            }
+        }
+    }
+
+    for (unsigned int process = 0; process < num_processes; process++) {
+        outgoing[process].clear();
+        incoming.insert(incoming.end(), transfers[process].values.begin(), transfers[process].values.end());
+    }
+}
+
+bool DistributedBackend::reduceOr(bool flag) {
+    std::vector<std::vector<Value>> outgoing(num_processes, std::vector<Value>(1, flag));
+    std::vector<Value> incoming;
+
+    exchange(outgoing, incoming);
+
+    return std::find(incoming.begin(), incoming.end(), 1u) != incoming.end();
+}
+
+void DistributedBackend::gather() {
+    std::vector<std::vector<Value>> outgoing(num_processes);
+    std::vector<Value> incoming;
+
+    // records (relation, number of rows, rows...)
+    if (rank != 0) {
+        for (unsigned int relation = 0; relation < tables.size(); relation++) {
+            const Table &table = *tables[relation];
+
+            outgoing[0].push_back(relation);
+            outgoing[0].push_back(table.size());
+
+            for (unsigned int id = 0; id < table.size(); id++) {
+                outgoing[0].insert(outgoing[0].end(), table.getRow(id), table.getRow(id) + table.getArity());
+            }
+        }
+    }
+
+    exchange(outgoing, incoming);
+
+    for (size_t offset = 0; offset < incoming.size();) {
+        Table &table = *tables[incoming[offset]];
+        unsigned int num_rows = incoming[offset + 1];
+        offset += 2;
+
+        for (unsigned int id = 0; id < num_rows; id++, offset += table.getArity()) {
+            table.insert(incoming.data() + offset);
+        }
+    }
+
+    // and the number of bytes sent by each process
+    for (unsigned int process = 0; process < num_processes; process++) {
+        outgoing[process].clear();
+    }
+
+    if (rank != 0) {
+        outgoing[0] = { (Value)bytes_sent, (Value)(bytes_sent >> 32) };
+    }
+
+    exchange(outgoing, incoming);
+
+    for (size_t offset = 0; offset < incoming.size(); offset += 2) {
+        bytes_sent += incoming[offset] | (uint64_t)incoming[offset + 1] << 32;
+    }
+}
+
+void DistributedBackend::printStatistics(llvm::raw_ostream &out) const {
+    out << "distributed evaluation: " << num_processes << " processes, " << num_rounds << " rounds, "
+        << llvm::format("%.1f", bytes_sent / 1048576.0) << " MB exchanged\n";
+}
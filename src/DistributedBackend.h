@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "NativeBackend.h"
+
+/**
+ * A multi-process version of the native backend
+ *
+ * The process loading the program (process 0) compiles it, then forks
+ * the other processes. Every relation is hash-partitioned across them
+ * on one column, the one its atoms are most often looked up by, so each
+ * tuple is stored by exactly one process
+ *
+ * The rules are evaluated with the plans and the semi-naive iteration
+ * of the native backend (joining one atom at a time), but each step of
+ * a plan is a round in which all processes exchange their messages at
+ * once: a binding of the variables of a rule so far is sent to the owner
+ * of the rows of the next atom matching it (given by the value of the
+ * partition column), or to all processes if that column is not bound
+ * yet. Negated atoms are checked by their owners the same way, and
+ * derived tuples are sent to theirs. A process runs the steps whose
+ * rows it owns right away (depth-first, as the native backend), so only
+ * the bindings crossing processes wait for a round, and they are kept
+ * distinct over the variables still needed. The processes are connected
+ * by pairs of Unix domain sockets
+ *
+ * At the fixpoint, the other processes send their partitions to
+ * process 0 and exit, so queries are answered as in the native backend
+ */
+class DistributedBackend: public NativeBackend {
+    /**
+     * A step of a plan, run by the owner of the rows of its atom
+     */
+    struct Stage {
+        enum Kind {
+            JOIN, // extend the binding with the matching rows of a join step
+            NEGATION, // keep the binding if a negated atom has no such row
+            HEAD, // derive the head
+        };
+
+        Kind kind;
+        unsigned int index; // of the join step, or of the negated atom in the body
+        bool broadcast; // if the partition column of the atom is not bound yet
+        std::vector<bool> live; // variables read at this stage or later
+    };
+
+    /**
+     * Distinct bindings of the variables of a rule waiting for a stage,
+     * with the variables not live at that stage cleared, so that most
+     * derivations of the same tuple collapse into a single binding
+     */
+    class Bindings {
+        Table table;
+        std::vector<bool> live;
+        std::vector<Value> projected;
+
+    public:
+        Bindings(const std::vector<bool> &live): table(live.size()), live(live), projected(live.size()) {}
+
+        unsigned int size() const { return table.size(); }
+        const Value *get(unsigned int i) const { return table.getRow(i); }
+
+        void insert(const std::vector<Value> &slots);
+    };
+
+    /**
+     * Plans being run, with the bindings of each of their
+     * stages waiting to be sent to the other processes
+     */
+    struct Run {
+        const std::vector<JoinPlan> &plans;
+        std::vector<std::vector<Stage>> stages;
+        std::vector<std::vector<std::unique_ptr<Bindings>>> waiting;
+
+        Run(const std::vector<JoinPlan> &plans): plans(plans) {}
+    };
+
+    unsigned int num_processes;
+    unsigned int rank = 0;
+
+    // socket connected to each other process (-1 for this one)
+    std::vector<int> sockets;
+
+    // column each relation is partitioned on
+    std::vector<unsigned int> partition_columns;
+
+    unsigned int num_rounds = 0;
+    uint64_t bytes_sent = 0;
+
+public:
+    DistributedBackend(unsigned int num_processes = 2);
+
+    virtual void load(const StandardDatalog::Program &program) override;
+    virtual void printStatistics(llvm::raw_ostream &out) const override;
+
+private:
+    /**
+     * Partition each relation on the column bound in most of the join
+     * steps of its atoms, so that fewer bindings are sent to all processes
+     */
+    void choosePartitionColumns();
+
+    /**
+     * Fork the other processes, connected to each other by socket pairs
+     */
+    void spawnProcesses();
+
+    /**
+     * Keep only the rows of the tables owned by this process
+     */
+    void partitionTables();
+
+    /**
+     * Process owning the rows of an atom matching a binding
+     * (whose partition column must be bound)
+     */
+    unsigned int getOwner(const Atom &atom, const Value *slots) const;
+    unsigned int getOwner(unsigned int relation, const Value *row) const;
+
+    std::vector<Stage> getStages(const JoinPlan &plan) const;
+
+    /**
+     * Atom of a stage (the head for the last one)
+     */
+    const Atom &getAtom(const JoinPlan &plan, const Stage &stage) const;
+
+    void evaluateDistributed(const Stratum &stratum);
+
+    /**
+     * Run the plans stage by stage, one round per stage
+     */
+    void runPlans(const std::vector<JoinPlan> &plans);
+
+    /**
+     * Pass a binding on to a stage of its plan: run the stage right
+     * away (depth-first, as the native backend) if this process owns
+     * the rows of its atom, and keep the binding for the round of the
+     * stage if other processes do (all of them, for a broadcast)
+     */
+    void advance(Run &run, unsigned int plan, unsigned int stage, std::vector<Value> &slots);
+
+    void runStage(Run &run, unsigned int plan, unsigned int stage, std::vector<Value> &slots);
+
+    /**
+     * Extend a binding with each row matching a join step, and call a function on it
+     */
+    template<typename Function>
+    void extend(const JoinPlan &plan, const JoinStep &step,
+                std::vector<Value> &slots, Function function) const;
+
+    /**
+     * Send a message to every process (including this one) and
+     * receive theirs, appended to incoming in no particular order
+     */
+    void exchange(std::vector<std::vector<Value>> &outgoing, std::vector<Value> &incoming);
+
+    /**
+     * Or of a flag over all processes
+     */
+    bool reduceOr(bool flag);
+
+    /**
+     * Send the partitions of the other processes to process 0
+     */
+    void gather();
+};
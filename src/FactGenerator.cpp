@@ -158,17 +158,17 @@ void FactGenerator::generateFactsForFunction(StandardDatalog::Program &program,
     unsigned int function_id = getObjectIDOfValue(&function);
     unsigned int function_mem_id = getAffiliatedObjectID(function_id, 1);
 
-    program.addFormula(rel_function(function_id));
-    program.addFormula(rel_mem(function_mem_id));
-    program.addFormula(rel_hasAllocatedMemory(function_id, function_mem_id));
+    program.addFact(rel_function, function_id);
+    program.addFact(rel_mem, function_mem_id);
+    program.addFact(rel_hasAllocatedMemory, function_id, function_mem_id);
 
     // both function pointer and function object are immutable
-    program.addFormula(rel_immutable(function_id));
-    program.addFormula(rel_immutable(function_mem_id));
+    program.addFact(rel_immutable, function_id);
+    program.addFact(rel_immutable, function_mem_id);
 
     // NOTE that the function pointer is non-addressable
     // but the function object itself is addressable (in particular by the pointer)
-    program.addFormula(rel_nonaddressable(function_id));
+    program.addFact(rel_nonaddressable, function_id);
 
     for (const Argument &arg: function.args()) {
         generateFactsForValue(program, arg);
@@ -176,12 +176,12 @@ void FactGenerator::generateFactsForFunction(StandardDatalog::Program &program,
         unsigned int arg_id = getObjectIDOfValue(&arg);
 
         // TODO: check if this is true (variadic argument?)
-        program.addFormula(rel_nonaddressable(arg_id));
-        program.addFormula(rel_immutable(arg_id));
+        program.addFact(rel_nonaddressable, arg_id);
+        program.addFact(rel_immutable, arg_id);
 
         if (isFreeArgument(&arg)) {
             unsigned int arg_mem_id = getAffiliatedObjectID(arg_id, 1);
-            program.addFormula(rel_hasFreeArgument(function_id, arg_id, arg_mem_id));
+            program.addFact(rel_hasFreeArgument, function_id, arg_id, arg_mem_id);
         }
     }
 
@@ -195,9 +195,9 @@ void FactGenerator::generateFactsForBasicBlock(StandardDatalog::Program &program
     // unsigned int block_id = getObjectIDOfValue(&block);
     // unsigned int function_id = getObjectIDOfValue(block.getParent());
 
-    // program.addFormula(rel_block(block_id));
-    // program.addFormula(rel_immutable(block_id));
-    // program.addFormula(rel_hasBlock(function_id, block_id));
+    // program.addFact(rel_block, block_id);
+    // program.addFact(rel_immutable, block_id);
+    // program.addFact(rel_hasBlock, function_id, block_id);
 
     for (const Instruction &instr: block) {
         generateFactsForValue(program, instr);
@@ -215,23 +215,23 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
     if (auto *instr = dyn_cast<Instruction>(&user)) {
         unsigned int function_id = getObjectIDOfValue(instr->getParent()->getParent());
         opcode = instr->getOpcode();
-        program.addFormula(rel_hasInstr(function_id, instr_id));
+        program.addFact(rel_hasInstr, function_id, instr_id);
     } else if (auto *expr = dyn_cast<ConstantExpr>(&user)) {
         opcode = expr->getOpcode();
     } else {
         assert(0 && "not an instruction or constant expression");
     }
 
-    program.addFormula(rel_instr(instr_id));
+    program.addFact(rel_instr, instr_id);
 
     // result of an instruction is immutable and non-addressable
     // because we are in SSA form
-    program.addFormula(rel_immutable(instr_id));
-    program.addFormula(rel_nonaddressable(instr_id));
+    program.addFact(rel_immutable, instr_id);
+    program.addFact(rel_nonaddressable, instr_id);
 
     for (const Use &operand: user.operands()) {
         unsigned int operand_id = getObjectIDOfValue(operand);
-        program.addFormula(rel_hasOperand(instr_id, operand_id));
+        program.addFact(rel_hasOperand, instr_id, operand_id);
 
         // TODO: can there be other kinds of operands?
 
@@ -248,8 +248,8 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
     switch (opcode) {
         case Instruction::Alloca: {
             unsigned int mem_id = getAffiliatedObjectID(instr_id, 1);
-            program.addFormula(rel_mem(mem_id));
-            program.addFormula(rel_instrAlloca(instr_id, mem_id));
+            program.addFact(rel_mem, mem_id);
+            program.addFact(rel_instrAlloca, instr_id, mem_id);
 
             auto *alloca_inst = dyn_cast<AllocaInst>(&user);
 
@@ -265,14 +265,14 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
         case Instruction::GetElementPtr: {
             const Value *base = user.getOperand(0);
             unsigned int base_id = getObjectIDOfValue(base);
-            program.addFormula(rel_instrGetelementptr(instr_id, base_id));
+            program.addFact(rel_instrGetelementptr, instr_id, base_id);
             break;
         }
 
         case Instruction::Load: {
             const Value *src = user.getOperand(0);
             unsigned int src_id = getObjectIDOfValue(src);
-            program.addFormula(rel_instrLoad(instr_id, src_id));
+            program.addFact(rel_instrLoad, instr_id, src_id);
             break;
         }
 
@@ -283,7 +283,7 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
             const Value *dest = user.getOperand(1);
             unsigned int dest_id = getObjectIDOfValue(dest);
 
-            program.addFormula(rel_instrStore(instr_id, value_id, dest_id));
+            program.addFact(rel_instrStore, instr_id, value_id, dest_id);
             break;
         }
 
@@ -292,7 +292,7 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
             if (user.getNumOperands() > 0) {
                 const Value *value = user.getOperand(0);
                 unsigned int value_id = getObjectIDOfValue(value);
-                program.addFormula(rel_instrRet(instr_id, value_id));
+                program.addFact(rel_instrRet, instr_id, value_id);
             }
             break;
         }
@@ -300,7 +300,7 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
         case Instruction::BitCast: {
             const Value *value = user.getOperand(0);
             unsigned int value_id = getObjectIDOfValue(value);
-            program.addFormula(rel_instrBitCast(instr_id, value_id));
+            program.addFact(rel_instrBitCast, instr_id, value_id);
             break;
         }
 
@@ -312,12 +312,12 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
             // this can point to anything
             const Value *value = user.getOperand(0);
             unsigned int value_id = getObjectIDOfValue(value);
-            program.addFormula(rel_instrIntToPtr(instr_id, value_id));
+            program.addFact(rel_instrIntToPtr, instr_id, value_id);
             break;
         }
 
         case Instruction::PHI: {
-            program.addFormula(rel_instrPHI(instr_id));
+            program.addFact(rel_instrPHI, instr_id);
             break;
         }
 
@@ -363,7 +363,7 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
                 // defined in this module
                 unsigned int i = 0;
 
-                program.addFormula(rel_instrCall(call_id, function_id));
+                program.addFact(rel_instrCall, call_id, function_id);
 
                 for (const Argument &arg: function->args()) {
                     assert(i < call->getNumArgOperands() &&
@@ -374,7 +374,7 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
                     unsigned int arg_id = getObjectIDOfValue(&arg);
                     unsigned int call_arg_id = getObjectIDOfValue(call_arg);
 
-                    program.addFormula(rel_hasCallArgument(call_id, call_arg_id, arg_id));
+                    program.addFact(rel_hasCallArgument, call_id, call_arg_id, arg_id);
 
                     i++;
                 }
@@ -409,10 +409,13 @@ void FactGenerator::generateFactsForInstruction(StandardDatalog::Program &progra
                 }
             }
 
-            program.addFormula(rel_instrUnknown(instr_id));
-            dbgs() << "unsupported instruction ";
-            user.print(dbgs());
-            dbgs() << "\n";
+            program.addFact(rel_instrUnknown, instr_id);
+
+            if (!quiet) {
+                dbgs() << "unsupported instruction ";
+                user.print(dbgs());
+                dbgs() << "\n";
+            }
     }
 }
 
@@ -429,17 +432,17 @@ void FactGenerator::generateFactsForGlobalVariable(StandardDatalog::Program &pro
     // in this case, global_var_id points to a (persumably)
     // unique location, but we just don't know its content
 
-    program.addFormula(rel_global(global_id));
+    program.addFact(rel_global, global_id);
 
     // the pointer to a global variable is immutable
-    program.addFormula(rel_immutable(global_id));
-    program.addFormula(rel_nonaddressable(global_id));
+    program.addFact(rel_immutable, global_id);
+    program.addFact(rel_nonaddressable, global_id);
 
-    program.addFormula(rel_mem(global_mem_id));
-    program.addFormula(rel_hasAllocatedMemory(global_id, global_mem_id));
+    program.addFact(rel_mem, global_mem_id);
+    program.addFact(rel_hasAllocatedMemory, global_id, global_mem_id);
 
     if (global.isConstant()) {
-        program.addFormula(rel_immutable(global_mem_id));
+        program.addFact(rel_immutable, global_mem_id);
     }
 
     // a few properties to consider
@@ -452,9 +455,9 @@ void FactGenerator::generateFactsForGlobalVariable(StandardDatalog::Program &pro
         unsigned int initializer_id = getObjectIDOfValue(initializer);
         generateFactsForConstant(program, *initializer);
 
-        program.addFormula(rel_hasInitializer(global_id, initializer_id));
+        program.addFact(rel_hasInitializer, global_id, initializer_id);
     } else {
-        program.addFormula(rel_hasNoInitializer(global_id));
+        program.addFact(rel_hasNoInitializer, global_id);
     }
 }
 
@@ -471,9 +474,9 @@ void FactGenerator::generateFactsForConstant(StandardDatalog::Program &program,
 
     // to be conservative, assume same constants
     // implies same memory location
-    program.addFormula(rel_constant(constant_id));
-    program.addFormula(rel_immutable(constant_id));
-    program.addFormula(rel_nonaddressable(constant_id));
+    program.addFact(rel_constant, constant_id);
+    program.addFact(rel_immutable, constant_id);
+    program.addFact(rel_nonaddressable, constant_id);
 
     for (const Use &operand: constant.operands()) {
         auto *constant = dyn_cast<Constant>(operand);
@@ -485,7 +488,7 @@ void FactGenerator::generateFactsForConstant(StandardDatalog::Program &program,
         // aggregate and all of its fields are alias of each other
         for (const Use &operand: constant.operands()) {
             auto operand_id = getObjectIDOfValue(operand);
-            program.addFormula(rel_hasConstantField(constant_id, operand_id));
+            program.addFact(rel_hasConstantField, constant_id, operand_id);
         }
 
     } else if (auto *expr = dyn_cast<ConstantExpr>(&constant)) {
@@ -499,14 +502,14 @@ void FactGenerator::generateFactsForConstant(StandardDatalog::Program &program,
 
         if (data->getType()->isPointerTy()) {
             if (isa<UndefValue>(data)) {
-                program.addFormula(rel_undef(constant_id));
+                program.addFact(rel_undef, constant_id);
             } else if (isa<ConstantPointerNull>(data)) {
                 // simply use the mem object allocated above
-                program.addFormula(rel_null(constant_id));
+                program.addFact(rel_null, constant_id);
             }
         } else {
             // assumption: this will never point to anything
-            // program.addFormula(rel_nonpointer(constant_id));
+            // program.addFact(rel_nonpointer, constant_id);
         }
     } else {
         // TODO: missing support for basic block address
@@ -527,7 +530,7 @@ void FactGenerator::generateFactsForValue(StandardDatalog::Program &program, con
         // dbgs() << "nonpointer: ";
         // value.print(dbgs());
         // dbgs() << "\n";
-        program.addFormula(rel_nonpointer(val_id));
+        program.addFact(rel_nonpointer, val_id);
     }
 }
 
@@ -564,8 +567,8 @@ struct MallocIntrinsicCall: IntrinsicCall {
         unsigned int instr_id = fact_generator->getObjectIDOfValue(call);
         unsigned int mem_id = fact_generator->getAffiliatedObjectID(instr_id, 1);
         
-        program.addFormula(fact_generator->rel_mem(mem_id));
-        program.addFormula(fact_generator->rel_intrinsicMalloc(instr_id, mem_id));
+        program.addFact(fact_generator->rel_mem, mem_id);
+        program.addFact(fact_generator->rel_intrinsicMalloc, instr_id, mem_id);
     }
 };
 
@@ -601,7 +604,7 @@ struct MemcpyIntrinsicCall: IntrinsicCall {
         unsigned int arg_dest_id = fact_generator->getObjectIDOfValue(call->getArgOperand(0));
         unsigned int arg_src_id = fact_generator->getObjectIDOfValue(call->getArgOperand(1));
 
-        program.addFormula(fact_generator->rel_intrinsicMemcpy(instr_id, arg_dest_id, arg_src_id));
+        program.addFact(fact_generator->rel_intrinsicMemcpy, instr_id, arg_dest_id, arg_src_id);
     }
 };
 
@@ -48,9 +48,12 @@ class FactGenerator {
 
     std::set<const llvm::Constant *> initializedConstants;
 
+    // if unsupported instructions are not reported (again)
+    bool quiet = false;
+
     // relations required in the program
     #define IN_DSL
-    #define sort(name, size) private: std::string name = #name;
+    #define sort(name, size) private: Symbol name = #name;
     #define rel(name, ...) \
         public: StandardDatalog::Relation rel_##name = StandardDatalog::Relation(#name, __VA_ARGS__)
     #define var(...)
@@ -109,11 +112,22 @@ public:
         return valueList[index];
     }
 
+    void setQuiet(bool quiet) {
+        this->quiet = quiet;
+    }
+
     // append all the facts to the given program
     void generateFacts(StandardDatalog::Program &program) {
         generateFactsForModule(program, *unit);
     }
 
+    // append the facts of a single function (with those of
+    // the constants it uses), e.g. to update them after it changes
+    void generateFacts(StandardDatalog::Program &program, const llvm::Function &function) {
+        initializedConstants.clear();
+        generateFactsForFunction(program, function);
+    }
+
 private:
     /**
      * initialize all objects in the current translation unit
@@ -0,0 +1,162 @@
+#include <cassert>
+#include <functional>
+
+#include "IndexSelection.h"
+
+IndexSelection::IndexSelection(const StandardDatalog::Program &program) {
+    for (auto const &item: program.getRelations()) {
+        relations[item.first].arity = item.second.getArgumentSortNames().size();
+    }
+
+    for (auto const &stratum: program.getStrata()) {
+        std::set<std::string> in_stratum(stratum.relations.begin(), stratum.relations.end());
+
+        for (auto const &formula: program.getFormulas()) {
+            if (formula.isAtom() || !in_stratum.count(formula.getRelationName())) {
+                continue;
+            }
+
+            const StandardDatalog::FormulaVector &body = formula.getBody();
+            bool recursive = false;
+
+            for (unsigned int i = 0; i < body.size(); i++) {
+                if (!body[i].isNegated() && in_stratum.count(body[i].getRelationName())) {
+                    addPatterns(formula, i);
+                    recursive = true;
+                }
+            }
+
+            if (!recursive) {
+                addPatterns(formula, -1);
+            }
+        }
+    }
+
+    for (auto &item: relations) {
+        selectOrders(item.second);
+    }
+}
+
+void IndexSelection::addPatterns(const StandardDatalog::Formula &rule, int first_atom) {
+    const StandardDatalog::FormulaVector &body = rule.getBody();
+    std::vector<unsigned int> order;
+    std::set<std::string> bound;
+
+    if (first_atom >= 0) {
+        order.push_back(first_atom);
+    }
+
+    for (unsigned int i = 0; i < body.size(); i++) {
+        if (!body[i].isNegated() && (int)i != first_atom) {
+            order.push_back(i);
+        }
+    }
+
+    for (unsigned int i: order) {
+        const StandardDatalog::TermVector &args = body[i].getArguments();
+        unsigned int mask = 0;
+
+        assert(args.size() <= 32 && "relation arity not supported");
+
+        for (unsigned int col = 0; col < args.size(); col++) {
+            if (!args[col].isVariable() || bound.count(args[col].getVariable())) {
+                mask |= 1u << col;
+            }
+        }
+
+        for (auto const &term: args) {
+            if (term.isVariable()) {
+                bound.insert(term.getVariable());
+            }
+        }
+
+        if (mask != 0) {
+            relations.at(body[i].getRelationName()).patterns.insert(mask);
+        }
+    }
+}
+
+void IndexSelection::selectOrders(RelationIndices &relation) {
+    std::vector<unsigned int> patterns(relation.patterns.begin(), relation.patterns.end());
+    unsigned int num_patterns = patterns.size();
+
+    auto is_below = [&] (unsigned int i, unsigned int j) {
+        return i != j && (patterns[i] & patterns[j]) == patterns[i];
+    };
+
+    // maximum matching by augmenting paths, where
+    // i -> j means pattern j follows i in a chain
+    std::vector<int> successor(num_patterns, -1);
+    std::vector<int> predecessor(num_patterns, -1);
+    std::vector<bool> visited;
+
+    std::function<bool (unsigned int)> augment = [&] (unsigned int i) {
+        for (unsigned int j = 0; j < num_patterns; j++) {
+            if (!is_below(i, j) || visited[j]) {
+                continue;
+            }
+
+            visited[j] = true;
+
+            if (predecessor[j] < 0 || augment(predecessor[j])) {
+                successor[i] = j;
+                predecessor[j] = i;
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    for (unsigned int i = 0; i < num_patterns; i++) {
+        visited.assign(num_patterns, false);
+        augment(i);
+    }
+
+    // each chain starts with a pattern that has no predecessor and
+    // sorts by the columns of the patterns in the chain, in order
+    for (unsigned int i = 0; i < num_patterns; i++) {
+        if (predecessor[i] >= 0) {
+            continue;
+        }
+
+        Order order;
+        unsigned int covered = 0;
+
+        for (int j = i; j >= 0; j = successor[j]) {
+            for (unsigned int col = 0; col < relation.arity; col++) {
+                if (((patterns[j] & ~covered) >> col) & 1) {
+                    order.push_back(col);
+                }
+            }
+
+            covered = patterns[j];
+            relation.order_of_pattern[patterns[j]] = relation.orders.size();
+        }
+
+        // the remaining columns make the order total
+        for (unsigned int col = 0; col < relation.arity; col++) {
+            if (!((covered >> col) & 1)) {
+                order.push_back(col);
+            }
+        }
+
+        relation.orders.push_back(order);
+    }
+}
+
+const std::vector<IndexSelection::Order> &IndexSelection::getOrders(const std::string &relation) const {
+    auto found = relations.find(relation);
+    assert(found != relations.end() && "relation does not exist");
+    return found->second.orders;
+}
+
+IndexSelection::Index IndexSelection::getIndex(const std::string &relation, unsigned int mask) const {
+    auto found = relations.find(relation);
+    assert(found != relations.end() && "relation does not exist");
+
+    auto order = found->second.order_of_pattern.find(mask);
+    assert(order != found->second.order_of_pattern.end() && "access pattern was not collected");
+
+    return { order->second, (unsigned int)__builtin_popcount(mask) };
+}
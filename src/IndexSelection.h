@@ -0,0 +1,69 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "DatalogIR.h"
+
+/**
+ * Index selection for the in-house backends
+ *
+ * An access pattern of a relation is the set of columns bound
+ * when one of its atoms is joined (a bit mask). An index sorts
+ * the rows of a relation in some column order, and serves every
+ * pattern whose columns form a prefix of that order, so a single
+ * index covers a whole chain of patterns S1 < S2 < ... < Sk
+ *
+ * As in Souffle, the patterns of each relation are covered by the
+ * minimum number of chains, which by Dilworth's theorem is the
+ * number of patterns minus a maximum matching in the bipartite
+ * graph of strict inclusions
+ */
+class IndexSelection {
+public:
+    using Order = std::vector<unsigned int>; // columns in the order they are sorted by
+
+    struct Index {
+        unsigned int index; // into the orders of the relation
+        unsigned int prefix_length; // number of columns bound
+    };
+
+private:
+    struct RelationIndices {
+        unsigned int arity;
+        std::set<unsigned int> patterns;
+        std::vector<Order> orders;
+        std::map<unsigned int, unsigned int> order_of_pattern;
+    };
+
+    std::map<std::string, RelationIndices> relations;
+
+public:
+    /**
+     * Collect the access patterns of the rules as the in-house
+     * backends join them: positive atoms left to right, except that
+     * in semi-naive evaluation an atom of the same stratum as the
+     * head goes first, and select the indices
+     */
+    IndexSelection(const StandardDatalog::Program &program);
+
+    /**
+     * Column orders of the indices to materialize for a relation
+     */
+    const std::vector<Order> &getOrders(const std::string &relation) const;
+
+    /**
+     * Index serving the pattern (which must be one of those collected)
+     */
+    Index getIndex(const std::string &relation, unsigned int mask) const;
+
+private:
+    void addPatterns(const StandardDatalog::Formula &rule, int first_atom);
+
+    /**
+     * Minimum chain cover of the patterns of a relation
+     */
+    static void selectOrders(RelationIndices &relation);
+};
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cassert>
+#include <set>
+
+#include "llvm/Support/Format.h"
+
+#include "JoinOrdering.h"
+
+using namespace llvm;
+
+// bodies with more positive atoms are ordered greedily instead of
+// trying all permutations (7 atoms already have 5040 of them)
+static const unsigned int MAX_PERMUTED_ATOMS = 5;
+
+static const double MIN_SELECTIVITY = 0.01;
+
+static const unsigned int MAX_ESTIMATE_ROUNDS = 32;
+
+static void printAtom(raw_ostream &out, const StandardDatalog::Formula &atom) {
+    out << (atom.isNegated() ? "!" : "") << atom.getRelationName() << "(";
+
+    for (unsigned int i = 0; i < atom.getArity(); i++) {
+        out << (i ? ", " : "") << atom.getArguments()[i];
+    }
+
+    out << ")";
+}
+
+JoinOrdering::JoinOrdering(const StandardDatalog::Program &program): program(program) {
+    collectFacts();
+
+    StandardDatalog::StratumVector strata = program.getStrata();
+
+    for (unsigned int i = 0; i < strata.size(); i++) {
+        for (auto const &name: strata[i].relations) {
+            stratum_ids[name] = i;
+        }
+    }
+
+    for (auto const &stratum: strata) {
+        estimateStratum(stratum);
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        if (!formula.isAtom()) {
+            plans.push_back(planRule(formula));
+        }
+    }
+}
+
+void JoinOrdering::collectFacts() {
+    std::map<std::string, std::vector<std::set<unsigned int>>> column_values;
+    std::map<std::string, std::set<unsigned int>> sort_values;
+
+    for (auto const &item: program.getRelations()) {
+        unsigned int arity = item.second.getArgumentSortNames().size();
+
+        num_facts[item.first] = 0;
+        column_values[item.first].resize(arity);
+        statistics[item.first].distinct.assign(arity, 0);
+    }
+
+    for (auto const &item: program.getFacts()) {
+        const StandardDatalog::FactTable &facts = *item.second;
+        const StandardDatalog::Relation &relation = program.getRelation(item.first);
+        std::vector<std::set<unsigned int>> &values = column_values[item.first];
+
+        // each fact once, unless the program keeps duplicates (which are few)
+        num_facts[item.first] = facts.size();
+
+        for (size_t i = 0; i < facts.size(); i++) {
+            const unsigned int *row = facts.getRow(i);
+
+            for (unsigned int col = 0; col < facts.getArity(); col++) {
+                values[col].insert(row[col]);
+                sort_values[relation.getArgumentSortName(col)].insert(row[col]);
+            }
+        }
+    }
+
+    for (auto const &item: program.getSorts()) {
+        sort_sizes[item.first] = std::max<double>(sort_values[item.first].size(), 1);
+    }
+
+    for (auto &item: statistics) {
+        item.second.cardinality = num_facts[item.first];
+
+        for (unsigned int col = 0; col < item.second.distinct.size(); col++) {
+            item.second.distinct[col] = column_values[item.first][col].size();
+        }
+    }
+}
+
+void JoinOrdering::estimateStratum(const StandardDatalog::Stratum &stratum) {
+    std::set<std::string> members(stratum.relations.begin(), stratum.relations.end());
+    std::vector<const StandardDatalog::Formula *> rules;
+
+    for (auto const &formula: program.getFormulas()) {
+        if (!formula.isAtom() && members.count(formula.getRelationName())) {
+            rules.push_back(&formula);
+        }
+    }
+
+    if (rules.empty()) {
+        return;
+    }
+
+    // iterate the estimates of a recursive stratum to a fixpoint
+    // (which is reached at the latest at the bounds of the sorts)
+    unsigned int num_rounds = stratum.recursive ? MAX_ESTIMATE_ROUNDS : 1;
+
+    for (unsigned int round = 0; round < num_rounds; round++) {
+        std::map<std::string, double> derived;
+        bool changed = false;
+
+        // the size of the result barely depends on the order,
+        // so the orders are only searched once the estimates are done
+        for (auto const *rule: rules) {
+            derived[rule->getRelationName()] += planRule(*rule, false).cardinality;
+        }
+
+        for (auto const &name: stratum.relations) {
+            const StandardDatalog::Relation &relation = program.getRelation(name);
+            Statistics &relation_statistics = statistics[name];
+            double bound = 1;
+
+            for (auto const &sort: relation.getArgumentSortNames()) {
+                bound *= sort_sizes.at(sort);
+            }
+
+            double cardinality = std::min(num_facts[name] + derived[name], bound);
+
+            changed |= cardinality > relation_statistics.cardinality * (1 + 1e-3);
+            relation_statistics.cardinality = std::max(relation_statistics.cardinality, cardinality);
+
+            for (unsigned int col = 0; col < relation_statistics.distinct.size(); col++) {
+                relation_statistics.distinct[col] = std::min(relation_statistics.cardinality,
+                                                             sort_sizes.at(relation.getArgumentSortName(col)));
+            }
+        }
+
+        if (!changed) {
+            break;
+        }
+    }
+}
+
+void JoinOrdering::join(JoinState &state, const StandardDatalog::Formula &atom,
+                        const StandardDatalog::FormulaVector &body) const {
+    const Statistics &atom_statistics = statistics.at(atom.getRelationName());
+    const StandardDatalog::TermVector &args = atom.getArguments();
+
+    double size = state.size * atom_statistics.cardinality;
+    std::map<std::string, double> bound_here;
+
+    // each bound column is an equality with the selectivity of
+    // the side with more distinct values
+    for (unsigned int col = 0; col < args.size(); col++) {
+        double distinct = std::max(atom_statistics.distinct[col], 1.0);
+
+        if (!args[col].isVariable()) {
+            size /= distinct;
+            continue;
+        }
+
+        const std::string &var = args[col].getVariable();
+        auto found = state.distinct.find(var);
+
+        if (found != state.distinct.end()) {
+            size /= std::max(found->second, distinct);
+            found->second = std::min(found->second, distinct);
+        } else if (bound_here.count(var)) {
+            size /= std::max(bound_here[var], distinct);
+            bound_here[var] = std::min(bound_here[var], distinct);
+        } else {
+            bound_here[var] = distinct;
+        }
+    }
+
+    for (auto const &item: bound_here) {
+        state.distinct[item.first] = std::min(item.second, std::max(size, 1.0));
+    }
+
+    // one lookup per tuple so far, plus the tuples produced
+    state.cost += state.size + size;
+    state.size = size;
+
+    for (auto const &negation: body) {
+        if (!negation.isNegated()) {
+            continue;
+        }
+
+        bool was_bound = true;
+        bool is_bound = true;
+
+        for (auto const &term: negation.getArguments()) {
+            if (term.isVariable()) {
+                is_bound &= state.distinct.count(term.getVariable()) != 0;
+                was_bound &= is_bound && !bound_here.count(term.getVariable());
+            }
+        }
+
+        if (is_bound && !was_bound) {
+            state.size *= getSelectivity(negation);
+        }
+    }
+}
+
+double JoinOrdering::getSelectivity(const StandardDatalog::Formula &negation) const {
+    const StandardDatalog::Relation &relation = program.getRelation(negation.getRelationName());
+    double num_tuples = 1;
+
+    for (auto const &sort: relation.getArgumentSortNames()) {
+        num_tuples *= sort_sizes.at(sort);
+    }
+
+    return std::max(1 - statistics.at(relation.getName()).cardinality / num_tuples, MIN_SELECTIVITY);
+}
+
+JoinOrdering::RulePlan JoinOrdering::planRule(const StandardDatalog::Formula &rule, bool search) const {
+    const StandardDatalog::FormulaVector &body = rule.getBody();
+    std::vector<unsigned int> positives;
+
+    for (unsigned int i = 0; i < body.size(); i++) {
+        if (!body[i].isNegated()) {
+            positives.push_back(i);
+        }
+    }
+
+    // in semi-naive evaluation, the rule is joined once per atom of
+    // the stratum of the head, with the delta of that atom first
+    std::vector<unsigned int> delta_atoms;
+
+    for (unsigned int i: positives) {
+        if (stratum_ids.at(body[i].getRelationName()) == stratum_ids.at(rule.getRelationName())) {
+            delta_atoms.push_back(i);
+        }
+    }
+
+    auto estimate = [&] (const std::vector<unsigned int> &order, JoinState &state) {
+        for (unsigned int i: order) {
+            join(state, body[i], body);
+        }
+
+        double cost = state.cost;
+
+        for (unsigned int delta_atom: delta_atoms) {
+            JoinState delta_state;
+            join(delta_state, body[delta_atom], body);
+
+            for (unsigned int i: order) {
+                if (i != delta_atom) {
+                    join(delta_state, body[i], body);
+                }
+            }
+
+            cost += delta_state.cost;
+        }
+
+        return cost;
+    };
+
+    JoinState final_state;
+    double source_cost = estimate(positives, final_state);
+    double cost = source_cost;
+
+    std::vector<unsigned int> order = positives;
+
+    if (search && positives.size() <= MAX_PERMUTED_ATOMS) {
+        // permutations are tried in lexicographic order from the source
+        // order, and only a strictly cheaper one replaces an earlier one
+        std::vector<unsigned int> permutation = positives;
+
+        while (std::next_permutation(permutation.begin(), permutation.end())) {
+            JoinState state;
+            double permutation_cost = estimate(permutation, state);
+
+            if (permutation_cost < cost * (1 - 1e-9)) {
+                order = permutation;
+                cost = permutation_cost;
+                final_state = state;
+            }
+        }
+    } else if (search) {
+        // join next the atom adding the least cost (the first on
+        // ties), and keep the order if it's cheaper than the source
+        std::vector<unsigned int> remaining = positives;
+        std::vector<unsigned int> greedy;
+        JoinState prefix;
+
+        while (!remaining.empty()) {
+            unsigned int best = 0;
+            JoinState best_state;
+
+            for (unsigned int k = 0; k < remaining.size(); k++) {
+                JoinState state = prefix;
+                join(state, body[remaining[k]], body);
+
+                if (k == 0 || state.cost < best_state.cost * (1 - 1e-9)) {
+                    best = k;
+                    best_state = state;
+                }
+            }
+
+            greedy.push_back(remaining[best]);
+            remaining.erase(remaining.begin() + best);
+            prefix = best_state;
+        }
+
+        JoinState state;
+        double greedy_cost = estimate(greedy, state);
+
+        if (greedy_cost < cost * (1 - 1e-9)) {
+            order = greedy;
+            cost = greedy_cost;
+            final_state = state;
+        }
+    }
+
+    // place each negation after the atom binding its last variable
+    std::set<std::string> bound;
+    std::vector<bool> placed(body.size(), false);
+    StandardDatalog::FormulaVector ordered_body;
+
+    auto place_negations = [&] () {
+        for (unsigned int i = 0; i < body.size(); i++) {
+            if (!body[i].isNegated() || placed[i]) {
+                continue;
+            }
+
+            bool is_bound = true;
+
+            for (auto const &term: body[i].getArguments()) {
+                is_bound &= !term.isVariable() || bound.count(term.getVariable());
+            }
+
+            if (is_bound) {
+                ordered_body.push_back(body[i]);
+                placed[i] = true;
+            }
+        }
+    };
+
+    place_negations();
+
+    for (unsigned int i: order) {
+        ordered_body.push_back(body[i]);
+
+        for (auto const &term: body[i].getArguments()) {
+            if (term.isVariable()) {
+                bound.insert(term.getVariable());
+            }
+        }
+
+        place_negations();
+    }
+
+    // negations with unbound variables (rejected by the backends)
+    for (unsigned int i = 0; i < body.size(); i++) {
+        if (body[i].isNegated() && !placed[i]) {
+            ordered_body.push_back(body[i]);
+        }
+    }
+
+    double cardinality = final_state.size;
+
+    // the head cannot have more distinct tuples than
+    // its variables have combinations of values
+    double bound_size = 1;
+
+    for (auto const &term: rule.getArguments()) {
+        if (term.isVariable()) {
+            auto found = final_state.distinct.find(term.getVariable());
+            bound_size *= found == final_state.distinct.end() ? 1 : found->second;
+        }
+    }
+
+    return {
+        &rule,
+        StandardDatalog::Formula(rule.getRelationName(), rule.getArguments(), ordered_body),
+        source_cost,
+        cost,
+        std::min(cardinality, bound_size)
+    };
+}
+
+StandardDatalog::Program JoinOrdering::getOrderedProgram() const {
+    StandardDatalog::Program ordered;
+    unsigned int num_rules = 0;
+
+    for (auto const &item: program.getSorts()) {
+        ordered.addSort(item.second);
+    }
+
+    for (auto const &item: program.getRelations()) {
+        ordered.addRelation(item.second);
+    }
+
+    for (auto const &item: program.getFacts()) {
+        ordered.addFacts(item.second);
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        if (formula.isAtom()) {
+            ordered.addFormula(formula);
+        } else {
+            ordered.addFormula(plans[num_rules++].ordered);
+        }
+    }
+
+    return ordered;
+}
+
+void JoinOrdering::printPlan(raw_ostream &out) const {
+    out << "relation cardinalities (derived relations are estimated):\n";
+
+    for (auto const &item: statistics) {
+        out << "    " << item.first << ": " << format("%.0f", item.second.cardinality) << "\n";
+    }
+
+    out << "\n";
+
+    for (auto const &plan: plans) {
+        printAtom(out, plan.ordered);
+        out << " :- ";
+
+        for (unsigned int i = 0; i < plan.ordered.getBody().size(); i++) {
+            out << (i ? ", " : "");
+            printAtom(out, plan.ordered.getBody()[i]);
+        }
+
+        out << ".\n";
+        out << "    // cost " << format("%.3g", plan.cost);
+
+        if (plan.cost < plan.original_cost) {
+            out << " (" << format("%.3g", plan.original_cost) << " in source order)";
+        }
+
+        out << ", ~" << format("%.3g", plan.cardinality) << " tuples\n";
+    }
+}
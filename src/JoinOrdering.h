@@ -0,0 +1,93 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "DatalogIR.h"
+
+/**
+ * Statistics-driven join ordering of rule bodies
+ *
+ * The cardinality of a relation with facts only is known exactly, and
+ * so are the numbers of distinct values in its columns. The other
+ * relations are estimated stratum by stratum from their rules, assuming
+ * uniform and independent columns, and are bounded by the number of
+ * distinct values of the sorts of their columns
+ *
+ * The positive atoms of each body are then ordered (left-deep, trying
+ * all permutations of bodies of up to 5 of them, and joining the
+ * cheapest atom next in larger ones) to minimize the total number of
+ * tuples looked up and produced, keeping the source order on ties.
+ * A negated atom filters the intermediate result as soon as its
+ * variables are bound, and is placed right after the atom binding
+ * its last variable. Backends join bodies left to right, except that in
+ * semi-naive evaluation the delta atom goes first, so the cost of a
+ * recursive rule also includes the order with each delta atom first
+ */
+class JoinOrdering {
+    struct Statistics {
+        double cardinality = 0;
+        std::vector<double> distinct; // per column
+    };
+
+    struct JoinState {
+        double size = 1; // tuples in the intermediate result
+        double cost = 0;
+        std::map<std::string, double> distinct; // values of the bound variables
+    };
+
+    struct RulePlan {
+        const StandardDatalog::Formula *rule;
+        StandardDatalog::Formula ordered;
+        double original_cost;
+        double cost;
+        double cardinality; // estimated number of tuples derived
+    };
+
+    const StandardDatalog::Program &program;
+
+    std::map<std::string, unsigned int> num_facts;
+    std::map<std::string, double> sort_sizes;
+    std::map<std::string, Statistics> statistics;
+    std::map<std::string, unsigned int> stratum_ids;
+
+    std::vector<RulePlan> plans;
+
+public:
+    JoinOrdering(const StandardDatalog::Program &program);
+
+    /**
+     * The program with the bodies of the rules reordered
+     */
+    StandardDatalog::Program getOrderedProgram() const;
+
+    /**
+     * Print the estimated cardinalities and the chosen
+     * order of each rule (for -datalog-aa-print-program)
+     */
+    void printPlan(llvm::raw_ostream &out) const;
+
+private:
+    void collectFacts();
+    void estimateStratum(const StandardDatalog::Stratum &stratum);
+
+    /**
+     * Join one more positive atom of a body to an intermediate
+     * result, then check the negated atoms it completes
+     */
+    void join(JoinState &state, const StandardDatalog::Formula &atom,
+              const StandardDatalog::FormulaVector &body) const;
+
+    /**
+     * Fraction of tuples passing a negated atom
+     */
+    double getSelectivity(const StandardDatalog::Formula &negation) const;
+
+    /**
+     * Without searching, the body is kept in source order
+     */
+    RulePlan planRule(const StandardDatalog::Formula &rule, bool search = true) const;
+};
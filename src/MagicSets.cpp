@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <map>
+
+#include "MagicSets.h"
+
+MagicSets::MagicSets(const StandardDatalog::Program &program, const StandardDatalog::Formula &query):
+    program(program), query(query) {
+    for (auto const &item: program.getSorts()) {
+        rewritten.addSort(item.second);
+    }
+
+    for (auto const &item: program.getRelations()) {
+        rewritten.addRelation(item.second);
+    }
+
+    // all facts are kept under their original names
+    for (auto const &item: program.getFacts()) {
+        if (item.second->size() != 0) {
+            rewritten.addFacts(item.second);
+            with_facts.insert(item.first);
+        }
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        if (!formula.isAtom()) {
+            derived.insert(formula.getRelationName());
+        }
+    }
+
+    // strata come after the strata they depend on
+    for (auto const &stratum: program.getStrata()) {
+        bool is_recursive = stratum.recursive;
+
+        for (auto const &formula: program.getFormulas()) {
+            if (formula.isAtom() || std::find(stratum.relations.begin(), stratum.relations.end(),
+                                              formula.getRelationName()) == stratum.relations.end()) {
+                continue;
+            }
+
+            for (auto const &atom: formula.getBody()) {
+                is_recursive |= recursive.count(atom.getRelationName()) != 0;
+            }
+        }
+
+        if (is_recursive) {
+            recursive.insert(stratum.relations.begin(), stratum.relations.end());
+        }
+    }
+
+    const std::string &relation = query.getRelationName();
+
+    if (!program.hasRelation(relation)) {
+        std::cerr << "query on an undeclared relation " << relation << std::endl;
+        assert(0 && "query on an undeclared relation");
+    }
+
+    if (!recursive.count(relation)) {
+        addComplete(relation);
+        query_relation = relation;
+        return;
+    }
+
+    std::string adornment = getAdornment(query, {});
+    query_relation = adorn(relation, adornment);
+
+    // seed the demand with the constants of the query
+    if (adornment.find('b') != std::string::npos) {
+        rewritten.addFormula(getMagicAtom(query, adornment));
+    }
+
+    while (!worklist.empty()) {
+        std::pair<std::string, std::string> item = worklist.back();
+        worklist.pop_back();
+
+        for (auto const &formula: program.getFormulas()) {
+            if (!formula.isAtom() && formula.getRelationName() == item.first) {
+                rewriteRule(formula, item.second);
+            }
+        }
+
+        if (with_facts.count(item.first)) {
+            addImportRule(item.first, item.second);
+        }
+    }
+}
+
+StandardDatalog::FormulaVector MagicSets::getAnswers(StandardDatalog::Backend &backend) const {
+    const StandardDatalog::TermVector &args = query.getArguments();
+    StandardDatalog::FormulaVector answers;
+
+    for (auto const &tuple: backend.query(query_relation)) {
+        std::map<std::string, unsigned int> values;
+        bool matches = true;
+
+        // the adorned relation may hold tuples demanded
+        // by other bindings, so check the query again
+        for (unsigned int i = 0; i < args.size() && matches; i++) {
+            unsigned int value = tuple.getArgument(i).getValue();
+
+            if (!args[i].isVariable()) {
+                matches = value == args[i].getValue();
+            } else if (values.count(args[i].getVariable())) {
+                matches = value == values[args[i].getVariable()];
+            } else {
+                values[args[i].getVariable()] = value;
+            }
+        }
+
+        if (matches) {
+            answers.push_back(StandardDatalog::Formula(query.getRelationName(), tuple.getArguments()));
+        }
+    }
+
+    return answers;
+}
+
+std::string MagicSets::getAdornment(const StandardDatalog::Formula &atom, const std::set<std::string> &bound) {
+    std::string adornment;
+
+    for (auto const &term: atom.getArguments()) {
+        adornment += !term.isVariable() || bound.count(term.getVariable()) ? 'b' : 'f';
+    }
+
+    return adornment;
+}
+
+// user symbols cannot start with an underscore (see DatalogDSL.h)
+
+std::string MagicSets::getAdornedName(const std::string &relation, const std::string &adornment) {
+    return "_" + relation + "_" + adornment;
+}
+
+std::string MagicSets::getMagicName(const std::string &relation, const std::string &adornment) {
+    return "_magic_" + relation + "_" + adornment;
+}
+
+StandardDatalog::Formula MagicSets::getMagicAtom(const StandardDatalog::Formula &atom,
+                                                 const std::string &adornment) {
+    StandardDatalog::TermVector bound_args;
+
+    for (unsigned int i = 0; i < adornment.size(); i++) {
+        if (adornment[i] == 'b') {
+            bound_args.push_back(atom.getArgument(i));
+        }
+    }
+
+    return StandardDatalog::Formula(getMagicName(atom.getRelationName(), adornment), bound_args);
+}
+
+std::string MagicSets::adorn(const std::string &relation, const std::string &adornment) {
+    std::string name = getAdornedName(relation, adornment);
+
+    if (adorned.count(name)) {
+        return name;
+    }
+
+    const StandardDatalog::Relation &original = program.getRelation(relation);
+    StandardDatalog::SymbolVector magic_sorts;
+
+    for (unsigned int i = 0; i < adornment.size(); i++) {
+        if (adornment[i] == 'b') {
+            magic_sorts.push_back(original.getArgumentSortName(i));
+        }
+    }
+
+    rewritten.addRelation(StandardDatalog::Relation(name, original.getArgumentSortNames()));
+
+    if (!magic_sorts.empty()) {
+        rewritten.addRelation(StandardDatalog::Relation(getMagicName(relation, adornment), magic_sorts));
+    }
+
+    adorned.insert(name);
+    worklist.push_back(std::make_pair(relation, adornment));
+
+    return name;
+}
+
+StandardDatalog::FormulaVector MagicSets::orderBody(const StandardDatalog::Formula &rule,
+                                                    std::set<std::string> bound) const {
+    const StandardDatalog::FormulaVector &body = rule.getBody();
+    std::vector<bool> placed(body.size(), false);
+    StandardDatalog::FormulaVector ordered;
+
+    auto is_bound = [&] (const StandardDatalog::Term &term) {
+        return !term.isVariable() || bound.count(term.getVariable()) != 0;
+    };
+
+    auto place_negations = [&] () {
+        for (unsigned int i = 0; i < body.size(); i++) {
+            if (!body[i].isNegated() || placed[i]) {
+                continue;
+            }
+
+            bool all_bound = true;
+
+            for (auto const &term: body[i].getArguments()) {
+                all_bound &= is_bound(term);
+            }
+
+            if (all_bound) {
+                ordered.push_back(body[i]);
+                placed[i] = true;
+            }
+        }
+    };
+
+    place_negations();
+
+    while (true) {
+        // next positive atom with the most bound arguments,
+        // keeping the order of the body on ties
+        int next = -1;
+        unsigned int next_bound = 0;
+
+        for (unsigned int i = 0; i < body.size(); i++) {
+            if (body[i].isNegated() || placed[i]) {
+                continue;
+            }
+
+            unsigned int num_bound = 0;
+
+            for (auto const &term: body[i].getArguments()) {
+                num_bound += is_bound(term);
+            }
+
+            if (next == -1 || num_bound > next_bound) {
+                next = i;
+                next_bound = num_bound;
+            }
+        }
+
+        if (next == -1) {
+            break;
+        }
+
+        ordered.push_back(body[next]);
+        placed[next] = true;
+
+        for (auto const &term: body[next].getArguments()) {
+            if (term.isVariable()) {
+                bound.insert(term.getVariable());
+            }
+        }
+
+        place_negations();
+    }
+
+    // negations with unbound variables (rejected by the backends)
+    for (unsigned int i = 0; i < body.size(); i++) {
+        if (!placed[i]) {
+            ordered.push_back(body[i]);
+        }
+    }
+
+    return ordered;
+}
+
+void MagicSets::rewriteRule(const StandardDatalog::Formula &rule, const std::string &adornment) {
+    const std::string &relation = rule.getRelationName();
+    std::set<std::string> bound;
+
+    for (unsigned int i = 0; i < adornment.size(); i++) {
+        if (adornment[i] == 'b' && rule.getArgument(i).isVariable()) {
+            bound.insert(rule.getArgument(i).getVariable());
+        }
+    }
+
+    // bindings are passed left to right through the body
+    StandardDatalog::FormulaVector body = orderBody(rule, bound);
+    StandardDatalog::FormulaVector rewritten_body;
+
+    if (adornment.find('b') != std::string::npos) {
+        rewritten_body.push_back(getMagicAtom(rule, adornment));
+    }
+
+    for (auto const &atom: body) {
+        const std::string &name = atom.getRelationName();
+
+        if (!derived.count(name)) {
+            rewritten_body.push_back(atom);
+        } else if (atom.isNegated() || !recursive.count(name)) {
+            // a negation needs the entire relation, and
+            // views of the facts are cheaper in full
+            addComplete(name);
+            rewritten_body.push_back(atom);
+        } else {
+            std::string atom_adornment = getAdornment(atom, bound);
+            std::string adorned_name = adorn(name, atom_adornment);
+
+            // demand on the atom from the atoms before it
+            if (atom_adornment.find('b') != std::string::npos) {
+                StandardDatalog::Formula magic_atom = getMagicAtom(atom, atom_adornment);
+
+                if (rewritten_body.empty()) {
+                    rewritten.addFormula(magic_atom);
+                } else if (!isGuard(magic_atom, rewritten_body)) {
+                    rewritten.addFormula(StandardDatalog::Formula(magic_atom.getRelationName(),
+                                                                  magic_atom.getArguments(),
+                                                                  rewritten_body));
+                }
+            }
+
+            rewritten_body.push_back(StandardDatalog::Formula(adorned_name, atom.getArguments()));
+        }
+
+        if (!atom.isNegated()) {
+            for (auto const &term: atom.getArguments()) {
+                if (term.isVariable()) {
+                    bound.insert(term.getVariable());
+                }
+            }
+        }
+    }
+
+    rewritten.addFormula(StandardDatalog::Formula(getAdornedName(relation, adornment),
+                                                  rule.getArguments(), rewritten_body));
+}
+
+bool MagicSets::isGuard(const StandardDatalog::Formula &magic_atom, const StandardDatalog::FormulaVector &body) {
+    if (body.size() != 1 || body[0].getRelationName() != magic_atom.getRelationName()) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < magic_atom.getArity(); i++) {
+        const StandardDatalog::Term &a = magic_atom.getArgument(i);
+        const StandardDatalog::Term &b = body[0].getArgument(i);
+
+        if (a.isVariable() != b.isVariable() ||
+            (a.isVariable() ? a.getVariable() != b.getVariable() : a.getValue() != b.getValue())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MagicSets::addImportRule(const std::string &relation, const std::string &adornment) {
+    StandardDatalog::TermVector args;
+
+    for (unsigned int i = 0; i < adornment.size(); i++) {
+        args.push_back(StandardDatalog::Term("x" + std::to_string(i)));
+    }
+
+    StandardDatalog::Formula head(getAdornedName(relation, adornment), args);
+    StandardDatalog::FormulaVector body;
+
+    if (adornment.find('b') != std::string::npos) {
+        body.push_back(getMagicAtom(StandardDatalog::Formula(relation, args), adornment));
+    }
+
+    body.push_back(StandardDatalog::Formula(relation, args));
+    rewritten.addFormula(StandardDatalog::Formula(head, body));
+}
+
+void MagicSets::addComplete(const std::string &relation) {
+    if (complete.count(relation)) {
+        return;
+    }
+
+    complete.insert(relation);
+
+    for (auto const &formula: program.getFormulas()) {
+        if (formula.isAtom() || formula.getRelationName() != relation) {
+            continue;
+        }
+
+        rewritten.addFormula(formula);
+
+        for (auto const &atom: formula.getBody()) {
+            if (derived.count(atom.getRelationName())) {
+                addComplete(atom.getRelationName());
+            }
+        }
+    }
+}
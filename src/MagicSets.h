@@ -0,0 +1,102 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "DatalogIR.h"
+
+/**
+ * Magic-sets rewriting for goal-directed queries
+ *
+ * A query binds some arguments of a relation (its constants),
+ * written as an adornment, e.g. pointsTo(5, y) is pointsTo_bf.
+ * Each derived relation reachable from the query is copied once per
+ * adornment it is used with, and its rules are guarded by a magic
+ * relation holding the bindings actually demanded. Bindings are
+ * passed through rule bodies left to right (each body is first
+ * reordered to join the atoms with the most bound arguments first),
+ * and the magic rules derive the demand on each body atom from the
+ * atoms before it. The new relations start with an underscore,
+ * which the DSL reserves, e.g. _pointsTo_bf and _magic_pointsTo_bf
+ *
+ * Derived relations under a negation are evaluated in full (with
+ * their original rules), which keeps the rewritten program stratified.
+ * So are the derived relations not depending on any recursion, which
+ * are only views of the facts and cheaper to evaluate once than per
+ * adornment
+ */
+class MagicSets {
+    const StandardDatalog::Program &program;
+    StandardDatalog::Formula query;
+    StandardDatalog::Program rewritten;
+
+    std::set<std::string> derived; // relations with rules
+    std::set<std::string> recursive; // relations depending on a recursive stratum
+    std::set<std::string> with_facts;
+    std::set<std::string> complete; // relations evaluated in full
+
+    std::set<std::string> adorned; // adorned relations declared so far
+    std::vector<std::pair<std::string, std::string>> worklist; // (relation, adornment)
+
+    std::string query_relation;
+
+public:
+    MagicSets(const StandardDatalog::Program &program, const StandardDatalog::Formula &query);
+
+    const StandardDatalog::Program &getProgram() const { return rewritten; }
+
+    /**
+     * Relation of the rewritten program holding the answers
+     * (which may also contain tuples for other bindings)
+     */
+    const std::string &getQueryRelation() const { return query_relation; }
+
+    /**
+     * Answers to the query from a backend the
+     * rewritten program has been loaded into
+     */
+    StandardDatalog::FormulaVector getAnswers(StandardDatalog::Backend &backend) const;
+
+private:
+    static std::string getAdornment(const StandardDatalog::Formula &atom, const std::set<std::string> &bound);
+    static std::string getAdornedName(const std::string &relation, const std::string &adornment);
+    static std::string getMagicName(const std::string &relation, const std::string &adornment);
+
+    /**
+     * Magic atom of the bound arguments of an atom
+     */
+    static StandardDatalog::Formula getMagicAtom(const StandardDatalog::Formula &atom,
+                                                 const std::string &adornment);
+
+    /**
+     * Declare an adorned relation (and its magic relation) on first
+     * use and queue its rules for rewriting. Returns the adorned name
+     */
+    std::string adorn(const std::string &relation, const std::string &adornment);
+
+    /**
+     * Order a body for passing bindings (see above), with each
+     * negation right after the atom binding its last variable
+     */
+    StandardDatalog::FormulaVector orderBody(const StandardDatalog::Formula &rule,
+                                             std::set<std::string> bound) const;
+
+    /**
+     * If a magic rule would only restate its guard, as for
+     * the first atom of R(x, z) :- R(x, y), R(y, z)
+     */
+    static bool isGuard(const StandardDatalog::Formula &magic_atom, const StandardDatalog::FormulaVector &body);
+
+    void rewriteRule(const StandardDatalog::Formula &rule, const std::string &adornment);
+
+    /**
+     * Keep the original rules of a relation and all it depends on
+     */
+    void addComplete(const std::string &relation);
+
+    /**
+     * Copy the facts of a derived relation into an adorned one
+     */
+    void addImportRule(const std::string &relation, const std::string &adornment);
+};
@@ -0,0 +1,2003 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <numeric>
+#include <queue>
+
+#include "llvm/Support/Format.h"
+
+#include "NativeBackend.h"
+
+#ifdef DATALOG_AA_JIT
+#include "NativeJIT.h"
+#endif
+
+#define MAX_ARITY 32
+#define MAX_BODY_SIZE 32
+
+/**
+ * Table
+ */
+
+const unsigned int NativeBackend::Table::EMPTY_SLOT;
+
+uint64_t NativeBackend::Table::hash(const Value *values, unsigned int length) {
+    uint64_t hash_value = 0x9e3779b97f4a7c15ull;
+
+    for (unsigned int i = 0; i < length; i++) {
+        hash_value ^= values[i];
+        hash_value *= 0xff51afd7ed558ccdull;
+        hash_value ^= hash_value >> 32;
+    }
+
+    return hash_value;
+}
+
+unsigned int NativeBackend::Table::findSlot(const Value *tuple, uint64_t hash_value) const {
+    size_t slot_mask = slots.size() - 1;
+    size_t slot = hash_value & slot_mask;
+
+    while (slots[slot] != EMPTY_SLOT &&
+           !std::equal(tuple, tuple + arity, getRow(slots[slot]))) {
+        slot = (slot + 1) & slot_mask;
+    }
+
+    return slot;
+}
+
+void NativeBackend::Table::growSlots() {
+    size_t new_size = slots.empty() ? 16 : slots.size() * 2;
+    slots.assign(new_size, EMPTY_SLOT);
+
+    for (unsigned int id = 0; id < num_rows; id++) {
+        const Value *row = getRow(id);
+        slots[findSlot(row, hash(row, arity))] = id;
+    }
+}
+
+bool NativeBackend::Table::contains(const Value *tuple) const {
+    if (arity == 0) {
+        return num_rows != 0;
+    }
+
+    if (slots.empty()) {
+        return false;
+    }
+
+    return slots[findSlot(tuple, hash(tuple, arity))] != EMPTY_SLOT;
+}
+
+bool NativeBackend::Table::insert(const Value *tuple) {
+    if (arity == 0) {
+        if (num_rows != 0) {
+            return false;
+        }
+
+        num_rows = 1;
+        return true;
+    }
+
+    // keep the load factor under 1/2
+    if (((size_t)num_rows + 1) * 2 > slots.size()) {
+        growSlots();
+    }
+
+    unsigned int slot = findSlot(tuple, hash(tuple, arity));
+
+    if (slots[slot] != EMPTY_SLOT) {
+        return false;
+    }
+
+    slots[slot] = num_rows++;
+    rows.append(tuple, arity);
+
+    return true;
+}
+
+bool NativeBackend::Table::erase(const Value *tuple) {
+    if (arity == 0) {
+        if (num_rows == 0) {
+            return false;
+        }
+
+        num_rows = 0;
+        return true;
+    }
+
+    if (slots.empty()) {
+        return false;
+    }
+
+    size_t slot_mask = slots.size() - 1;
+    size_t hole = findSlot(tuple, hash(tuple, arity));
+
+    if (slots[hole] == EMPTY_SLOT) {
+        return false;
+    }
+
+    unsigned int id = slots[hole];
+    unsigned int last = num_rows - 1;
+
+    // the last row takes the id of the erased one,
+    // which keeps the order of the buckets
+    for (auto &entry: indices) {
+        updateIndex(&entry - indices.data());
+
+        std::vector<unsigned int> &bucket = entry.buckets[getRow(id)[entry.order[0]]];
+        unsigned int *erased = findInIndex(entry, id);
+        unsigned int *moved = last != id ? findInIndex(entry, last) : NULL;
+
+        if (moved) {
+            *moved = id;
+        }
+
+        bucket.erase(bucket.begin() + (erased - bucket.data()));
+
+        if (bucket.empty()) {
+            entry.buckets.erase(getRow(id)[entry.order[0]]);
+        }
+
+        entry.indexed_rows = last;
+    }
+
+    for (auto &trie: tries) {
+        trie.ids.clear();
+        trie.indexed_rows = 0;
+    }
+
+    // backward shift deletion: move up the rows of the probe
+    // sequence after the hole that may take its place
+    for (size_t next = (hole + 1) & slot_mask; slots[next] != EMPTY_SLOT; next = (next + 1) & slot_mask) {
+        size_t home = hash(getRow(slots[next]), arity) & slot_mask;
+
+        if (((next - home) & slot_mask) >= ((next - hole) & slot_mask)) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+    }
+
+    slots[hole] = EMPTY_SLOT;
+
+    if (last != id) {
+        slots[findSlot(getRow(last), hash(getRow(last), arity))] = id;
+        std::copy(getRow(last), getRow(last) + arity, rows.data() + (size_t)id * arity);
+    }
+
+    num_rows = last;
+    rows.resize((size_t)num_rows * arity);
+
+    return true;
+}
+
+void NativeBackend::Table::addIndex(const IndexSelection::Order &order) {
+    assert(order.size() == arity && "index order must cover all columns");
+
+    indices.emplace_back();
+    indices.back().order = order;
+}
+
+unsigned int NativeBackend::Table::getIndex(unsigned int mask) {
+    unsigned int prefix_length = __builtin_popcount(mask);
+
+    for (unsigned int i = 0; i < indices.size(); i++) {
+        unsigned int prefix = 0;
+
+        for (unsigned int j = 0; j < prefix_length; j++) {
+            prefix |= 1u << indices[i].order[j];
+        }
+
+        if (prefix == mask) {
+            return i;
+        }
+    }
+
+    // the columns of the mask, then the rest
+    IndexSelection::Order order;
+
+    for (unsigned int col = 0; col < arity; col++) {
+        if (mask & (1u << col)) {
+            order.push_back(col);
+        }
+    }
+
+    for (unsigned int col = 0; col < arity; col++) {
+        if (!(mask & (1u << col))) {
+            order.push_back(col);
+        }
+    }
+
+    addIndex(order);
+
+    return indices.size() - 1;
+}
+
+unsigned int NativeBackend::Table::getIndex(const IndexSelection::Order &order) {
+    for (unsigned int i = 0; i < indices.size(); i++) {
+        if (indices[i].order == order) {
+            return i;
+        }
+    }
+
+    addIndex(order);
+
+    return indices.size() - 1;
+}
+
+/**
+ * Lexicographic order of two rows by the columns of an order
+ */
+static bool isLess(const NativeBackend::Value *row_a, const NativeBackend::Value *row_b,
+                   const IndexSelection::Order &order) {
+    for (unsigned int col: order) {
+        if (row_a[col] != row_b[col]) {
+            return row_a[col] < row_b[col];
+        }
+    }
+
+    return false;
+}
+
+unsigned int *NativeBackend::Table::findInIndex(Index &entry, unsigned int id) {
+    const Value *row = getRow(id);
+    std::vector<unsigned int> &bucket = entry.buckets.at(row[entry.order[0]]);
+
+    // rows are distinct, so exactly one matches all columns
+    return std::partition_point(bucket.data(), bucket.data() + bucket.size(), [&] (unsigned int other) {
+        return isLess(getRow(other), row, entry.order);
+    });
+}
+
+void NativeBackend::Table::updateIndex(unsigned int index) {
+    Index &entry = indices[index];
+
+    if (entry.indexed_rows == num_rows) {
+        return;
+    }
+
+    auto less = [&] (unsigned int a, unsigned int b) {
+        const Value *row_a = getRow(a);
+        const Value *row_b = getRow(b);
+
+        for (unsigned int i = 1; i < entry.order.size(); i++) {
+            unsigned int col = entry.order[i];
+
+            if (row_a[col] != row_b[col]) {
+                return row_a[col] < row_b[col];
+            }
+        }
+
+        return false;
+    };
+
+    // buckets with new rows, and their sizes before
+    std::vector<std::pair<std::vector<unsigned int> *, size_t>> updated;
+
+    for (unsigned int id = entry.indexed_rows; id < num_rows; id++) {
+        std::vector<unsigned int> &bucket = entry.buckets[getRow(id)[entry.order[0]]];
+
+        if (bucket.empty() || bucket.back() < entry.indexed_rows) {
+            updated.push_back(std::make_pair(&bucket, bucket.size()));
+        }
+
+        bucket.push_back(id);
+    }
+
+    // sort the new rows and merge them with the old ones
+    for (auto const &item: updated) {
+        std::vector<unsigned int> &bucket = *item.first;
+
+        std::sort(bucket.begin() + item.second, bucket.end(), less);
+        std::inplace_merge(bucket.begin(), bucket.begin() + item.second, bucket.end(), less);
+    }
+
+    entry.indexed_rows = num_rows;
+}
+
+std::pair<const unsigned int *, const unsigned int *>
+NativeBackend::Table::lookup(unsigned int index, unsigned int prefix_length, const Value *key) const {
+    const Index &entry = indices[index];
+
+    assert(entry.indexed_rows == num_rows && "index is out of date");
+    assert(prefix_length > 0 && "lookup without a key");
+
+    auto found = entry.buckets.find(key[0]);
+
+    if (found == entry.buckets.end()) {
+        return std::make_pair((const unsigned int *)NULL, (const unsigned int *)NULL);
+    }
+
+    const unsigned int *first = found->second.data();
+    const unsigned int *last = first + found->second.size();
+
+    if (prefix_length == 1) {
+        return std::make_pair(first, last);
+    }
+
+    // compare the rest of the prefix of a row with the key
+    auto compare = [&] (unsigned int id) {
+        const Value *row = getRow(id);
+
+        for (unsigned int i = 1; i < prefix_length; i++) {
+            if (row[entry.order[i]] != key[i]) {
+                return row[entry.order[i]] < key[i] ? -1 : 1;
+            }
+        }
+
+        return 0;
+    };
+
+    first = std::partition_point(first, last, [&] (unsigned int id) {
+        return compare(id) < 0;
+    });
+
+    last = std::partition_point(first, last, [&] (unsigned int id) {
+        return compare(id) == 0;
+    });
+
+    return std::make_pair(first, last);
+}
+
+unsigned int NativeBackend::Table::getTrie(const IndexSelection::Order &order) {
+    assert(order.size() == arity && "trie order must cover all columns");
+
+    for (unsigned int i = 0; i < tries.size(); i++) {
+        if (tries[i].order == order) {
+            return i;
+        }
+    }
+
+    tries.emplace_back(order, scratch);
+
+    return tries.size() - 1;
+}
+
+void NativeBackend::Table::updateTrie(unsigned int trie) {
+    Trie &entry = tries[trie];
+
+    if (entry.indexed_rows == num_rows) {
+        return;
+    }
+
+    size_t num_old = entry.ids.size();
+
+    for (unsigned int id = entry.indexed_rows; id < num_rows; id++) {
+        entry.ids.push_back(id);
+    }
+
+    // sort the new rows and merge them with the old ones (into a new
+    // array, since std::inplace_merge takes its buffer from the heap)
+    sortRows(entry.order, entry.ids.data() + num_old, entry.ids.data() + entry.ids.size());
+
+    if (num_old != 0) {
+        ScratchArray<unsigned int> merged(scratch);
+        merged.resize(entry.ids.size());
+
+        std::merge(entry.ids.begin(), entry.ids.begin() + num_old,
+                   entry.ids.begin() + num_old, entry.ids.end(), merged.begin(),
+                   [&] (unsigned int a, unsigned int b) {
+            return isLess(getRow(a), getRow(b), entry.order);
+        });
+
+        entry.ids.swap(merged);
+    }
+
+    entry.indexed_rows = num_rows;
+}
+
+void NativeBackend::Table::sortRows(const IndexSelection::Order &order,
+                                    unsigned int *first, unsigned int *last) const {
+    std::sort(first, last, [&] (unsigned int a, unsigned int b) {
+        return isLess(getRow(a), getRow(b), order);
+    });
+}
+
+/**
+ * Loading and compiling rules
+ */
+
+NativeBackend::NativeBackend(unsigned int num_threads, bool use_jit, JoinStrategy join_strategy,
+                             size_t memory_limit, const std::string &scratch_directory):
+    join_strategy(join_strategy), pool(new WorkStealingPool(num_threads)) {
+    if (memory_limit != 0) {
+        scratch.reset(new ScratchSpace(memory_limit, scratch_directory));
+
+        // a quarter of the limit for the buffers of all workers,
+        // but no runs of less than a few pages
+        spill_threshold = std::max<size_t>(memory_limit / sizeof(Value) / (4 * num_threads), 4096);
+    }
+
+    if (use_jit) {
+#ifdef DATALOG_AA_JIT
+        jit.reset(new NativeJIT());
+#else
+        std::cerr << "built without DATALOG_AA_JIT, rules will be interpreted"
+                  << std::endl;
+#endif
+    }
+}
+
+NativeBackend::~NativeBackend() {}
+
+void NativeBackend::load(const StandardDatalog::Program &program) {
+    compileProgram(program);
+
+    for (auto const &stratum: strata) {
+        evaluateStratum(stratum);
+    }
+}
+
+void NativeBackend::compileProgram(const StandardDatalog::Program &program) {
+    relation_ids.clear();
+    relation_names.clear();
+    tables.clear();
+    rules.clear();
+    strata.clear();
+    num_leapfrog_rules = 0;
+    num_runs = 0;
+
+    index_selection.reset(new IndexSelection(program));
+
+    for (auto const &item: program.getRelations()) {
+        unsigned int arity = item.second.getArgumentSortNames().size();
+        assert(arity <= MAX_ARITY && "relation arity not supported");
+
+        relation_ids[item.first] = relation_names.size();
+        relation_names.push_back(item.first);
+        tables.emplace_back(new Table(arity, scratch.get()));
+
+        for (auto const &order: index_selection->getOrders(item.first)) {
+            tables.back()->addIndex(order);
+        }
+    }
+
+    // ground facts go directly into the table
+    for (auto const &item: program.getFacts()) {
+        const StandardDatalog::FactTable &facts = *item.second;
+        Table &table = *tables[relation_ids.at(item.first)];
+
+        for (size_t i = 0; i < facts.size(); i++) {
+            table.insert(facts.getRow(i));
+        }
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        compileRule(formula);
+    }
+
+    stratify(program);
+
+    fact_tables.clear();
+    fact_tables.resize(tables.size());
+
+    for (auto const &rule: rules) {
+        num_leapfrog_rules += isLeapfrogRule(rule);
+
+        unsigned int relation = rule.head.relation;
+        const Table &table = *tables[relation];
+
+        if (fact_tables[relation]) {
+            continue;
+        }
+
+        // nothing is derived yet, so the table only has facts
+        fact_tables[relation].reset(new Table(table.getArity()));
+
+        for (unsigned int id = 0; id < table.size(); id++) {
+            fact_tables[relation]->insert(table.getRow(id));
+        }
+    }
+
+    delta_begin.assign(tables.size(), 0);
+    delta_end.assign(tables.size(), 0);
+    derived.clear();
+
+    for (unsigned int i = 0; i < pool->getNumThreads(); i++) {
+        derived.emplace_back(tables.size());
+    }
+}
+
+NativeBackend::Atom NativeBackend::compileAtom(std::map<std::string, unsigned int> &var_slots,
+                                               const StandardDatalog::Formula &atom) {
+    auto found = relation_ids.find(atom.getRelationName());
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    Atom compiled;
+    compiled.relation = found->second;
+    compiled.negated = atom.isNegated();
+
+    assert(atom.getArity() == tables[compiled.relation]->getArity() &&
+           "number of terms does not match the arity");
+
+    for (auto const &term: atom.getArguments()) {
+        if (term.isVariable()) {
+            auto slot = var_slots.find(term.getVariable());
+
+            if (slot == var_slots.end()) {
+                slot = var_slots.insert(std::make_pair(term.getVariable(), var_slots.size())).first;
+            }
+
+            compiled.args.push_back({ true, slot->second });
+        } else {
+            compiled.args.push_back({ false, term.getValue() });
+        }
+    }
+
+    return compiled;
+}
+
+void NativeBackend::compileRule(const StandardDatalog::Formula &formula) {
+    std::map<std::string, unsigned int> var_slots;
+    Rule rule;
+
+    // number the variables of positive atoms first,
+    // then the rest must all be bound by them
+    for (auto const &atom: formula.getBody()) {
+        if (!atom.isNegated()) {
+            rule.body.push_back(compileAtom(var_slots, atom));
+        }
+    }
+
+    unsigned int num_bound = var_slots.size();
+
+    for (auto const &atom: formula.getBody()) {
+        if (atom.isNegated()) {
+            rule.body.push_back(compileAtom(var_slots, atom));
+        }
+    }
+
+    rule.head = compileAtom(var_slots, formula);
+    rule.num_vars = var_slots.size();
+
+    assert(rule.num_vars == num_bound &&
+           "variables in the head or negated atoms must appear in a positive atom");
+
+    rules.push_back(rule);
+}
+
+void NativeBackend::stratify(const StandardDatalog::Program &program) {
+    std::vector<std::vector<unsigned int>> rules_of(tables.size());
+
+    for (unsigned int i = 0; i < rules.size(); i++) {
+        rules_of[rules[i].head.relation].push_back(i);
+    }
+
+    for (auto const &item: program.getStrata()) {
+        Stratum stratum;
+        stratum.recursive = item.recursive;
+
+        for (auto const &name: item.relations) {
+            unsigned int relation = relation_ids.at(name);
+            stratum.relations.push_back(relation);
+            stratum.rules.insert(stratum.rules.end(),
+                                 rules_of[relation].begin(), rules_of[relation].end());
+        }
+
+        for (unsigned int rule: stratum.rules) {
+            for (auto const &atom: rules[rule].body) {
+                assert(!(atom.negated && isInStratum(stratum, atom.relation)) &&
+                       "negation cannot be stratified");
+            }
+        }
+
+        strata.push_back(stratum);
+    }
+}
+
+bool NativeBackend::isInStratum(const Stratum &stratum, unsigned int relation) const {
+    return std::find(stratum.relations.begin(), stratum.relations.end(), relation) !=
+           stratum.relations.end();
+}
+
+/**
+ * Evaluation
+ */
+
+NativeBackend::JoinPlan NativeBackend::planRule(const Rule &rule, const Stratum &stratum, int delta_atom) {
+    JoinPlan plan;
+    plan.rule = &rule;
+
+    if (isLeapfrogRule(rule)) {
+        planLeapfrog(rule, stratum, delta_atom, plan);
+        return plan;
+    }
+
+    // join the delta first since it's usually the smallest,
+    // then the rest of the positive atoms in order
+    std::vector<unsigned int> order;
+
+    if (delta_atom >= 0) {
+        order.push_back(delta_atom);
+    }
+
+    for (unsigned int i = 0; i < rule.body.size(); i++) {
+        if (rule.body[i].negated) {
+            plan.negations.push_back(i);
+        } else if ((int)i != delta_atom) {
+            order.push_back(i);
+        }
+    }
+
+    std::vector<bool> bound(rule.num_vars, false);
+
+    for (unsigned int i: order) {
+        const Atom &atom = rule.body[i];
+        JoinStep step = planStep(atom, bound);
+
+        step.atom = i;
+        step.range = getAtomRange(rule, stratum, i, delta_atom);
+
+        if (step.mask != 0) {
+            auto index = index_selection->getIndex(relation_names[atom.relation], step.mask);
+            const IndexSelection::Order &order =
+                index_selection->getOrders(relation_names[atom.relation])[index.index];
+
+            step.index = index.index;
+
+            for (unsigned int i = 0; i < index.prefix_length; i++) {
+                step.key.push_back(atom.args[order[i]]);
+            }
+        }
+
+        plan.steps.push_back(step);
+    }
+
+    return plan;
+}
+
+NativeBackend::JoinStep NativeBackend::planStep(const Atom &atom, std::vector<bool> &bound) const {
+    JoinStep step;
+    step.atom = 0;
+    step.mask = 0;
+    step.index = 0;
+    step.range = FULL;
+
+    std::vector<bool> bound_here(bound.size(), false);
+
+    for (unsigned int col = 0; col < atom.args.size(); col++) {
+        const Argument &arg = atom.args[col];
+
+        if (!arg.is_var || bound[arg.value]) {
+            step.mask |= 1u << col;
+        } else if (bound_here[arg.value]) {
+            step.checks.push_back(std::make_pair(col, arg.value));
+        } else {
+            step.binds.push_back(std::make_pair(col, arg.value));
+            bound_here[arg.value] = true;
+        }
+    }
+
+    for (auto const &bind: step.binds) {
+        bound[bind.second] = true;
+    }
+
+    return step;
+}
+
+NativeBackend::Range NativeBackend::getAtomRange(const Rule &rule, const Stratum &stratum,
+                                                unsigned int atom, int delta_atom) const {
+    if (!isInStratum(stratum, rule.body[atom].relation)) {
+        return FULL;
+    } else if ((int)atom == delta_atom) {
+        return DELTA;
+    } else if ((int)atom < delta_atom) {
+        return OLD;
+    } else {
+        return FULL;
+    }
+}
+
+bool NativeBackend::isLeapfrogRule(const Rule &rule) const {
+    // hyperedges of the positive atoms (sets of variable slots)
+    std::vector<std::vector<bool>> edges;
+    std::vector<unsigned int> num_atoms_of(rule.num_vars, 0);
+
+    for (auto const &atom: rule.body) {
+        if (atom.negated) {
+            continue;
+        }
+
+        edges.emplace_back(rule.num_vars, false);
+
+        for (auto const &arg: atom.args) {
+            if (arg.is_var && !edges.back()[arg.value]) {
+                edges.back()[arg.value] = true;
+                num_atoms_of[arg.value]++;
+            }
+        }
+    }
+
+    if (join_strategy == BinaryJoin || edges.size() < 3 || edges.size() > MAX_BODY_SIZE) {
+        return false;
+    }
+
+    if (join_strategy == LeapfrogJoin) {
+        return true;
+    }
+
+    // high fan-out: a variable shared by three or more atoms
+    for (unsigned int count: num_atoms_of) {
+        if (count >= 3) {
+            return true;
+        }
+    }
+
+    // cyclic: the GYO reduction (removing the variables in a single
+    // edge, and the edges contained in another) leaves several edges
+    bool changed = true;
+
+    while (changed && edges.size() > 1) {
+        changed = false;
+
+        for (unsigned int var = 0; var < rule.num_vars; var++) {
+            if (num_atoms_of[var] == 1) {
+                for (auto &edge: edges) {
+                    edge[var] = false;
+                }
+
+                num_atoms_of[var] = 0;
+                changed = true;
+            }
+        }
+
+        for (unsigned int i = 0; i < edges.size(); i++) {
+            for (unsigned int j = 0; j < edges.size(); j++) {
+                bool contained = i != j;
+
+                for (unsigned int var = 0; var < rule.num_vars && contained; var++) {
+                    contained = !edges[i][var] || edges[j][var];
+                }
+
+                if (contained) {
+                    for (unsigned int var = 0; var < rule.num_vars; var++) {
+                        num_atoms_of[var] -= edges[i][var];
+                    }
+
+                    edges.erase(edges.begin() + i);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return edges.size() > 1;
+}
+
+void NativeBackend::planLeapfrog(const Rule &rule, const Stratum &stratum, int delta_atom, JoinPlan &plan) {
+    plan.leapfrog = true;
+
+    std::vector<unsigned int> atoms;
+
+    if (delta_atom >= 0) {
+        atoms.push_back(delta_atom);
+    }
+
+    for (unsigned int i = 0; i < rule.body.size(); i++) {
+        if (rule.body[i].negated) {
+            plan.negations.push_back(i);
+        } else if ((int)i != delta_atom) {
+            atoms.push_back(i);
+        }
+    }
+
+    // variables in the order they first appear
+    std::vector<unsigned int> rank(rule.num_vars, ~0u);
+
+    for (unsigned int i: atoms) {
+        for (auto const &arg: rule.body[i].args) {
+            if (arg.is_var && rank[arg.value] == ~0u) {
+                rank[arg.value] = plan.levels.size();
+                plan.levels.emplace_back();
+                plan.levels.back().slot = arg.value;
+            }
+        }
+    }
+
+    for (unsigned int i: atoms) {
+        const Atom &atom = rule.body[i];
+        TrieAtom trie_atom;
+
+        trie_atom.atom = i;
+        trie_atom.range = getAtomRange(rule, stratum, i, delta_atom);
+
+        // constant columns first, then the columns of each
+        // variable together (stable, so in column order)
+        for (unsigned int col = 0; col < atom.args.size(); col++) {
+            trie_atom.order.push_back(col);
+        }
+
+        std::stable_sort(trie_atom.order.begin(), trie_atom.order.end(), [&] (unsigned int a, unsigned int b) {
+            unsigned int rank_a = atom.args[a].is_var ? rank[atom.args[a].value] + 1 : 0;
+            unsigned int rank_b = atom.args[b].is_var ? rank[atom.args[b].value] + 1 : 0;
+            return rank_a < rank_b;
+        });
+
+        trie_atom.num_constants = 0;
+
+        while (trie_atom.num_constants < atom.args.size() &&
+               !atom.args[trie_atom.order[trie_atom.num_constants]].is_var) {
+            trie_atom.num_constants++;
+        }
+
+        if (trie_atom.range != DELTA) {
+            trie_atom.trie = tables[atom.relation]->getTrie(trie_atom.order);
+        }
+
+        for (unsigned int depth = trie_atom.num_constants; depth < atom.args.size();) {
+            unsigned int slot = atom.args[trie_atom.order[depth]].value;
+            TrieIterator iterator = { (unsigned int)plan.trie_atoms.size(), depth, 0 };
+
+            while (depth < atom.args.size() && atom.args[trie_atom.order[depth]].value == slot) {
+                iterator.width++;
+                depth++;
+            }
+
+            plan.levels[rank[slot]].iterators.push_back(iterator);
+        }
+
+        plan.trie_atoms.push_back(trie_atom);
+    }
+}
+
+void NativeBackend::evaluateStratum(const Stratum &stratum) {
+    std::vector<JoinPlan> base_plans;
+    std::vector<JoinPlan> delta_plans;
+
+    for (unsigned int i: stratum.rules) {
+        const Rule &rule = rules[i];
+        bool recursive = false;
+
+        for (unsigned int j = 0; j < rule.body.size(); j++) {
+            if (!rule.body[j].negated && isInStratum(stratum, rule.body[j].relation)) {
+                delta_plans.push_back(planRule(rule, stratum, j));
+                recursive = true;
+            }
+        }
+
+        if (!recursive) {
+            base_plans.push_back(planRule(rule, stratum, -1));
+        }
+    }
+
+#ifdef DATALOG_AA_JIT
+    if (jit) {
+        jit->compile(*this, base_plans);
+        jit->compile(*this, delta_plans);
+    }
+#endif
+
+    // non-recursive rules only need to be evaluated once
+    evaluatePlans(base_plans);
+    commitDerived(stratum);
+
+    if (!stratum.recursive) {
+        return;
+    }
+
+    // everything derived so far is the initial delta
+    for (unsigned int relation: stratum.relations) {
+        delta_begin[relation] = 0;
+        delta_end[relation] = tables[relation]->size();
+    }
+
+    do {
+        evaluatePlans(delta_plans);
+    } while (commitDerived(stratum));
+}
+
+void NativeBackend::evaluatePlans(const std::vector<JoinPlan> &plans) {
+    // tables are read-only during the iteration,
+    // so all indices have to be ready beforehand
+    for (auto const &plan: plans) {
+        for (auto const &step: plan.steps) {
+            if (step.mask != 0) {
+                tables[plan.rule->body[step.atom].relation]->updateIndex(step.index);
+            }
+        }
+
+        for (auto const &trie_atom: plan.trie_atoms) {
+            if (trie_atom.range != DELTA) {
+                tables[plan.rule->body[trie_atom.atom].relation]->updateTrie(trie_atom.trie);
+            }
+        }
+    }
+
+    // split the rows scanned by the first step of each plan
+    // into chunks so that a single large rule can be shared
+    // (a leapfrog triejoin runs as a single task)
+    unsigned int num_threads = pool->getNumThreads();
+    std::vector<JoinTask> tasks;
+
+    for (auto const &plan: plans) {
+        if (plan.leapfrog || plan.steps.empty() || plan.steps[0].mask != 0 || num_threads == 1) {
+            tasks.push_back({ &plan, 0, ~0u });
+            continue;
+        }
+
+        auto range = getRange(plan, plan.steps[0]);
+        unsigned int chunk = std::max((range.second - range.first) / (num_threads * 4), 1024u);
+
+        for (unsigned int begin = range.first; begin < range.second; begin += chunk) {
+            tasks.push_back({ &plan, begin, std::min(begin + chunk, range.second) });
+        }
+    }
+
+    std::vector<WorkStealingPool::Task> closures;
+
+    for (auto const &task: tasks) {
+        closures.push_back([this, &task] (unsigned int worker) {
+            if (task.plan->compiled) {
+                runCompiled(task, derived[worker]);
+                return;
+            }
+
+            if (task.plan->leapfrog) {
+                leapfrogJoin(*task.plan, derived[worker]);
+                return;
+            }
+
+            std::vector<Value> slots(task.plan->rule->num_vars);
+            join(task, 0, slots, derived[worker]);
+        });
+    }
+
+    pool->run(closures);
+}
+
+std::pair<unsigned int, unsigned int>
+NativeBackend::getRange(const JoinPlan &plan, const JoinStep &step) const {
+    unsigned int relation = plan.rule->body[step.atom].relation;
+
+    switch (step.range) {
+        case FULL: return std::make_pair(0u, tables[relation]->size());
+        case OLD: return std::make_pair(0u, delta_begin[relation]);
+        case DELTA: return std::make_pair(delta_begin[relation], delta_end[relation]);
+    }
+
+    assert(0 && "unknown range");
+    return std::make_pair(0u, 0u);
+}
+
+void NativeBackend::join(const JoinTask &task, unsigned int step_index,
+                         std::vector<Value> &slots, Buffer &output) const {
+    const JoinPlan &plan = *task.plan;
+
+    if (step_index == plan.steps.size()) {
+        emitHead(plan, slots, output);
+        return;
+    }
+
+    const JoinStep &step = plan.steps[step_index];
+    const Table &table = *tables[plan.rule->body[step.atom].relation];
+
+    auto range = getRange(plan, step);
+    unsigned int begin = range.first, end = range.second;
+
+    if (step_index == 0) {
+        begin = std::max(begin, task.begin);
+        end = std::min(end, task.end);
+    }
+
+    Value key[MAX_ARITY];
+
+    for (unsigned int i = 0; i < step.key.size(); i++) {
+        key[i] = step.key[i].is_var ? slots[step.key[i].value] : step.key[i].value;
+    }
+
+    auto visit_row = [&] (unsigned int id) {
+        const Value *row = table.getRow(id);
+
+        for (auto const &bind: step.binds) {
+            slots[bind.second] = row[bind.first];
+        }
+
+        for (auto const &check: step.checks) {
+            if (row[check.first] != slots[check.second]) {
+                return;
+            }
+        }
+
+        join(task, step_index + 1, slots, output);
+    };
+
+    if (step.mask == 0) {
+        for (unsigned int id = begin; id < end; id++) {
+            visit_row(id);
+        }
+    } else {
+        auto candidates = table.lookup(step.index, step.key.size(), key);
+
+        for (const unsigned int *id = candidates.first; id != candidates.second; id++) {
+            if (*id >= begin && *id < end) {
+                visit_row(*id);
+            }
+        }
+    }
+}
+
+/**
+ * First position in [first, last) not satisfying a predicate that holds
+ * on a prefix of the range, by galloping from the start, since the
+ * iterators of a leapfrog triejoin mostly move forward by a little
+ */
+template<typename Predicate>
+static const unsigned int *gallop(const unsigned int *first, const unsigned int *last, Predicate predicate) {
+    size_t step = 1;
+
+    while (step < (size_t)(last - first) && predicate(first[step])) {
+        first += step;
+        step *= 2;
+    }
+
+    return std::partition_point(first, first + std::min(step, (size_t)(last - first)), predicate);
+}
+
+void NativeBackend::leapfrogJoin(const JoinPlan &plan, Buffer &output) const {
+    TrieRanges state;
+
+    state.delta_ids.resize(plan.trie_atoms.size());
+    state.ranges.resize(plan.trie_atoms.size());
+
+    for (unsigned int i = 0; i < plan.trie_atoms.size(); i++) {
+        const TrieAtom &trie_atom = plan.trie_atoms[i];
+        const Atom &atom = plan.rule->body[trie_atom.atom];
+        const Table &table = *tables[atom.relation];
+
+        const unsigned int *first, *last;
+
+        if (trie_atom.range == DELTA) {
+            // the delta changes every iteration, so it's sorted here
+            std::vector<unsigned int> &ids = state.delta_ids[i];
+
+            for (unsigned int id = delta_begin[atom.relation]; id < delta_end[atom.relation]; id++) {
+                ids.push_back(id);
+            }
+
+            table.sortRows(trie_atom.order, ids.data(), ids.data() + ids.size());
+
+            first = ids.data();
+            last = first + ids.size();
+        } else {
+            const ScratchArray<unsigned int> &ids = table.getTrieRows(trie_atom.trie);
+
+            first = ids.data();
+            last = first + ids.size();
+        }
+
+        // the rows matching the constants
+        for (unsigned int depth = 0; depth < trie_atom.num_constants; depth++) {
+            unsigned int col = trie_atom.order[depth];
+            Value value = atom.args[col].value;
+
+            first = gallop(first, last, [&] (unsigned int id) { return table.getRow(id)[col] < value; });
+            last = gallop(first, last, [&] (unsigned int id) { return table.getRow(id)[col] == value; });
+        }
+
+        if (first == last) {
+            return;
+        }
+
+        // atoms without variables have a single row left
+        if (trie_atom.num_constants == atom.args.size() && trie_atom.range == OLD &&
+            *first >= delta_begin[atom.relation]) {
+            return;
+        }
+
+        state.ranges[i] = std::make_pair(first, last);
+    }
+
+    std::vector<Value> slots(plan.rule->num_vars);
+    leapfrog(plan, 0, state, slots, output);
+}
+
+void NativeBackend::leapfrog(const JoinPlan &plan, unsigned int level, TrieRanges &state,
+                             std::vector<Value> &slots, Buffer &output) const {
+    if (level == plan.levels.size()) {
+        emitHead(plan, slots, output);
+        return;
+    }
+
+    const std::vector<TrieIterator> &iterators = plan.levels[level].iterators;
+    unsigned int num_iterators = iterators.size();
+
+    // current position of each iterator and the end of its range,
+    // whose values in the column of the iterator are sorted
+    const unsigned int *begins[MAX_BODY_SIZE];
+    const unsigned int *positions[MAX_BODY_SIZE];
+    const unsigned int *ends[MAX_BODY_SIZE];
+    const Table *iterator_tables[MAX_BODY_SIZE];
+    unsigned int columns[MAX_BODY_SIZE];
+
+    for (unsigned int i = 0; i < num_iterators; i++) {
+        const TrieAtom &trie_atom = plan.trie_atoms[iterators[i].trie_atom];
+
+        begins[i] = positions[i] = state.ranges[iterators[i].trie_atom].first;
+        ends[i] = state.ranges[iterators[i].trie_atom].second;
+        iterator_tables[i] = tables[plan.rule->body[trie_atom.atom].relation].get();
+        columns[i] = trie_atom.order[iterators[i].depth];
+    }
+
+    auto key = [&] (unsigned int i) {
+        return iterator_tables[i]->getRow(*positions[i])[columns[i]];
+    };
+
+    Value max = key(0);
+
+    for (unsigned int i = 1; i < num_iterators; i++) {
+        max = std::max(max, key(i));
+    }
+
+    // move the iterators round robin to the largest value
+    // seen so far, until all of them agree on one value
+    unsigned int i = 0, num_agreeing = 0;
+
+    while (true) {
+        if (key(i) < max) {
+            positions[i] = gallop(positions[i], ends[i], [&] (unsigned int id) {
+                return iterator_tables[i]->getRow(id)[columns[i]] < max;
+            });
+
+            if (positions[i] == ends[i]) {
+                break;
+            }
+        }
+
+        if (key(i) > max) {
+            max = key(i);
+            num_agreeing = 1;
+        } else if (++num_agreeing == num_iterators) {
+            bool matches = true;
+            slots[plan.levels[level].slot] = max;
+
+            for (unsigned int j = 0; j < num_iterators; j++) {
+                const unsigned int *run_end = gallop(positions[j], ends[j], [&] (unsigned int id) {
+                    return iterator_tables[j]->getRow(id)[columns[j]] == max;
+                });
+
+                auto &range = state.ranges[iterators[j].trie_atom];
+                range = std::make_pair(positions[j], run_end);
+                matches = matches && narrowTrie(plan, iterators[j], max, range);
+
+                positions[j] = run_end;
+            }
+
+            if (matches) {
+                leapfrog(plan, level + 1, state, slots, output);
+            }
+
+            bool done = false;
+
+            for (unsigned int j = 0; j < num_iterators; j++) {
+                done |= positions[j] == ends[j];
+            }
+
+            if (done) {
+                break;
+            }
+
+            max = key(0);
+
+            for (unsigned int j = 1; j < num_iterators; j++) {
+                max = std::max(max, key(j));
+            }
+
+            num_agreeing = 0;
+        }
+
+        i = (i + 1) % num_iterators;
+    }
+
+    // the next value of the previous level starts from the
+    // ranges of the atoms at that level, so restore them
+    for (unsigned int j = 0; j < num_iterators; j++) {
+        state.ranges[iterators[j].trie_atom] = std::make_pair(begins[j], ends[j]);
+    }
+}
+
+bool NativeBackend::narrowTrie(const JoinPlan &plan, const TrieIterator &iterator, Value value,
+                               std::pair<const unsigned int *, const unsigned int *> &range) const {
+    const TrieAtom &trie_atom = plan.trie_atoms[iterator.trie_atom];
+    const Atom &atom = plan.rule->body[trie_atom.atom];
+    const Table &table = *tables[atom.relation];
+
+    for (unsigned int depth = iterator.depth + 1; depth < iterator.depth + iterator.width; depth++) {
+        unsigned int col = trie_atom.order[depth];
+
+        range.first = gallop(range.first, range.second, [&] (unsigned int id) {
+            return table.getRow(id)[col] < value;
+        });
+
+        range.second = gallop(range.first, range.second, [&] (unsigned int id) {
+            return table.getRow(id)[col] == value;
+        });
+    }
+
+    if (range.first == range.second) {
+        return false;
+    }
+
+    // rows of the delta are in the trie too, which are not old
+    if (iterator.depth + iterator.width == atom.args.size() && trie_atom.range == OLD) {
+        return *range.first < delta_begin[atom.relation];
+    }
+
+    return true;
+}
+
+void NativeBackend::emitHead(const JoinPlan &plan, const std::vector<Value> &slots, Buffer &output) const {
+    Value tuple[MAX_ARITY];
+
+    for (unsigned int i: plan.negations) {
+        const Atom &atom = plan.rule->body[i];
+
+        for (unsigned int col = 0; col < atom.args.size(); col++) {
+            tuple[col] = atom.args[col].is_var ? slots[atom.args[col].value] : atom.args[col].value;
+        }
+
+        if (tables[atom.relation]->contains(tuple)) {
+            return;
+        }
+    }
+
+    const Atom &head = plan.rule->head;
+
+    for (unsigned int col = 0; col < head.args.size(); col++) {
+        tuple[col] = head.args[col].is_var ? slots[head.args[col].value] : head.args[col].value;
+    }
+
+    emitTuple(head.relation, tuple, output);
+}
+
+void NativeBackend::emitTuple(unsigned int relation, const Value *tuple, Buffer &output) const {
+    const Table &table = *tables[relation];
+
+    if (table.contains(tuple)) {
+        return;
+    }
+
+    std::vector<Value> &tuples = output.tuples[relation];
+    tuples.insert(tuples.end(), tuple, tuple + std::max(table.getArity(), 1u));
+
+    if (spill_threshold != 0 && tuples.size() >= spill_threshold) {
+        spillTuples(relation, output);
+    }
+}
+
+void NativeBackend::spillTuples(unsigned int relation, Buffer &output) const {
+    std::vector<Value> &tuples = output.tuples[relation];
+    size_t stride = std::max(tables[relation]->getArity(), 1u);
+
+    auto row = [&] (size_t i) { return tuples.data() + i * stride; };
+
+    std::vector<size_t> order(tuples.size() / stride);
+    std::iota(order.begin(), order.end(), 0);
+
+    std::sort(order.begin(), order.end(), [&] (size_t a, size_t b) {
+        return std::lexicographical_compare(row(a), row(a) + stride, row(b), row(b) + stride);
+    });
+
+    output.runs[relation].emplace_back(scratch.get());
+    ScratchArray<Value> &run = output.runs[relation].back();
+    run.reserve(tuples.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        if (i == 0 || !std::equal(row(order[i]), row(order[i]) + stride, row(order[i - 1]))) {
+            run.append(row(order[i]), stride);
+        }
+    }
+
+    tuples.clear();
+}
+
+void NativeBackend::mergeRuns(unsigned int relation) {
+    Table &table = *tables[relation];
+    size_t stride = std::max(table.getArity(), 1u);
+
+    // next tuple of each run
+    std::vector<std::pair<const Value *, const Value *>> cursors;
+
+    for (auto &buffer: derived) {
+        for (auto const &run: buffer.runs[relation]) {
+            cursors.push_back(std::make_pair(run.begin(), run.end()));
+        }
+    }
+
+    auto greater = [&] (unsigned int a, unsigned int b) {
+        return std::lexicographical_compare(cursors[b].first, cursors[b].first + stride,
+                                            cursors[a].first, cursors[a].first + stride);
+    };
+
+    std::priority_queue<unsigned int, std::vector<unsigned int>, decltype(greater)> heap(greater);
+
+    for (unsigned int i = 0; i < cursors.size(); i++) {
+        if (cursors[i].first != cursors[i].second) {
+            heap.push(i);
+        }
+    }
+
+    while (!heap.empty()) {
+        unsigned int i = heap.top();
+        heap.pop();
+
+        // the table drops the duplicates within the merge too
+        table.insert(cursors[i].first);
+        cursors[i].first += stride;
+
+        if (cursors[i].first != cursors[i].second) {
+            heap.push(i);
+        }
+    }
+
+    num_runs += cursors.size();
+
+    for (auto &buffer: derived) {
+        buffer.runs[relation].clear();
+    }
+}
+
+void NativeBackend::runCompiled(const JoinTask &task, Buffer &output) const {
+    const JoinPlan &plan = *task.plan;
+    std::vector<unsigned int> ranges;
+
+    for (auto const &step: plan.steps) {
+        auto range = getRange(plan, step);
+        ranges.push_back(range.first);
+        ranges.push_back(range.second);
+    }
+
+    if (!ranges.empty()) {
+        ranges[0] = std::max(ranges[0], task.begin);
+        ranges[1] = std::min(ranges[1], task.end);
+    }
+
+    plan.compiled(ranges.data(), &output);
+}
+
+bool NativeBackend::commitDerived(const Stratum &stratum) {
+    bool changed = false;
+
+    for (unsigned int relation: stratum.relations) {
+        Table &table = *tables[relation];
+
+        // nullary tuples are buffered as a single dummy value
+        size_t stride = std::max(table.getArity(), 1u);
+
+        delta_begin[relation] = table.size();
+
+        bool spilled = false;
+
+        for (auto &buffer: derived) {
+            spilled |= !buffer.runs[relation].empty();
+        }
+
+        for (auto &buffer: derived) {
+            std::vector<Value> &tuples = buffer.tuples[relation];
+
+            if (spilled) {
+                // the rest become runs too, to merge all tuples in order
+                if (!tuples.empty()) {
+                    spillTuples(relation, buffer);
+                }
+
+                continue;
+            }
+
+            for (size_t i = 0; i < tuples.size(); i += stride) {
+                table.insert(tuples.data() + i);
+            }
+
+            tuples.clear();
+        }
+
+        if (spilled) {
+            mergeRuns(relation);
+        }
+
+        delta_end[relation] = table.size();
+        changed |= delta_end[relation] != delta_begin[relation];
+    }
+
+    return changed;
+}
+
+/**
+ * Updates
+ */
+
+void NativeBackend::addFacts(const StandardDatalog::FormulaVector &facts) {
+    updateFacts(facts, false);
+}
+
+void NativeBackend::retractFacts(const StandardDatalog::FormulaVector &facts) {
+    updateFacts(facts, true);
+}
+
+void NativeBackend::updateFacts(const StandardDatalog::FormulaVector &facts, bool retract) {
+    // tuples of the facts by relation, without duplicates
+    std::vector<std::unique_ptr<Table>> changed_facts(tables.size());
+    std::vector<Value> tuple;
+
+    for (auto const &fact: facts) {
+        assert(fact.isAtom() && !fact.isNegated() && "only facts can be added or retracted");
+
+        auto found = relation_ids.find(fact.getRelationName());
+        assert(found != relation_ids.end() && "relation does not exist");
+
+        tuple.clear();
+
+        for (auto const &term: fact.getArguments()) {
+            assert(!term.isVariable() && "facts must be ground");
+            tuple.push_back(term.getValue());
+        }
+
+        assert(tuple.size() == tables[found->second]->getArity() &&
+               "number of terms does not match the arity");
+
+        getChanges(changed_facts, found->second).insert(tuple.data());
+    }
+
+    added.clear();
+    removed.clear();
+    added.resize(tables.size());
+    removed.resize(tables.size());
+
+    for (auto const &stratum: strata) {
+        updateStratum(stratum, changed_facts, retract);
+    }
+
+    for (unsigned int relation = 0; relation < tables.size(); relation++) {
+        num_inserted += added[relation] ? added[relation]->size() : 0;
+        num_deleted += removed[relation] ? removed[relation]->size() : 0;
+    }
+
+    added.clear();
+    removed.clear();
+    num_updates++;
+}
+
+void NativeBackend::updateStratum(const Stratum &stratum,
+                                  const std::vector<std::unique_ptr<Table>> &facts, bool retract) {
+    // head tuples derived from the changes (or facts added, until
+    // they are inserted), and the changes of the stratum in a round
+    std::vector<std::vector<Value>> heads(tables.size());
+    std::vector<std::vector<Value>> added_facts(tables.size());
+    std::vector<std::unique_ptr<Table>> delta(tables.size());
+    std::vector<std::unique_ptr<Table>> next_delta(tables.size());
+    size_t stratum_size = 0;
+
+    for (unsigned int relation: stratum.relations) {
+        stratum_size += tables[relation]->size();
+    }
+
+    auto add_tuple = [&] (std::vector<Value> &tuples, unsigned int relation, const Value *tuple) {
+        // nullary tuples are buffered as a single dummy value
+        if (tables[relation]->getArity() == 0) {
+            tuples.push_back(0);
+        } else {
+            tuples.insert(tuples.end(), tuple, tuple + tables[relation]->getArity());
+        }
+    };
+
+    auto emit = [&] (const Rule &rule, const std::vector<Value> &slots) {
+        Value tuple[MAX_ARITY];
+
+        for (unsigned int col = 0; col < rule.head.args.size(); col++) {
+            const Argument &arg = rule.head.args[col];
+            tuple[col] = arg.is_var ? slots[arg.value] : arg.value;
+        }
+
+        add_tuple(heads[rule.head.relation], rule.head.relation, tuple);
+    };
+
+    // apply the head tuples to the tables, and move those
+    // changed for the first time to the next delta
+    auto commit = [&] (bool deleting) {
+        bool changed = false;
+
+        for (unsigned int relation: stratum.relations) {
+            Table &table = *tables[relation];
+            std::vector<Value> &tuples = heads[relation];
+            size_t stride = std::max(table.getArity(), 1u);
+
+            for (size_t i = 0; i < tuples.size(); i += stride) {
+                const Value *tuple = tuples.data() + i;
+
+                if (deleting) {
+                    if (!table.erase(tuple)) {
+                        continue;
+                    }
+
+                    getChanges(removed, relation).insert(tuple);
+                } else {
+                    if (!table.insert(tuple)) {
+                        continue;
+                    }
+
+                    // a tuple deleted before is only derived again
+                    if (!removed[relation] || !removed[relation]->erase(tuple)) {
+                        getChanges(added, relation).insert(tuple);
+                    }
+                }
+
+                getChanges(next_delta, relation).insert(tuple);
+                changed = true;
+            }
+
+            tuples.clear();
+        }
+
+        delta.swap(next_delta);
+        next_delta.clear();
+        next_delta.resize(tables.size());
+
+        return changed;
+    };
+
+    // join the rules with the changes of the lower strata: the
+    // tuples removed from (or added to) the positive atoms, and
+    // those added to (or removed from) the negated ones
+    auto join_lower = [&] (State state) {
+        const auto &positive = state == BEFORE ? removed : added;
+        const auto &negative = state == BEFORE ? added : removed;
+
+        for (unsigned int i: stratum.rules) {
+            const Rule &rule = rules[i];
+
+            for (auto const &atom: rule.body) {
+                const Table *changes = (atom.negated ? negative : positive)[atom.relation].get();
+
+                if (!isInStratum(stratum, atom.relation) && changes && changes->size() != 0) {
+                    joinChanges(rule, atom, *changes, state, [&] (const std::vector<Value> &slots) {
+                        emit(rule, slots);
+                        return true;
+                    });
+                }
+            }
+        }
+    };
+
+    // one round of the semi-naive iteration over the changes of the stratum
+    auto join_delta = [&] (State state) {
+        for (unsigned int i: stratum.rules) {
+            const Rule &rule = rules[i];
+
+            for (auto const &atom: rule.body) {
+                const Table *changes = delta[atom.relation].get();
+
+                if (!atom.negated && changes && isInStratum(stratum, atom.relation)) {
+                    joinChanges(rule, atom, *changes, state, [&] (const std::vector<Value> &slots) {
+                        emit(rule, slots);
+                        return true;
+                    });
+                }
+            }
+        }
+    };
+
+    // the facts of the stratum change first, in case it is evaluated again
+    for (unsigned int relation: stratum.relations) {
+        if (!facts[relation]) {
+            continue;
+        }
+
+        Table *fact_table = fact_tables[relation].get();
+
+        for (unsigned int id = 0; id < facts[relation]->size(); id++) {
+            const Value *tuple = facts[relation]->getRow(id);
+
+            if (!retract) {
+                if (!fact_table || fact_table->insert(tuple)) {
+                    add_tuple(added_facts[relation], relation, tuple);
+                }
+            } else if (fact_table ? fact_table->erase(tuple) : tables[relation]->contains(tuple)) {
+                add_tuple(heads[relation], relation, tuple);
+            }
+        }
+    }
+
+    // 1. delete everything derived from the retracted facts and
+    // the changes of the lower strata (in the fixpoint before)
+    join_lower(BEFORE);
+
+    while (commit(true)) {
+        size_t num_removed = 0;
+
+        for (unsigned int relation: stratum.relations) {
+            num_removed += removed[relation] ? removed[relation]->size() : 0;
+        }
+
+        // past a quarter of the stratum, evaluating it again is cheaper
+        // (deleting a tuple, then deriving it again costs more than
+        // deriving it once in a batch)
+        if (!stratum.rules.empty() && 4 * num_removed > stratum_size) {
+            recomputeStratum(stratum);
+            return;
+        }
+
+        join_delta(BEFORE);
+    }
+
+    // 2. derive again the tuples deleted that are still facts or
+    // have a derivation from the rest (in the fixpoint after)
+    for (unsigned int relation: stratum.relations) {
+        // relations without rules only lose the facts retracted
+        if (!removed[relation] || !fact_tables[relation]) {
+            continue;
+        }
+
+        const Table &overdeleted = *removed[relation];
+        const Table &fact_table = *fact_tables[relation];
+
+        num_overdeleted += overdeleted.size();
+
+        for (unsigned int id = 0; id < overdeleted.size(); id++) {
+            const Value *tuple = overdeleted.getRow(id);
+
+            if (fact_table.contains(tuple)) {
+                add_tuple(heads[relation], relation, tuple);
+            }
+        }
+    }
+
+    for (unsigned int i: stratum.rules) {
+        const Rule &rule = rules[i];
+        const Table *overdeleted = removed[rule.head.relation].get();
+
+        if (overdeleted && overdeleted->size() != 0) {
+            // one derivation of each tuple is enough
+            joinChanges(rule, rule.head, *overdeleted, AFTER, [&] (const std::vector<Value> &slots) {
+                emit(rule, slots);
+                return false;
+            });
+        }
+    }
+
+    // 3. insert the facts added, and everything derived from them,
+    // the tuples derived again and the changes of the lower strata
+    for (unsigned int relation: stratum.relations) {
+        heads[relation].insert(heads[relation].end(), added_facts[relation].begin(), added_facts[relation].end());
+    }
+
+    join_lower(AFTER);
+
+    while (commit(false)) {
+        join_delta(AFTER);
+    }
+}
+
+void NativeBackend::recomputeStratum(const Stratum &stratum) {
+    // tables of the stratum so far (without the tuples
+    // removed), replaced by tables of the facts only
+    std::vector<std::unique_ptr<Table>> before(tables.size());
+
+    for (unsigned int relation: stratum.relations) {
+        const Table &fact_table = *fact_tables[relation];
+        std::unique_ptr<Table> table(new Table(fact_table.getArity(), scratch.get()));
+
+        for (auto const &order: index_selection->getOrders(relation_names[relation])) {
+            table->addIndex(order);
+        }
+
+        for (unsigned int id = 0; id < fact_table.size(); id++) {
+            table->insert(fact_table.getRow(id));
+        }
+
+        before[relation] = std::move(tables[relation]);
+        tables[relation] = std::move(table);
+    }
+
+    evaluateStratum(stratum);
+    num_recomputed++;
+
+    // the changes are the difference with the fixpoint before
+    for (unsigned int relation: stratum.relations) {
+        const Table &old_table = *before[relation];
+        const Table &table = *tables[relation];
+        Table &removed_rows = getChanges(removed, relation);
+        size_t stride = std::max(table.getArity(), 1u);
+        std::vector<Value> kept;
+
+        for (unsigned int id = 0; id < table.size(); id++) {
+            const Value *row = table.getRow(id);
+
+            if (!old_table.contains(row) && !removed_rows.contains(row)) {
+                getChanges(added, relation).insert(row);
+            }
+        }
+
+        for (unsigned int id = 0; id < removed_rows.size(); id++) {
+            const Value *row = removed_rows.getRow(id);
+
+            if (table.contains(row)) {
+                kept.insert(kept.end(), row, row + table.getArity());
+                kept.resize(kept.size() + stride - table.getArity());
+            }
+        }
+
+        for (size_t i = 0; i < kept.size(); i += stride) {
+            removed_rows.erase(kept.data() + i);
+        }
+
+        for (unsigned int id = 0; id < old_table.size(); id++) {
+            const Value *row = old_table.getRow(id);
+
+            if (!table.contains(row)) {
+                removed_rows.insert(row);
+            }
+        }
+    }
+}
+
+NativeBackend::Table &NativeBackend::getChanges(std::vector<std::unique_ptr<Table>> &changes,
+                                                unsigned int relation) const {
+    if (!changes[relation]) {
+        changes[relation].reset(new Table(tables[relation]->getArity()));
+    }
+
+    return *changes[relation];
+}
+
+bool NativeBackend::holds(unsigned int relation, const Value *tuple, State state) const {
+    const Table &table = *tables[relation];
+
+    if (state == AFTER) {
+        return table.contains(tuple);
+    }
+
+    const Table *added_rows = added[relation].get();
+    const Table *removed_rows = removed[relation].get();
+
+    return (table.contains(tuple) && !(added_rows && added_rows->contains(tuple))) ||
+           (removed_rows && removed_rows->contains(tuple));
+}
+
+template<typename Function>
+void NativeBackend::joinChanges(const Rule &rule, const Atom &bound_atom, const Table &changes,
+                                State state, Function function) {
+    std::vector<bool> bound(rule.num_vars, false);
+    JoinStep first = planStep(bound_atom, bound);
+
+    // join the atom with the most columns bound next, looking it up in
+    // an index on those columns (built on first use, as the updates do
+    // not follow the access patterns of the evaluation)
+    std::vector<ChangeStep> steps;
+    std::vector<bool> joined(rule.body.size(), false);
+
+    for (;;) {
+        int next = -1;
+        unsigned int max_bound = 0;
+
+        for (unsigned int i = 0; i < rule.body.size(); i++) {
+            const Atom &atom = rule.body[i];
+            unsigned int num_bound = 0;
+
+            if (atom.negated || joined[i] || &atom == &bound_atom) {
+                continue;
+            }
+
+            for (auto const &arg: atom.args) {
+                num_bound += !arg.is_var || bound[arg.value];
+            }
+
+            if (next == -1 || num_bound > max_bound) {
+                next = i;
+                max_bound = num_bound;
+            }
+        }
+
+        if (next == -1) {
+            break;
+        }
+
+        const Atom &atom = rule.body[next];
+        Table &table = *tables[atom.relation];
+        Table *removed_rows = state == BEFORE ? removed[atom.relation].get() : NULL;
+        ChangeStep step(planStep(atom, bound));
+
+        joined[next] = true;
+        step.atom = next;
+
+        if (step.mask != 0) {
+            step.index = table.getIndex(step.mask);
+            table.updateIndex(step.index);
+
+            const IndexSelection::Order &order = table.getIndexOrder(step.index);
+
+            for (unsigned int i = 0; i < (unsigned int)__builtin_popcount(step.mask); i++) {
+                step.key.push_back(atom.args[order[i]]);
+            }
+
+            // the same order, so that the key is the same
+            if (removed_rows) {
+                step.removed_index = removed_rows->getIndex(order);
+                removed_rows->updateIndex(step.removed_index);
+            }
+        }
+
+        steps.push_back(step);
+    }
+
+    std::vector<unsigned int> negations;
+
+    for (unsigned int i = 0; i < rule.body.size(); i++) {
+        if (rule.body[i].negated && &rule.body[i] != &bound_atom) {
+            negations.push_back(i);
+        }
+    }
+
+    std::vector<Value> slots(rule.num_vars);
+
+    for (unsigned int id = 0; id < changes.size(); id++) {
+        const Value *row = changes.getRow(id);
+        bool matched = true;
+
+        // the bound columns of the first atom are its constants
+        for (unsigned int col = 0; col < bound_atom.args.size(); col++) {
+            matched &= !(first.mask & (1u << col)) || row[col] == bound_atom.args[col].value;
+        }
+
+        for (auto const &bind: first.binds) {
+            slots[bind.second] = row[bind.first];
+        }
+
+        for (auto const &check: first.checks) {
+            matched &= row[check.first] == slots[check.second];
+        }
+
+        if (matched) {
+            joinChanges(rule, steps, 0, negations, state, slots, function);
+        }
+    }
+}
+
+template<typename Function>
+bool NativeBackend::joinChanges(const Rule &rule, const std::vector<ChangeStep> &steps, unsigned int step_index,
+                                const std::vector<unsigned int> &negations, State state,
+                                std::vector<Value> &slots, Function &function) const {
+    Value tuple[MAX_ARITY];
+
+    if (step_index == steps.size()) {
+        for (unsigned int i: negations) {
+            const Atom &atom = rule.body[i];
+
+            for (unsigned int col = 0; col < atom.args.size(); col++) {
+                tuple[col] = atom.args[col].is_var ? slots[atom.args[col].value] : atom.args[col].value;
+            }
+
+            if (holds(atom.relation, tuple, state)) {
+                return true;
+            }
+        }
+
+        return function(slots);
+    }
+
+    const ChangeStep &step = steps[step_index];
+    unsigned int relation = rule.body[step.atom].relation;
+
+    for (unsigned int i = 0; i < step.key.size(); i++) {
+        tuple[i] = step.key[i].is_var ? slots[step.key[i].value] : step.key[i].value;
+    }
+
+    // the rows of a table matching the step, but the excluded ones
+    auto visit_rows = [&] (const Table &table, unsigned int index, const Table *excluded) {
+        auto visit_row = [&] (unsigned int id) {
+            const Value *row = table.getRow(id);
+
+            if (excluded && excluded->contains(row)) {
+                return true;
+            }
+
+            for (auto const &bind: step.binds) {
+                slots[bind.second] = row[bind.first];
+            }
+
+            for (auto const &check: step.checks) {
+                if (row[check.first] != slots[check.second]) {
+                    return true;
+                }
+            }
+
+            return joinChanges(rule, steps, step_index + 1, negations, state, slots, function);
+        };
+
+        if (step.mask == 0) {
+            for (unsigned int id = 0; id < table.size(); id++) {
+                if (!visit_row(id)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        auto candidates = table.lookup(index, step.key.size(), tuple);
+
+        for (const unsigned int *id = candidates.first; id != candidates.second; id++) {
+            if (!visit_row(*id)) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    // the fixpoint after the update is in the tables, while the one
+    // before lacks the tuples added and has those removed in addition
+    if (state == AFTER) {
+        return visit_rows(*tables[relation], step.index, NULL);
+    }
+
+    if (!visit_rows(*tables[relation], step.index, added[relation].get())) {
+        return false;
+    }
+
+    return !removed[relation] || visit_rows(*removed[relation], step.removed_index, NULL);
+}
+
+/**
+ * Queries
+ */
+
+void NativeBackend::printStatistics(llvm::raw_ostream &out) const {
+    out << "leapfrog triejoin: " << num_leapfrog_rules << " of " << rules.size() << " rules\n";
+
+    if (scratch) {
+        out << "scratch storage: " << llvm::format("%.1f", scratch->getPeakMappedBytes() / 1048576.0)
+            << " MB mapped at most, in " << scratch->getNumFiles() << " files"
+            << " (" << num_runs << " sorted runs)\n";
+    }
+
+    if (num_updates != 0) {
+        out << "incremental updates: " << num_updates << " (" << num_inserted << " tuples inserted, "
+            << num_deleted << " deleted, " << num_overdeleted << " overdeleted, "
+            << num_recomputed << " strata evaluated again)\n";
+    }
+
+#ifdef DATALOG_AA_JIT
+    if (jit) {
+        out << "jit compilation: " << llvm::format("%.3f", jit->getCompileTime()) << "s"
+            << " (" << jit->getNumPlans() << " plans)\n";
+    }
+#endif
+}
+
+bool NativeBackend::query(const StandardDatalog::Formula &formula) {
+    auto found = relation_ids.find(formula.getRelationName());
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    std::vector<Value> tuple;
+
+    for (auto const &term: formula.getArguments()) {
+        assert(!term.isVariable() && "query must be ground");
+        tuple.push_back(term.getValue());
+    }
+
+    return tables[found->second]->contains(tuple.data()) != formula.isNegated();
+}
+
+StandardDatalog::FormulaVector NativeBackend::query(const Symbol &relation_name) {
+    auto found = relation_ids.find(relation_name);
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    unsigned int arity = tables[found->second]->getArity();
+    StandardDatalog::FormulaVector facts;
+
+    forEachTuple(relation_name, [&] (const Value *row) {
+        facts.push_back(StandardDatalog::Formula(relation_name, StandardDatalog::TermVector(row, row + arity)));
+    });
+
+    return facts;
+}
+
+void NativeBackend::forEachTuple(const Symbol &relation_name,
+                                 const std::function<void (const Value *)> &visitor) {
+    auto found = relation_ids.find(relation_name);
+    assert(found != relation_ids.end() && "relation does not exist");
+
+    const Table &table = *tables[found->second];
+
+    for (unsigned int id = 0; id < table.size(); id++) {
+        visitor(table.getRow(id));
+    }
+}
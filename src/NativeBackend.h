@@ -0,0 +1,563 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "DatalogIR.h"
+#include "IndexSelection.h"
+#include "ScratchStorage.h"
+#include "WorkStealingPool.h"
+
+class NativeJIT;
+
+/**
+ * An in-house bottom-up evaluator for stratified programs
+ *
+ * Relations are evaluated stratum by stratum (SCCs of the
+ * relation dependency graph in topological order), using
+ * semi-naive iteration within each stratum. Negated atoms
+ * must refer to relations in a strictly lower stratum
+ *
+ * Within an iteration, the rules (and partitions of the row
+ * range each rule scans first) run as tasks on a work-stealing
+ * pool. Each worker buffers derived tuples locally, and the
+ * buffers are merged into the tables at the end of the iteration
+ *
+ * With DATALOG_AA_JIT, the join plans can also be compiled to
+ * machine code with ORC (see NativeJIT.h)
+ *
+ * Rules are joined one atom at a time, looking up each atom in an
+ * index on the columns bound so far. That may build intermediate
+ * results far larger than the output when several atoms share a
+ * variable, so bodies of three or more atoms that are cyclic (or have
+ * a variable in three or more atoms) are joined by leapfrog triejoin
+ * instead: variable by variable, intersecting the sorted values of
+ * that variable in all the atoms containing it
+ *
+ * With a memory limit, the rows, hash sets and tries of the tables
+ * move to memory-mapped scratch files once the limit is reached (see
+ * ScratchStorage.h), and the tuples derived by each worker are spilled
+ * as sorted runs, which are merged into the tables at the end of the
+ * iteration
+ *
+ * Facts can be added and retracted after loading: the fixpoint is
+ * maintained from the changes, by semi-naive evaluation for the tuples
+ * added and delete and rederive (DRed) for those removed
+ */
+class NativeBackend: public StandardDatalog::Backend {
+    friend class NativeJIT;
+
+public:
+    using Value = unsigned int;
+
+    /**
+     * How the positive atoms of a rule are joined
+     */
+    enum JoinStrategy {
+        BinaryJoin, // one atom at a time
+        LeapfrogJoin, // leapfrog triejoin for all bodies of three or more atoms
+        AutoJoin, // leapfrog triejoin for those that are cyclic or share a variable
+    };
+
+    /**
+     * A table stores the tuples of a relation row by row
+     * in a flat vector. Rows are never removed during an
+     * evaluation, so the rows added in the last iteration
+     * (the delta) always form a suffix of the table
+     */
+    class Table {
+        unsigned int arity;
+        unsigned int num_rows = 0;
+        ScratchSpace *scratch;
+        ScratchArray<Value> rows;
+
+        // open addressing hash set of row ids
+        // used for duplicate suppression
+        ScratchArray<unsigned int> slots;
+
+        // row ids sorted by the columns of an order, so that the
+        // rows matching the values of any prefix of the order form
+        // a contiguous range. Since every prefix looked up includes
+        // the first column, the ids are bucketed by its value and
+        // only sorted within a bucket
+        struct Index {
+            IndexSelection::Order order;
+            std::unordered_map<Value, std::vector<unsigned int>> buckets;
+            unsigned int indexed_rows = 0;
+        };
+
+        std::vector<Index> indices;
+
+        // row ids sorted by all columns of an order, as a trie
+        // for leapfrog triejoin (which needs the values of the
+        // first column in order too, unlike an index)
+        struct Trie {
+            IndexSelection::Order order;
+            ScratchArray<unsigned int> ids;
+            unsigned int indexed_rows = 0;
+
+            Trie(const IndexSelection::Order &order, ScratchSpace *scratch):
+                order(order), ids(scratch) {}
+        };
+
+        std::vector<Trie> tries;
+
+    public:
+        static const unsigned int EMPTY_SLOT = ~0u;
+
+        /**
+         * Without a scratch space, the table is always on the heap
+         */
+        Table(unsigned int arity, ScratchSpace *scratch = NULL):
+            arity(arity), scratch(scratch), rows(scratch), slots(scratch) {}
+
+        unsigned int getArity() const { return arity; }
+        unsigned int size() const { return num_rows; }
+
+        const Value *getRow(unsigned int id) const {
+            assert(id < num_rows && "row out of range");
+            return rows.data() + (size_t)id * arity;
+        }
+
+        bool contains(const Value *tuple) const;
+
+        /**
+         * Returns false if the tuple already exists
+         */
+        bool insert(const Value *tuple);
+
+        /**
+         * Remove a tuple, moving the last row in its place. Returns
+         * false if the tuple does not exist. The indices are kept up
+         * to date, while the tries are built again on their next update
+         */
+        bool erase(const Value *tuple);
+
+        void addIndex(const IndexSelection::Order &order);
+
+        /**
+         * Index whose order starts with the columns of a mask, added on first use
+         */
+        unsigned int getIndex(unsigned int mask);
+
+        /**
+         * Index of exactly an order, added on first use
+         */
+        unsigned int getIndex(const IndexSelection::Order &order);
+
+        const IndexSelection::Order &getIndexOrder(unsigned int index) const {
+            return indices[index].order;
+        }
+
+        /**
+         * Merge the rows added since the last update into the index
+         */
+        void updateIndex(unsigned int index);
+
+        /**
+         * Ids of the rows whose first prefix_length columns in the
+         * order of the index equal the key (given in that order).
+         * The index must be up to date
+         */
+        std::pair<const unsigned int *, const unsigned int *>
+        lookup(unsigned int index, unsigned int prefix_length, const Value *key) const;
+
+        /**
+         * Trie of an order of the columns, added on first use
+         */
+        unsigned int getTrie(const IndexSelection::Order &order);
+
+        /**
+         * Merge the rows added since the last update into the trie
+         */
+        void updateTrie(unsigned int trie);
+
+        const ScratchArray<unsigned int> &getTrieRows(unsigned int trie) const {
+            assert(tries[trie].indexed_rows == num_rows && "trie is out of date");
+            return tries[trie].ids;
+        }
+
+        /**
+         * Sort row ids by the columns of an order
+         */
+        void sortRows(const IndexSelection::Order &order, unsigned int *first, unsigned int *last) const;
+
+        static uint64_t hash(const Value *values, unsigned int length);
+
+    private:
+        unsigned int findSlot(const Value *tuple, uint64_t hash_value) const;
+        void growSlots();
+
+        /**
+         * Position of a row in the bucket of an index (which is up to date)
+         */
+        unsigned int *findInIndex(Index &entry, unsigned int id);
+    };
+
+protected:
+    /**
+     * An argument of a compiled atom is either
+     * a variable slot in the rule or a constant
+     */
+    struct Argument {
+        bool is_var;
+        unsigned int value; // slot index or constant
+    };
+
+    struct Atom {
+        unsigned int relation;
+        std::vector<Argument> args;
+        bool negated;
+    };
+
+    struct Rule {
+        Atom head;
+        std::vector<Atom> body;
+        unsigned int num_vars;
+    };
+
+    /**
+     * Row range of a table an atom is joined against
+     */
+    enum Range {
+        FULL,  // every row
+        OLD,   // rows before the current delta
+        DELTA, // rows added in the last iteration
+    };
+
+    /**
+     * One positive body atom in a join, with
+     * the bookkeeping precomputed at load time
+     */
+    struct JoinStep {
+        unsigned int atom;
+        unsigned int mask; // columns bound before this step
+        unsigned int index; // index of the table serving the mask, if any
+        std::vector<Argument> key; // arguments of the bound columns, in the order of the index
+        std::vector<std::pair<unsigned int, unsigned int>> binds; // (column, slot) bound by this step
+        std::vector<std::pair<unsigned int, unsigned int>> checks; // (column, slot) repeated in this atom
+        Range range;
+    };
+
+    /**
+     * A positive body atom in a leapfrog triejoin, whose rows are
+     * sorted by its constant columns first, then by the columns of
+     * its variables in the order they are joined
+     */
+    struct TrieAtom {
+        unsigned int atom;
+        IndexSelection::Order order;
+        unsigned int num_constants;
+        unsigned int trie; // of the table, unless the range is the delta
+        Range range;
+    };
+
+    /**
+     * An atom taking part in the intersection for a variable, at the
+     * depth of its trie the columns of the variable start at (there
+     * are several if the variable is repeated in the atom)
+     */
+    struct TrieIterator {
+        unsigned int trie_atom;
+        unsigned int depth;
+        unsigned int width;
+    };
+
+    struct TrieLevel {
+        unsigned int slot; // variable bound at this level
+        std::vector<TrieIterator> iterators;
+    };
+
+    /**
+     * Tuples derived by a worker in the current iteration, flat
+     * for each relation. Under a memory limit, they are sorted
+     * and moved to a run when there are too many
+     */
+    struct Buffer {
+        std::vector<std::vector<Value>> tuples;
+        std::vector<std::vector<ScratchArray<Value>>> runs;
+
+        Buffer(unsigned int num_relations): tuples(num_relations), runs(num_relations) {}
+    };
+
+    /**
+     * A JIT-compiled plan, taking the row range of each
+     * step ([begin, end) pairs) and the output buffer
+     */
+    using CompiledPlan = void (*)(const unsigned int *ranges, Buffer *output);
+
+    struct JoinPlan {
+        const Rule *rule;
+        std::vector<JoinStep> steps;
+        std::vector<unsigned int> negations; // negated body atoms
+        CompiledPlan compiled = NULL;
+
+        // for leapfrog triejoin, instead of the steps
+        bool leapfrog = false;
+        std::vector<TrieAtom> trie_atoms;
+        std::vector<TrieLevel> levels;
+    };
+
+    /**
+     * Row ids each trie atom of a leapfrog
+     * triejoin is currently restricted to
+     */
+    struct TrieRanges {
+        std::vector<std::vector<unsigned int>> delta_ids; // sorted rows of the delta atoms
+        std::vector<std::pair<const unsigned int *, const unsigned int *>> ranges;
+    };
+
+    /**
+     * A unit of work: a plan with the rows
+     * of its first step limited to [begin, end)
+     */
+    struct JoinTask {
+        const JoinPlan *plan;
+        unsigned int begin;
+        unsigned int end;
+    };
+
+    struct Stratum {
+        std::vector<unsigned int> relations;
+        std::vector<unsigned int> rules;
+        bool recursive;
+    };
+
+    // only with a memory limit (declared before
+    // the tables, which must be destroyed first)
+    std::unique_ptr<ScratchSpace> scratch;
+    size_t spill_threshold = 0; // values buffered for a relation before spilling them
+    unsigned int num_runs = 0;
+
+    std::map<std::string, unsigned int> relation_ids;
+    std::vector<std::string> relation_names;
+    std::vector<std::unique_ptr<Table>> tables;
+
+    std::vector<Rule> rules;
+    std::vector<Stratum> strata;
+
+    std::unique_ptr<IndexSelection> index_selection;
+
+    JoinStrategy join_strategy;
+    unsigned int num_leapfrog_rules = 0;
+
+    // delta of the relations in the current stratum
+    std::vector<unsigned int> delta_begin;
+    std::vector<unsigned int> delta_end;
+
+    // tuples derived in the current iteration, one buffer per worker
+    std::vector<Buffer> derived;
+
+    std::unique_ptr<WorkStealingPool> pool;
+
+    // facts of the relations with rules (NULL for the others,
+    // whose tables hold facts only), which stay in the
+    // relations when their derivations are removed
+    std::vector<std::unique_ptr<Table>> fact_tables;
+
+    // tuples added to and removed from each relation by the current
+    // update (NULL if none). The tables are always up to date, and the
+    // fixpoint before the update is read from them and these changes
+    std::vector<std::unique_ptr<Table>> added;
+    std::vector<std::unique_ptr<Table>> removed;
+
+    unsigned int num_updates = 0;
+    size_t num_inserted = 0;
+    size_t num_deleted = 0;
+    size_t num_overdeleted = 0;
+    unsigned int num_recomputed = 0;
+
+#ifdef DATALOG_AA_JIT
+    std::unique_ptr<NativeJIT> jit;
+#endif
+
+public:
+    /**
+     * A memory limit (in bytes, 0 for none) bounds the storage of the
+     * tables on the heap, past which scratch files are created in the
+     * given directory ($TMPDIR by default)
+     */
+    NativeBackend(unsigned int num_threads = 1, bool use_jit = false, JoinStrategy join_strategy = AutoJoin,
+                  size_t memory_limit = 0, const std::string &scratch_directory = "");
+    virtual ~NativeBackend();
+
+    virtual void load(const StandardDatalog::Program &program) override;
+    virtual bool query(const StandardDatalog::Formula &formula) override;
+    virtual StandardDatalog::FormulaVector query(const Symbol &relation_name) override;
+    virtual void forEachTuple(const Symbol &relation_name,
+                              const std::function<void (const Value *)> &visitor) override;
+
+    virtual bool isIncremental() const override { return true; }
+    virtual void addFacts(const StandardDatalog::FormulaVector &facts) override;
+    virtual void retractFacts(const StandardDatalog::FormulaVector &facts) override;
+
+    virtual void printStatistics(llvm::raw_ostream &out) const override;
+
+protected:
+    /**
+     * Create the tables of the relations with their indices, insert the
+     * facts and compile and stratify the rules, without evaluating them
+     */
+    void compileProgram(const StandardDatalog::Program &program);
+
+    void compileRule(const StandardDatalog::Formula &formula);
+    Atom compileAtom(std::map<std::string, unsigned int> &var_slots,
+                     const StandardDatalog::Formula &atom);
+
+    /**
+     * Columns of an atom bound by the variables bound so far or
+     * constants, and the variables it binds (marked as bound)
+     */
+    JoinStep planStep(const Atom &atom, std::vector<bool> &bound) const;
+
+    /**
+     * Group the compiled rules by the strata of the program
+     */
+    void stratify(const StandardDatalog::Program &program);
+
+    /**
+     * Plan the join of a rule, where the body atom at
+     * delta_atom (if any) only ranges over the delta
+     */
+    JoinPlan planRule(const Rule &rule, const Stratum &stratum, int delta_atom);
+
+    /**
+     * Row range of a body atom when the atom at delta_atom ranges over the delta
+     */
+    Range getAtomRange(const Rule &rule, const Stratum &stratum, unsigned int atom, int delta_atom) const;
+
+    /**
+     * If a rule is joined by leapfrog triejoin under the join strategy
+     */
+    bool isLeapfrogRule(const Rule &rule) const;
+
+    /**
+     * Plan a leapfrog triejoin, binding the variables in the order they
+     * appear in the body (with the delta atom first) and sorting the
+     * rows of each atom by its columns in that order
+     */
+    void planLeapfrog(const Rule &rule, const Stratum &stratum, int delta_atom, JoinPlan &plan);
+
+    void evaluateStratum(const Stratum &stratum);
+
+    /**
+     * Evaluate plans in parallel, filling the buffers in derived
+     */
+    void evaluatePlans(const std::vector<JoinPlan> &plans);
+
+    /**
+     * Row range a join step ranges over
+     */
+    std::pair<unsigned int, unsigned int> getRange(const JoinPlan &plan, const JoinStep &step) const;
+
+    void join(const JoinTask &task, unsigned int step,
+              std::vector<Value> &slots, Buffer &output) const;
+    void leapfrogJoin(const JoinPlan &plan, Buffer &output) const;
+
+    /**
+     * Bind the variable of a level to each value in the intersection
+     * of its iterators, narrowing their ranges for the next levels
+     */
+    void leapfrog(const JoinPlan &plan, unsigned int level, TrieRanges &state,
+                  std::vector<Value> &slots, Buffer &output) const;
+
+    /**
+     * Narrow the range of a trie atom, already matching the value in the
+     * first column of an iterator, to its other columns (if repeated).
+     * Returns false if no row is left, or if the atom is fully bound
+     * and its row is not in the row range of the atom
+     */
+    bool narrowTrie(const JoinPlan &plan, const TrieIterator &iterator, Value value,
+                    std::pair<const unsigned int *, const unsigned int *> &range) const;
+
+    void emitHead(const JoinPlan &plan, const std::vector<Value> &slots, Buffer &output) const;
+
+    /**
+     * Buffer a derived tuple unless it's already in the table
+     */
+    void emitTuple(unsigned int relation, const Value *tuple, Buffer &output) const;
+
+    void runCompiled(const JoinTask &task, Buffer &output) const;
+
+    /**
+     * Sort the buffered tuples of a relation and move them to a new run
+     */
+    void spillTuples(unsigned int relation, Buffer &output) const;
+
+    /**
+     * Insert the tuples of all runs of a relation in the table, in
+     * order, by a k-way merge (which also drops duplicates across runs)
+     */
+    void mergeRuns(unsigned int relation);
+
+    /**
+     * Insert all derived tuples in the relations of the
+     * stratum and advance the deltas. Returns false if
+     * nothing new is derived
+     */
+    bool commitDerived(const Stratum &stratum);
+
+    bool isInStratum(const Stratum &stratum, unsigned int relation) const;
+
+    /**
+     * Fixpoint before or after the current update
+     */
+    enum State {
+        BEFORE, // the tables without the added tuples, with the removed ones
+        AFTER,  // the tables
+    };
+
+    /**
+     * Maintain the fixpoint after adding or retracting facts, by delete
+     * and rederive (DRed) stratum by stratum: the tuples with a derivation
+     * using a removed tuple are deleted, those still derivable from the
+     * rest are derived again, and the consequences of the tuples added
+     * are derived semi-naively, all starting from the changes only. A
+     * stratum losing more than a quarter of its tuples on the way is evaluated
+     * again instead, as in cyclic programs most of it is often deleted
+     */
+    void updateFacts(const StandardDatalog::FormulaVector &facts, bool retract);
+
+    void updateStratum(const Stratum &stratum, const std::vector<std::unique_ptr<Table>> &facts, bool retract);
+
+    /**
+     * Evaluate a stratum again from its facts, and record
+     * the difference with its tables as its changes
+     */
+    void recomputeStratum(const Stratum &stratum);
+
+    /**
+     * Table of the changes of a relation, created on first use
+     */
+    Table &getChanges(std::vector<std::unique_ptr<Table>> &changes, unsigned int relation) const;
+
+    bool holds(unsigned int relation, const Value *tuple, State state) const;
+
+    /**
+     * A join step of an update, which in the fixpoint before the
+     * update also looks up the tuples removed, in an index of the
+     * same order as the one of the table
+     */
+    struct ChangeStep: JoinStep {
+        unsigned int removed_index = 0;
+
+        ChangeStep(const JoinStep &step): JoinStep(step) {}
+    };
+
+    /**
+     * Join the body of a rule with the variables of one of its atoms (or
+     * its head) bound to each row of a table of changes, and the other
+     * atoms against the tables in a state. The function is called on each
+     * binding, and returns false to go on to the next row of the changes
+     */
+    template<typename Function>
+    void joinChanges(const Rule &rule, const Atom &bound_atom, const Table &changes,
+                     State state, Function function);
+
+    template<typename Function>
+    bool joinChanges(const Rule &rule, const std::vector<ChangeStep> &steps, unsigned int step_index,
+                     const std::vector<unsigned int> &negations, State state,
+                     std::vector<Value> &slots, Function &function) const;
+};
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Pass.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Utils.h"
+
+#include "NativeJIT.h"
+
+#define MAX_ARITY 32
+
+using namespace llvm;
+
+template<typename T>
+static T unwrap(Expected<T> value) {
+    if (!value) {
+        errs() << "jit error: " << toString(value.takeError()) << "\n";
+        assert(0);
+    }
+
+    return std::move(*value);
+}
+
+/**
+ * Helpers
+ */
+
+const NativeBackend::Value *NativeJIT::getRows(const NativeBackend::Table *table) {
+    return table->size() ? table->getRow(0) : NULL;
+}
+
+const unsigned int *NativeJIT::lookup(const NativeBackend::Table *table, unsigned int index,
+                                      unsigned int prefix_length, const NativeBackend::Value *key,
+                                      unsigned int *count) {
+    auto candidates = table->lookup(index, prefix_length, key);
+
+    *count = candidates.second - candidates.first;
+    return candidates.first;
+}
+
+unsigned int NativeJIT::contains(const NativeBackend::Table *table, const NativeBackend::Value *tuple) {
+    return table->contains(tuple);
+}
+
+void NativeJIT::emit(const NativeBackend *backend, unsigned int relation,
+                     const NativeBackend::Value *tuple, NativeBackend::Buffer *output) {
+    backend->emitTuple(relation, tuple, *output);
+}
+
+/**
+ * Compilation
+ */
+
+NativeJIT::NativeJIT(): context(std::unique_ptr<LLVMContext>(new LLVMContext())) {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    orc::JITTargetMachineBuilder builder = unwrap(orc::JITTargetMachineBuilder::detectHost());
+    std::unique_ptr<TargetMachine> target_machine = unwrap(builder.createTargetMachine());
+
+    jit = unwrap(orc::LLJIT::Create(std::move(builder), target_machine->createDataLayout()));
+}
+
+void NativeJIT::compile(const NativeBackend &backend, std::vector<NativeBackend::JoinPlan> &plans) {
+    // leapfrog triejoins are always interpreted
+    std::vector<NativeBackend::JoinPlan *> binary_plans;
+
+    for (auto &plan: plans) {
+        if (!plan.leapfrog) {
+            binary_plans.push_back(&plan);
+        }
+    }
+
+    if (binary_plans.empty()) {
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+
+    std::unique_ptr<Module> module(new Module("plans", *context.getContext()));
+    module->setDataLayout(jit->getDataLayout());
+
+    legacy::FunctionPassManager passes(module.get());
+    passes.add(createPromoteMemoryToRegisterPass());
+    passes.add(createInstructionCombiningPass());
+    passes.add(createCFGSimplificationPass());
+    passes.add(createLICMPass());
+    passes.add(createGVNPass());
+    passes.add(createCFGSimplificationPass());
+    passes.doInitialization();
+
+    std::vector<std::string> names;
+
+    for (auto const *plan: binary_plans) {
+        Function *function = emitPlan(*module, backend, *plan);
+        assert(!verifyFunction(*function, &errs()) && "invalid plan function");
+
+        passes.run(*function);
+        names.push_back(function->getName().str());
+    }
+
+    passes.doFinalization();
+
+    if (Error error = jit->addIRModule(orc::ThreadSafeModule(std::move(module), context))) {
+        errs() << "jit error: " << toString(std::move(error)) << "\n";
+        assert(0);
+    }
+
+    for (unsigned int i = 0; i < binary_plans.size(); i++) {
+        JITEvaluatedSymbol symbol = unwrap(jit->lookup(names[i]));
+        binary_plans[i]->compiled = (NativeBackend::CompiledPlan)symbol.getAddress();
+    }
+
+    compile_time += std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+Function *NativeJIT::emitPlan(Module &module, const NativeBackend &backend,
+                              const NativeBackend::JoinPlan &plan) {
+    LLVMContext &ctx = module.getContext();
+
+    Type *void_type = Type::getVoidTy(ctx);
+    IntegerType *int_type = Type::getInt32Ty(ctx);
+    IntegerType *int64_type = Type::getInt64Ty(ctx);
+    PointerType *int_ptr_type = Type::getInt32PtrTy(ctx);
+    PointerType *opaque_ptr_type = Type::getInt8PtrTy(ctx);
+
+    FunctionType *plan_type = FunctionType::get(void_type, { int_ptr_type, opaque_ptr_type }, false);
+    FunctionType *get_rows_type = FunctionType::get(int_ptr_type, { opaque_ptr_type }, false);
+    FunctionType *lookup_type = FunctionType::get(int_ptr_type, {
+        opaque_ptr_type, int_type, int_type, int_ptr_type, int_ptr_type
+    }, false);
+    FunctionType *contains_type = FunctionType::get(int_type, { opaque_ptr_type, int_ptr_type }, false);
+    FunctionType *emit_type = FunctionType::get(void_type, {
+        opaque_ptr_type, int_type, int_ptr_type, opaque_ptr_type
+    }, false);
+
+    // tables, helpers and the backend are referred to by their addresses
+    auto get_pointer = [&] (const void *pointer, Type *type) {
+        return ConstantExpr::getIntToPtr(ConstantInt::get(int64_type, (uint64_t)pointer), type);
+    };
+
+    auto get_table = [&] (unsigned int relation) {
+        return get_pointer(backend.tables[relation].get(), opaque_ptr_type);
+    };
+
+    Constant *get_rows = get_pointer((const void *)&NativeJIT::getRows, get_rows_type->getPointerTo());
+    Constant *lookup = get_pointer((const void *)&NativeJIT::lookup, lookup_type->getPointerTo());
+    Constant *contains = get_pointer((const void *)&NativeJIT::contains, contains_type->getPointerTo());
+    Constant *emit = get_pointer((const void *)&NativeJIT::emit, emit_type->getPointerTo());
+
+    Function *function = Function::Create(plan_type, Function::ExternalLinkage,
+                                          "plan" + std::to_string(num_plans++), &module);
+
+    auto args = function->arg_begin();
+    llvm::Value *ranges = &*args++;
+    llvm::Value *output = &*args++;
+
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", function);
+    BasicBlock *exit = BasicBlock::Create(ctx, "exit", function);
+
+    IRBuilder<> builder(entry);
+
+    auto get_int = [&] (unsigned int value) {
+        return ConstantInt::get(int_type, value);
+    };
+
+    // one variable per slot so that they can all be promoted to registers
+    std::vector<AllocaInst *> slots;
+
+    for (unsigned int i = 0; i < plan.rule->num_vars; i++) {
+        slots.push_back(builder.CreateAlloca(int_type));
+    }
+
+    AllocaInst *key = builder.CreateAlloca(int_type, get_int(MAX_ARITY));
+    AllocaInst *tuple = builder.CreateAlloca(int_type, get_int(MAX_ARITY));
+    AllocaInst *count = builder.CreateAlloca(int_type);
+
+    auto get_argument = [&] (const NativeBackend::Argument &arg) -> llvm::Value * {
+        if (arg.is_var) {
+            return builder.CreateLoad(int_type, slots[arg.value]);
+        }
+
+        return get_int(arg.value);
+    };
+
+    auto store_tuple = [&] (const NativeBackend::Atom &atom) {
+        for (unsigned int col = 0; col < atom.args.size(); col++) {
+            builder.CreateStore(get_argument(atom.args[col]),
+                                builder.CreateGEP(int_type, tuple, get_int(col)));
+        }
+    };
+
+    // continue with the next candidate of the
+    // innermost loop if the condition fails
+    BasicBlock *next = exit;
+
+    auto require = [&] (llvm::Value *condition) {
+        BasicBlock *pass = BasicBlock::Create(ctx, "", function);
+        builder.CreateCondBr(condition, pass, next);
+        builder.SetInsertPoint(pass);
+    };
+
+    for (unsigned int k = 0; k < plan.steps.size(); k++) {
+        const NativeBackend::JoinStep &step = plan.steps[k];
+        unsigned int relation = plan.rule->body[step.atom].relation;
+        unsigned int arity = backend.tables[relation]->getArity();
+
+        // tables are not modified during the evaluation of a plan
+        IRBuilder<> entry_builder(entry, entry->begin());
+
+        llvm::Value *rows = entry_builder.CreateCall(get_rows_type, get_rows, { get_table(relation) });
+        llvm::Value *begin = entry_builder.CreateLoad(int_type,
+            entry_builder.CreateGEP(int_type, ranges, get_int(2 * k)));
+        llvm::Value *end = entry_builder.CreateLoad(int_type,
+            entry_builder.CreateGEP(int_type, ranges, get_int(2 * k + 1)));
+
+        AllocaInst *counter = entry_builder.CreateAlloca(int_type);
+
+        llvm::Value *bucket = NULL;
+        llvm::Value *limit = end;
+
+        if (step.mask == 0) {
+            builder.CreateStore(begin, counter);
+        } else {
+            for (unsigned int i = 0; i < step.key.size(); i++) {
+                builder.CreateStore(get_argument(step.key[i]),
+                                    builder.CreateGEP(int_type, key, get_int(i)));
+            }
+
+            bucket = builder.CreateCall(lookup_type, lookup, {
+                get_table(relation), get_int(step.index), get_int(step.key.size()), key, count
+            });
+
+            limit = builder.CreateLoad(int_type, count);
+            builder.CreateStore(get_int(0), counter);
+        }
+
+        BasicBlock *header = BasicBlock::Create(ctx, "step" + std::to_string(k), function);
+        BasicBlock *body = BasicBlock::Create(ctx, "", function);
+        BasicBlock *latch = BasicBlock::Create(ctx, "", function);
+
+        builder.CreateBr(header);
+
+        builder.SetInsertPoint(header);
+        llvm::Value *position = builder.CreateLoad(int_type, counter);
+        builder.CreateCondBr(builder.CreateICmpULT(position, limit), body, next);
+
+        builder.SetInsertPoint(latch);
+        builder.CreateStore(builder.CreateAdd(builder.CreateLoad(int_type, counter), get_int(1)), counter);
+        builder.CreateBr(header);
+
+        builder.SetInsertPoint(body);
+        next = latch;
+
+        llvm::Value *id = position;
+
+        if (bucket) {
+            // indices are not sorted by row id, so the range is checked per row
+            id = builder.CreateLoad(int_type, builder.CreateGEP(int_type, bucket, position));
+            require(builder.CreateAnd(builder.CreateICmpUGE(id, begin), builder.CreateICmpULT(id, end)));
+        }
+
+        llvm::Value *row = builder.CreateGEP(int_type, rows,
+            builder.CreateMul(builder.CreateZExt(id, int64_type), ConstantInt::get(int64_type, arity)));
+
+        auto get_column = [&] (unsigned int col) {
+            return builder.CreateLoad(int_type, builder.CreateGEP(int_type, row, get_int(col)));
+        };
+
+        for (auto const &bind: step.binds) {
+            builder.CreateStore(get_column(bind.first), slots[bind.second]);
+        }
+
+        for (auto const &check: step.checks) {
+            require(builder.CreateICmpEQ(get_column(check.first),
+                                         builder.CreateLoad(int_type, slots[check.second])));
+        }
+    }
+
+    for (unsigned int i: plan.negations) {
+        const NativeBackend::Atom &atom = plan.rule->body[i];
+
+        store_tuple(atom);
+        require(builder.CreateICmpEQ(
+            builder.CreateCall(contains_type, contains, { get_table(atom.relation), tuple }),
+            get_int(0)));
+    }
+
+    const NativeBackend::Atom &head = plan.rule->head;
+
+    store_tuple(head);
+    builder.CreateCall(emit_type, emit, {
+        get_pointer(&backend, opaque_ptr_type), get_int(head.relation), tuple, output
+    });
+    builder.CreateBr(next);
+
+    builder.SetInsertPoint(exit);
+    builder.CreateRetVoid();
+
+    return function;
+}
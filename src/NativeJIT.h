@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include "NativeBackend.h"
+
+/**
+ * JIT compiler for the join plans of NativeBackend
+ *
+ * A plan is lowered to a function doing the same as NativeBackend::join,
+ * with the steps unrolled into nested loops, the variables in registers
+ * and the tables, columns and constants baked in. Index lookups, negations
+ * and derived tuples still go through the tables by calling back into the
+ * helpers below, whose addresses are embedded in the code
+ *
+ * Only built with DATALOG_AA_JIT, since it needs ORC in the host process
+ */
+class NativeJIT {
+    llvm::orc::ThreadSafeContext context;
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+
+    unsigned int num_plans = 0;
+    double compile_time = 0; // in seconds
+
+public:
+    NativeJIT();
+
+    /**
+     * Compile the plans as one module and set their entry points
+     */
+    void compile(const NativeBackend &backend, std::vector<NativeBackend::JoinPlan> &plans);
+
+    unsigned int getNumPlans() const { return num_plans; }
+    double getCompileTime() const { return compile_time; }
+
+private:
+    llvm::Function *emitPlan(llvm::Module &module, const NativeBackend &backend,
+                             const NativeBackend::JoinPlan &plan);
+
+    /**
+     * Helpers called by the compiled plans
+     */
+
+    static const NativeBackend::Value *getRows(const NativeBackend::Table *table);
+
+    /**
+     * Ids of the rows matching the key (see NativeBackend::Table::lookup)
+     */
+    static const unsigned int *lookup(const NativeBackend::Table *table, unsigned int index,
+                                      unsigned int prefix_length, const NativeBackend::Value *key,
+                                      unsigned int *count);
+
+    static unsigned int contains(const NativeBackend::Table *table, const NativeBackend::Value *tuple);
+
+    static void emit(const NativeBackend *backend, unsigned int relation,
+                     const NativeBackend::Value *tuple, NativeBackend::Buffer *output);
+};
@@ -0,0 +1,548 @@
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "llvm/Support/FileSystem.h"
+
+#include "ProgramImage.h"
+
+using namespace llvm;
+
+static const char MAGIC[8] = { 'D', 'L', 'O', 'G', 'I', 'M', 'G', '\0' };
+
+static uint64_t align(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+/**
+ * Writing
+ */
+
+namespace {
+
+/**
+ * Arrays of an image being written, with symbols numbered
+ * in the order they are first used
+ */
+struct ImageBuilder {
+    std::map<Symbol, uint32_t> symbol_ids;
+    std::vector<uint32_t> symbol_offsets;
+    std::string symbol_names;
+
+    std::vector<ProgramImage::Sort> sorts;
+    std::vector<ProgramImage::Relation> relations;
+    std::vector<uint32_t> argument_sorts;
+    std::vector<ProgramImage::Top> tops;
+    std::vector<ProgramImage::Formula> formulas;
+    std::vector<ProgramImage::Atom> atoms;
+    std::vector<ProgramImage::Term> terms;
+    std::vector<ProgramImage::FactBlock> fact_blocks;
+
+    uint32_t getSymbol(const Symbol &symbol) {
+        auto found = symbol_ids.find(symbol);
+
+        if (found != symbol_ids.end()) {
+            return found->second;
+        }
+
+        uint32_t id = symbol_offsets.size();
+
+        symbol_ids.insert(std::make_pair(symbol, id));
+        symbol_offsets.push_back(symbol_names.size());
+        symbol_names.append(symbol.str());
+        symbol_names.push_back('\0');
+
+        return id;
+    }
+
+    uint32_t addAtom(const StandardDatalog::Formula &atom) {
+        atoms.push_back({ getSymbol(atom.getRelationName()), atom.isNegated(),
+                          (uint32_t)terms.size(), atom.getArity() });
+
+        for (auto const &term: atom.getArguments()) {
+            if (term.isVariable()) {
+                terms.push_back({ 1, getSymbol(term.getVariable()) });
+            } else {
+                terms.push_back({ 0, term.getValue() });
+            }
+        }
+
+        return atoms.size() - 1;
+    }
+};
+
+}
+
+void ProgramImage::write(const StandardDatalog::Program &program, raw_ostream &out) {
+    ImageBuilder builder;
+
+    for (auto const &item: program.getSorts()) {
+        builder.sorts.push_back({ builder.getSymbol(item.first), item.second.getSize() });
+    }
+
+    for (auto const &item: program.getRelations()) {
+        const StandardDatalog::Relation &relation = item.second;
+
+        builder.relations.push_back({
+            builder.getSymbol(item.first),
+            (uint32_t)relation.getArgumentSortNames().size(),
+            (uint32_t)builder.argument_sorts.size(),
+            (uint32_t)builder.tops.size(),
+            (uint32_t)relation.getTops().size()
+        });
+
+        for (auto const &sort: relation.getArgumentSortNames()) {
+            builder.argument_sorts.push_back(builder.getSymbol(sort));
+        }
+
+        for (auto const &top: relation.getTops()) {
+            builder.tops.push_back({ top.first, top.second.value, builder.getSymbol(top.second.domain) });
+        }
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        uint32_t head = builder.addAtom(formula);
+        uint32_t first_atom = builder.atoms.size();
+
+        for (auto const &atom: formula.getBody()) {
+            builder.addAtom(atom);
+        }
+
+        builder.formulas.push_back({ head, first_atom, (uint32_t)formula.getBody().size() });
+    }
+
+    std::vector<const StandardDatalog::FactTable *> tables;
+
+    for (auto const &item: program.getFacts()) {
+        if (item.second->size() != 0) {
+            builder.fact_blocks.push_back({ builder.getSymbol(item.first), item.second->getArity(),
+                                            item.second->size(), 0 });
+            tables.push_back(item.second.get());
+        }
+    }
+
+    Header header = {};
+    uint64_t offset = align(sizeof(Header));
+
+    auto place = [&] (uint64_t bytes) {
+        uint64_t start = offset;
+        offset = align(offset + bytes);
+        return start;
+    };
+
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.byte_order = BYTE_ORDER_MARK;
+    header.version = VERSION;
+    header.num_symbols = builder.symbol_offsets.size();
+    header.num_sorts = builder.sorts.size();
+    header.num_relations = builder.relations.size();
+    header.num_tops = builder.tops.size();
+    header.num_formulas = builder.formulas.size();
+    header.num_atoms = builder.atoms.size();
+    header.num_terms = builder.terms.size();
+    header.num_fact_blocks = builder.fact_blocks.size();
+    header.num_argument_sorts = builder.argument_sorts.size();
+
+    header.symbol_offsets = place(builder.symbol_offsets.size() * sizeof(uint32_t));
+    header.symbol_names = place(builder.symbol_names.size());
+    header.symbol_names_size = builder.symbol_names.size();
+    header.sorts = place(builder.sorts.size() * sizeof(Sort));
+    header.relations = place(builder.relations.size() * sizeof(Relation));
+    header.argument_sorts = place(builder.argument_sorts.size() * sizeof(uint32_t));
+    header.tops = place(builder.tops.size() * sizeof(Top));
+    header.formulas = place(builder.formulas.size() * sizeof(Formula));
+    header.atoms = place(builder.atoms.size() * sizeof(Atom));
+    header.terms = place(builder.terms.size() * sizeof(Term));
+    header.fact_blocks = place(builder.fact_blocks.size() * sizeof(FactBlock));
+
+    for (auto &block: builder.fact_blocks) {
+        block.columns = place(block.arity * block.num_rows * sizeof(uint32_t));
+    }
+
+    header.size = offset;
+
+    uint64_t written = 0;
+
+    auto write_array = [&] (uint64_t start, const void *array, size_t bytes) {
+        out.write_zeros(start - written);
+        out.write(static_cast<const char *>(array), bytes);
+        written = start + bytes;
+    };
+
+    write_array(0, &header, sizeof(Header));
+    write_array(header.symbol_offsets, builder.symbol_offsets.data(), builder.symbol_offsets.size() * sizeof(uint32_t));
+    write_array(header.symbol_names, builder.symbol_names.data(), builder.symbol_names.size());
+    write_array(header.sorts, builder.sorts.data(), builder.sorts.size() * sizeof(Sort));
+    write_array(header.relations, builder.relations.data(), builder.relations.size() * sizeof(Relation));
+    write_array(header.argument_sorts, builder.argument_sorts.data(), builder.argument_sorts.size() * sizeof(uint32_t));
+    write_array(header.tops, builder.tops.data(), builder.tops.size() * sizeof(Top));
+    write_array(header.formulas, builder.formulas.data(), builder.formulas.size() * sizeof(Formula));
+    write_array(header.atoms, builder.atoms.data(), builder.atoms.size() * sizeof(Atom));
+    write_array(header.terms, builder.terms.data(), builder.terms.size() * sizeof(Term));
+    write_array(header.fact_blocks, builder.fact_blocks.data(), builder.fact_blocks.size() * sizeof(FactBlock));
+
+    // rows are stored by column, one block per relation
+    std::vector<uint32_t> column;
+
+    for (unsigned int i = 0; i < tables.size(); i++) {
+        const StandardDatalog::FactTable &table = *tables[i];
+        uint64_t start = builder.fact_blocks[i].columns;
+
+        column.resize(table.size());
+
+        for (unsigned int col = 0; col < table.getArity(); col++) {
+            for (size_t row = 0; row < table.size(); row++) {
+                column[row] = table.getRow(row)[col];
+            }
+
+            write_array(start + col * table.size() * sizeof(uint32_t), column.data(), column.size() * sizeof(uint32_t));
+        }
+    }
+
+    out.write_zeros(header.size - written);
+}
+
+bool ProgramImage::write(const StandardDatalog::Program &program, const std::string &path, raw_ostream &errors) {
+    std::error_code error;
+    raw_fd_ostream out(path, error, sys::fs::F_None);
+
+    if (error) {
+        errors << "cannot open " << path << ": " << error.message() << "\n";
+        return false;
+    }
+
+    write(program, out);
+    out.close();
+
+    if (out.has_error()) {
+        errors << "cannot write " << path << ": " << out.error().message() << "\n";
+        out.clear_error();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Reading
+ */
+
+bool ProgramImage::open(const std::string &path, raw_ostream &errors) {
+    close();
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+
+    if (file < 0 || fstat(file, &status) != 0) {
+        errors << "cannot open " << path << ": " << std::strerror(errno) << "\n";
+
+        if (file >= 0) {
+            ::close(file);
+        }
+
+        return false;
+    }
+
+    void *image = status.st_size ? mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    ::close(file);
+
+    if (image == MAP_FAILED) {
+        errors << "cannot map " << path << ": " << (status.st_size ? std::strerror(errno) : "empty file") << "\n";
+        return false;
+    }
+
+    data = static_cast<const char *>(image);
+    size = status.st_size;
+    mapped = true;
+
+    if (!check(errors)) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool ProgramImage::open(const char *image, size_t image_size, raw_ostream &errors) {
+    close();
+
+    data = image;
+    size = image_size;
+
+    if (!check(errors)) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void ProgramImage::close() {
+    if (mapped) {
+        munmap(const_cast<char *>(data), size);
+    }
+
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+/**
+ * An image is only read after every array and every index
+ * into them has been checked, so a truncated or corrupted
+ * file is rejected instead of read out of bounds
+ */
+bool ProgramImage::check(raw_ostream &errors) const {
+    if (size < sizeof(Header) || std::memcmp(getHeader().magic, MAGIC, sizeof(MAGIC)) != 0) {
+        errors << "not a program image\n";
+        return false;
+    }
+
+    const Header &header = getHeader();
+
+    if (header.byte_order != BYTE_ORDER_MARK) {
+        errors << "program image of another byte order\n";
+        return false;
+    }
+
+    if (header.version != VERSION) {
+        errors << "program image of version " << header.version << ", expected " << VERSION << "\n";
+        return false;
+    }
+
+    if (header.size != size) {
+        errors << "program image of " << size << " bytes, expected " << header.size << "\n";
+        return false;
+    }
+
+    bool valid = true;
+
+    auto check_array = [&] (const char *name, uint64_t offset, uint64_t count, uint64_t element_size) {
+        if (offset % 8 != 0 || offset > size || count > (size - offset) / element_size) {
+            errors << "array of " << name << " out of the image\n";
+            valid = false;
+        }
+    };
+
+    check_array("symbol offsets", header.symbol_offsets, header.num_symbols, sizeof(uint32_t));
+    check_array("symbol names", header.symbol_names, header.symbol_names_size, 1);
+    check_array("sorts", header.sorts, header.num_sorts, sizeof(Sort));
+    check_array("relations", header.relations, header.num_relations, sizeof(Relation));
+    check_array("argument sorts", header.argument_sorts, header.num_argument_sorts, sizeof(uint32_t));
+    check_array("tops", header.tops, header.num_tops, sizeof(Top));
+    check_array("formulas", header.formulas, header.num_formulas, sizeof(Formula));
+    check_array("atoms", header.atoms, header.num_atoms, sizeof(Atom));
+    check_array("terms", header.terms, header.num_terms, sizeof(Term));
+    check_array("fact blocks", header.fact_blocks, header.num_fact_blocks, sizeof(FactBlock));
+
+    if (!valid) {
+        return false;
+    }
+
+    const char *names = getArray<char>(header.symbol_names);
+
+    if (header.num_symbols && (header.symbol_names_size == 0 || names[header.symbol_names_size - 1] != '\0')) {
+        errors << "symbol names do not end with 0\n";
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.num_symbols; i++) {
+        if (getArray<uint32_t>(header.symbol_offsets)[i] >= header.symbol_names_size) {
+            errors << "symbol " << i << " out of the symbol names\n";
+            return false;
+        }
+    }
+
+    auto check_symbol = [&] (const char *what, uint32_t symbol) {
+        if (symbol >= header.num_symbols) {
+            errors << what << " refers to symbol " << symbol << ", out of the symbol table\n";
+            valid = false;
+        }
+    };
+
+    // arities of the relations, to check atoms and facts against
+    std::map<uint32_t, uint32_t> arities;
+
+    std::set<uint32_t> sort_names;
+
+    for (uint32_t i = 0; i < header.num_sorts; i++) {
+        check_symbol("sort", getArray<Sort>(header.sorts)[i].name);
+
+        if (!sort_names.insert(getArray<Sort>(header.sorts)[i].name).second) {
+            errors << "sort " << i << " declared twice\n";
+            valid = false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.num_relations; i++) {
+        const Relation &relation = getArray<Relation>(header.relations)[i];
+
+        check_symbol("relation", relation.name);
+
+        if (!arities.insert(std::make_pair(relation.name, relation.arity)).second) {
+            errors << "relation " << i << " declared twice\n";
+            valid = false;
+        }
+
+        if (relation.first_sort > header.num_argument_sorts ||
+            relation.arity > header.num_argument_sorts - relation.first_sort ||
+            relation.first_top > header.num_tops || relation.num_tops > header.num_tops - relation.first_top) {
+            errors << "relation " << i << " out of the argument sorts or tops\n";
+            return false;
+        }
+
+        for (uint32_t j = 0; j < relation.arity; j++) {
+            check_symbol("argument sort", getArray<uint32_t>(header.argument_sorts)[relation.first_sort + j]);
+        }
+
+        for (uint32_t j = relation.first_top; j < relation.first_top + relation.num_tops; j++) {
+            const Top &top = getArray<Top>(header.tops)[j];
+
+            check_symbol("top", top.domain);
+
+            if (top.column >= relation.arity) {
+                errors << "top of relation " << i << " out of its columns\n";
+                valid = false;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < header.num_atoms; i++) {
+        const Atom &atom = getArray<Atom>(header.atoms)[i];
+
+        if (!arities.count(atom.relation) || atom.first_term > header.num_terms ||
+            atom.num_terms > header.num_terms - atom.first_term) {
+            errors << "atom " << i << " of an undeclared relation or out of the terms\n";
+            return false;
+        }
+
+        for (uint32_t j = atom.first_term; j < atom.first_term + atom.num_terms; j++) {
+            const Term &term = getArray<Term>(header.terms)[j];
+
+            if (term.is_variable) {
+                check_symbol("variable", term.value);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < header.num_formulas; i++) {
+        const Formula &formula = getArray<Formula>(header.formulas)[i];
+
+        if (formula.head >= header.num_atoms || formula.first_atom > header.num_atoms ||
+            formula.num_atoms > header.num_atoms - formula.first_atom) {
+            errors << "formula " << i << " out of the atoms\n";
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.num_fact_blocks; i++) {
+        const FactBlock &block = getFactBlock(i);
+        auto found = arities.find(block.relation);
+
+        if (found == arities.end() || found->second != block.arity || block.num_rows > size) {
+            errors << "fact block " << i << " of an undeclared relation or of another arity\n";
+            return false;
+        }
+
+        check_array("facts", block.columns, block.arity * block.num_rows, sizeof(uint32_t));
+    }
+
+    return valid;
+}
+
+StandardDatalog::Program ProgramImage::load() const {
+    assert(data && "no image open");
+
+    const Header &header = getHeader();
+    StandardDatalog::Program program;
+
+    std::vector<Symbol> symbols;
+    symbols.reserve(header.num_symbols);
+
+    for (uint32_t i = 0; i < header.num_symbols; i++) {
+        symbols.push_back(getSymbol(i));
+    }
+
+    for (uint32_t i = 0; i < header.num_sorts; i++) {
+        const Sort &sort = getArray<Sort>(header.sorts)[i];
+        program.addSort(StandardDatalog::Sort(symbols[sort.name], sort.size));
+    }
+
+    for (uint32_t i = 0; i < header.num_relations; i++) {
+        const Relation &relation = getArray<Relation>(header.relations)[i];
+        const uint32_t *sorts = getArray<uint32_t>(header.argument_sorts) + relation.first_sort;
+        StandardDatalog::SymbolVector sort_names;
+
+        for (uint32_t j = 0; j < relation.arity; j++) {
+            sort_names.push_back(symbols[sorts[j]]);
+        }
+
+        program.addRelation(StandardDatalog::Relation(symbols[relation.name], sort_names));
+
+        for (uint32_t j = relation.first_top; j < relation.first_top + relation.num_tops; j++) {
+            const Top &top = getArray<Top>(header.tops)[j];
+            program.addTop(symbols[relation.name], top.column, top.value, symbols[top.domain]);
+        }
+    }
+
+    auto get_atom = [&] (uint32_t i) {
+        const Atom &atom = getArray<Atom>(header.atoms)[i];
+        StandardDatalog::TermVector args;
+
+        for (uint32_t j = atom.first_term; j < atom.first_term + atom.num_terms; j++) {
+            const Term &term = getArray<Term>(header.terms)[j];
+
+            if (term.is_variable) {
+                args.push_back(StandardDatalog::Term(symbols[term.value]));
+            } else {
+                args.push_back(StandardDatalog::Term(term.value));
+            }
+        }
+
+        StandardDatalog::Formula formula(symbols[atom.relation], args);
+        return atom.negated ? !formula : formula;
+    };
+
+    for (uint32_t i = 0; i < header.num_formulas; i++) {
+        const Formula &formula = getArray<Formula>(header.formulas)[i];
+        StandardDatalog::FormulaVector body;
+
+        for (uint32_t j = formula.first_atom; j < formula.first_atom + formula.num_atoms; j++) {
+            body.push_back(get_atom(j));
+        }
+
+        if (body.empty()) {
+            program.addFormula(get_atom(formula.head));
+        } else {
+            program.addFormula(StandardDatalog::Formula(get_atom(formula.head), body));
+        }
+    }
+
+    for (uint32_t i = 0; i < header.num_fact_blocks; i++) {
+        const FactBlock &block = getFactBlock(i);
+        auto table = std::make_shared<StandardDatalog::FactTable>(symbols[block.relation], block.arity);
+
+        table->reserve(block.num_rows);
+
+        for (uint64_t j = 0; j < block.num_rows; j++) {
+            unsigned int *row = table->append();
+
+            for (uint32_t col = 0; col < block.arity; col++) {
+                row[col] = getColumn(block, col)[j];
+            }
+
+            table->commit();
+        }
+
+        program.addFacts(table);
+    }
+
+    return program;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "DatalogIR.h"
+
+/**
+ * A binary image of a program (e.g. an analysis with the facts of a
+ * module), to run it again without generating the facts (see
+ * -datalog-aa-dump-program and -datalog-aa-load-program)
+ *
+ * The image is laid out to be mapped and read in place: a header with
+ * the offsets of its arrays, all of 32-bit words and aligned to 8 bytes,
+ *   - the symbol table: offsets of the names, then the names (each
+ *     ending with a 0), which everything else refers to by index
+ *   - sorts, relations with their argument sorts and tops
+ *   - formulas that are not ground facts, as atoms of terms
+ *   - a block of facts per relation, stored by column
+ * Words are in the byte order of the machine that wrote the image,
+ * which the byte order mark of the header tells
+ */
+class ProgramImage {
+public:
+    static const uint32_t VERSION = 2;
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct Header {
+        char magic[8];
+        uint32_t byte_order; // BYTE_ORDER_MARK as written
+        uint32_t version;
+        uint32_t num_symbols;
+        uint32_t num_sorts;
+        uint32_t num_relations;
+        uint32_t num_tops;
+        uint32_t num_formulas;
+        uint32_t num_atoms;
+        uint32_t num_terms;
+        uint32_t num_fact_blocks;
+        uint32_t num_argument_sorts;
+
+        // of the arrays, in bytes from the start of the image
+        uint64_t symbol_offsets;
+        uint64_t symbol_names;
+        uint64_t symbol_names_size;
+        uint64_t sorts;
+        uint64_t relations;
+        uint64_t argument_sorts;
+        uint64_t tops;
+        uint64_t formulas;
+        uint64_t atoms;
+        uint64_t terms;
+        uint64_t fact_blocks;
+        uint64_t size; // of the whole image
+    };
+
+    struct Sort {
+        uint32_t name;
+        uint32_t size;
+    };
+
+    struct Relation {
+        uint32_t name;
+        uint32_t arity;
+        uint32_t first_sort; // in argument_sorts
+        uint32_t first_top; // in tops
+        uint32_t num_tops;
+    };
+
+    struct Top {
+        uint32_t column;
+        uint32_t value;
+        uint32_t domain;
+    };
+
+    // a head and its body, as in ProgramTable
+    struct Formula {
+        uint32_t head;
+        uint32_t first_atom;
+        uint32_t num_atoms;
+    };
+
+    struct Atom {
+        uint32_t relation;
+        uint32_t negated;
+        uint32_t first_term;
+        uint32_t num_terms;
+    };
+
+    struct Term {
+        uint32_t is_variable;
+        uint32_t value; // or the symbol of the variable
+    };
+
+    struct FactBlock {
+        uint32_t relation;
+        uint32_t arity;
+        uint64_t num_rows;
+        uint64_t columns; // offset of arity columns of num_rows values
+    };
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+
+    const Header &getHeader() const { return *reinterpret_cast<const Header *>(data); }
+
+    template<typename T>
+    const T *getArray(uint64_t offset) const { return reinterpret_cast<const T *>(data + offset); }
+
+    bool check(llvm::raw_ostream &errors) const;
+
+public:
+    ProgramImage() {}
+    ~ProgramImage() { close(); }
+
+    ProgramImage(const ProgramImage &) = delete;
+    ProgramImage &operator=(const ProgramImage &) = delete;
+
+    /**
+     * Write the image of a program, or return false (with the error) if
+     * the file cannot be written
+     */
+    static bool write(const StandardDatalog::Program &program, const std::string &path,
+                      llvm::raw_ostream &errors);
+
+    static void write(const StandardDatalog::Program &program, llvm::raw_ostream &out);
+
+    /**
+     * Map an image, or return false (with the error) if it cannot
+     * be read or is not a valid image of this version
+     */
+    bool open(const std::string &path, llvm::raw_ostream &errors);
+
+    /**
+     * Read an image in memory, which must stay valid and aligned to 8 bytes
+     */
+    bool open(const char *image, size_t image_size, llvm::raw_ostream &errors);
+
+    void close();
+
+    uint32_t getNumSymbols() const { return getHeader().num_symbols; }
+
+    const char *getSymbol(uint32_t i) const {
+        return getArray<char>(getHeader().symbol_names) + getArray<uint32_t>(getHeader().symbol_offsets)[i];
+    }
+
+    uint32_t getNumFactBlocks() const { return getHeader().num_fact_blocks; }
+    const FactBlock &getFactBlock(uint32_t i) const { return getArray<FactBlock>(getHeader().fact_blocks)[i]; }
+
+    /**
+     * Values of a column of a fact block, read in place
+     */
+    const uint32_t *getColumn(const FactBlock &block, unsigned int column) const {
+        return getArray<uint32_t>(block.columns) + column * block.num_rows;
+    }
+
+    /**
+     * Build the program of the image (the facts are copied
+     * into the fact tables of the program)
+     */
+    StandardDatalog::Program load() const;
+};
@@ -0,0 +1,381 @@
+#include <functional>
+#include <map>
+
+#include "ProgramOptimizer.h"
+
+/**
+ * Program with the same sorts and relations, and only
+ * the formulas a predicate accepts (or replaces)
+ */
+template<typename Function>
+static StandardDatalog::Program rebuild(const StandardDatalog::Program &program, Function keep) {
+    StandardDatalog::Program rebuilt;
+
+    for (auto const &item: program.getSorts()) {
+        rebuilt.addSort(item.second);
+    }
+
+    for (auto const &item: program.getRelations()) {
+        rebuilt.addRelation(item.second);
+    }
+
+    for (auto const &item: program.getFacts()) {
+        rebuilt.addFacts(item.second);
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        StandardDatalog::Formula result = formula;
+
+        if (keep(formula, result)) {
+            rebuilt.addFormula(result);
+        }
+    }
+
+    return rebuilt;
+}
+
+static unsigned int countRules(const StandardDatalog::Program &program) {
+    unsigned int num_rules = 0;
+
+    for (auto const &formula: program.getFormulas()) {
+        num_rules += !formula.isAtom();
+    }
+
+    return num_rules;
+}
+
+bool EmptyRelationElimination::run(StandardDatalog::Program &program, const std::set<std::string> &) {
+    std::set<std::string> nonempty;
+
+    for (auto const &item: program.getFacts()) {
+        if (item.second->size() != 0) {
+            nonempty.insert(item.first);
+        }
+    }
+
+    // a rule may fire once all of its positive atoms may hold
+    // (negated atoms are ignored, which only keeps more rules)
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (auto const &formula: program.getFormulas()) {
+            if (formula.isAtom() || nonempty.count(formula.getRelationName())) {
+                continue;
+            }
+
+            bool can_fire = true;
+
+            for (auto const &atom: formula.getBody()) {
+                can_fire &= atom.isNegated() || nonempty.count(atom.getRelationName());
+            }
+
+            if (can_fire) {
+                nonempty.insert(formula.getRelationName());
+                changed = true;
+            }
+        }
+    }
+
+    bool modified = false;
+
+    program = rebuild(program, [&] (const StandardDatalog::Formula &formula, StandardDatalog::Formula &result) {
+        if (formula.isAtom()) {
+            return true;
+        }
+
+        StandardDatalog::FormulaVector body;
+
+        for (auto const &atom: formula.getBody()) {
+            if (nonempty.count(atom.getRelationName())) {
+                body.push_back(atom);
+            } else if (!atom.isNegated()) {
+                modified = true;
+                return false;
+            }
+        }
+
+        if (body.size() != formula.getBody().size()) {
+            result = StandardDatalog::Formula(formula.getRelationName(), formula.getArguments(), body);
+            modified = true;
+        }
+
+        return true;
+    });
+
+    return modified;
+}
+
+bool RuleInlining::run(StandardDatalog::Program &program, const std::set<std::string> &outputs) {
+    std::map<std::string, unsigned int> num_rules;
+    std::set<std::string> with_facts;
+    std::set<std::string> negated;
+    std::set<std::string> recursive;
+
+    for (auto const &item: program.getFacts()) {
+        if (item.second->size() != 0) {
+            with_facts.insert(item.first);
+        }
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        if (formula.isAtom()) {
+            continue;
+        }
+
+        num_rules[formula.getRelationName()]++;
+
+        for (auto const &atom: formula.getBody()) {
+            if (atom.isNegated()) {
+                negated.insert(atom.getRelationName());
+            }
+        }
+    }
+
+    for (auto const &stratum: program.getStrata()) {
+        if (stratum.recursive) {
+            recursive.insert(stratum.relations.begin(), stratum.relations.end());
+        }
+    }
+
+    // single rules of the relations to inline
+    std::map<std::string, StandardDatalog::Formula> definitions;
+
+    for (auto const &formula: program.getFormulas()) {
+        const std::string &name = formula.getRelationName();
+
+        if (!formula.isAtom() && num_rules[name] == 1 && !with_facts.count(name) &&
+            !negated.count(name) && !recursive.count(name) && !outputs.count(name)) {
+            definitions.insert(std::make_pair(name, formula));
+        }
+    }
+
+    if (definitions.empty()) {
+        return false;
+    }
+
+    // definitions are inlined into each other first, which terminates
+    // since they are not recursive (a definition may become false)
+    std::set<std::string> unsatisfiable;
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (auto &item: definitions) {
+            if (unsatisfiable.count(item.first)) {
+                continue;
+            }
+
+            const StandardDatalog::FormulaVector &body = item.second.getBody();
+
+            for (unsigned int i = 0; i < body.size(); i++) {
+                auto found = definitions.find(body[i].getRelationName());
+
+                if (found == definitions.end()) {
+                    continue;
+                }
+
+                StandardDatalog::Formula result = item.second;
+
+                if (unsatisfiable.count(found->first) || !inlineAtom(item.second, found->second, i, result)) {
+                    unsatisfiable.insert(item.first);
+                } else {
+                    item.second = result;
+                }
+
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    program = rebuild(program, [&] (const StandardDatalog::Formula &formula, StandardDatalog::Formula &result) {
+        if (formula.isAtom() || definitions.count(formula.getRelationName())) {
+            // the definitions are now unused (and removed
+            // later as dead relations with no rules)
+            return formula.isAtom();
+        }
+
+        // atoms are replaced from the last so that
+        // the positions of the others do not move
+        const StandardDatalog::FormulaVector &body = formula.getBody();
+
+        for (unsigned int i = body.size(); i-- > 0;) {
+            auto found = definitions.find(body[i].getRelationName());
+
+            if (found == definitions.end()) {
+                continue;
+            }
+
+            if (unsatisfiable.count(found->first) || !inlineAtom(result, found->second, i, result)) {
+                return false;
+            }
+        }
+
+        return true;
+    });
+
+    return true;
+}
+
+bool RuleInlining::inlineAtom(const StandardDatalog::Formula &rule, const StandardDatalog::Formula &definition,
+                              unsigned int position, StandardDatalog::Formula &result) {
+    // variables of the definition are renamed apart (user
+    // symbols cannot start with an underscore, see DatalogDSL.h)
+    std::string prefix = "_inline" + std::to_string(num_inlined++) + "_";
+
+    std::map<std::string, StandardDatalog::Term> substitution;
+
+    auto rename = [&] (const StandardDatalog::Term &term) {
+        return term.isVariable() ? StandardDatalog::Term(prefix + term.getVariable()) : term;
+    };
+
+    std::function<StandardDatalog::Term (const StandardDatalog::Term &)> resolve =
+        [&] (const StandardDatalog::Term &term) {
+        if (!term.isVariable()) {
+            return term;
+        }
+
+        auto found = substitution.find(term.getVariable());
+        return found == substitution.end() ? term : resolve(found->second);
+    };
+
+    const StandardDatalog::Formula &atom = rule.getBody()[position];
+
+    for (unsigned int i = 0; i < atom.getArity(); i++) {
+        StandardDatalog::Term a = resolve(atom.getArgument(i));
+        StandardDatalog::Term b = resolve(rename(definition.getArgument(i)));
+
+        if (a.isVariable()) {
+            if (!b.isVariable() || b.getVariable() != a.getVariable()) {
+                substitution.insert(std::make_pair(a.getVariable(), b));
+            }
+        } else if (b.isVariable()) {
+            substitution.insert(std::make_pair(b.getVariable(), a));
+        } else if (a.getValue() != b.getValue()) {
+            return false;
+        }
+    }
+
+    auto substitute = [&] (const StandardDatalog::Formula &formula, bool renamed) {
+        StandardDatalog::TermVector args;
+
+        for (auto const &term: formula.getArguments()) {
+            args.push_back(resolve(renamed ? rename(term) : term));
+        }
+
+        StandardDatalog::Formula substituted(formula.getRelationName(), args);
+        return formula.isNegated() ? substituted.negate() : substituted;
+    };
+
+    StandardDatalog::FormulaVector body;
+
+    for (unsigned int i = 0; i < rule.getBody().size(); i++) {
+        if (i != position) {
+            body.push_back(substitute(rule.getBody()[i], false));
+            continue;
+        }
+
+        for (auto const &inlined: definition.getBody()) {
+            body.push_back(substitute(inlined, true));
+        }
+    }
+
+    result = StandardDatalog::Formula(rule.getRelationName(), substitute(rule, false).getArguments(), body);
+    return true;
+}
+
+bool DeadRelationElimination::run(StandardDatalog::Program &program, const std::set<std::string> &outputs) {
+    std::set<std::string> live;
+    std::vector<std::string> worklist;
+
+    for (auto const &name: outputs) {
+        if (program.hasRelation(name)) {
+            live.insert(name);
+            worklist.push_back(name);
+        }
+    }
+
+    std::map<std::string, std::vector<const StandardDatalog::Formula *>> rules_of;
+
+    for (auto const &formula: program.getFormulas()) {
+        if (!formula.isAtom()) {
+            rules_of[formula.getRelationName()].push_back(&formula);
+        }
+    }
+
+    while (!worklist.empty()) {
+        std::string name = worklist.back();
+        worklist.pop_back();
+
+        for (auto const *rule: rules_of[name]) {
+            for (auto const &atom: rule->getBody()) {
+                if (live.insert(atom.getRelationName()).second) {
+                    worklist.push_back(atom.getRelationName());
+                }
+            }
+        }
+    }
+
+    if (live.size() == program.getRelations().size()) {
+        return false;
+    }
+
+    StandardDatalog::Program rebuilt;
+
+    for (auto const &item: program.getSorts()) {
+        rebuilt.addSort(item.second);
+    }
+
+    for (auto const &item: program.getRelations()) {
+        if (live.count(item.first)) {
+            rebuilt.addRelation(item.second);
+        }
+    }
+
+    for (auto const &item: program.getFacts()) {
+        if (live.count(item.first)) {
+            rebuilt.addFacts(item.second);
+        }
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        if (live.count(formula.getRelationName())) {
+            rebuilt.addFormula(formula);
+        }
+    }
+
+    program = rebuilt;
+    return true;
+}
+
+ProgramOptimizer::ProgramOptimizer(const std::set<std::string> &outputs): outputs(outputs) {
+    addPass(new EmptyRelationElimination());
+    addPass(new RuleInlining());
+    addPass(new DeadRelationElimination());
+}
+
+void ProgramOptimizer::run(StandardDatalog::Program &program) {
+    num_rules_before = countRules(program);
+    num_relations_before = program.getRelations().size();
+
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (auto const &pass: passes) {
+            changed |= pass->run(program, outputs);
+        }
+    }
+
+    num_rules_after = countRules(program);
+    num_relations_after = program.getRelations().size();
+}
+
+void ProgramOptimizer::printStatistics(llvm::raw_ostream &out) const {
+    out << "optimized rules: " << num_rules_before << " -> " << num_rules_after
+        << ", relations: " << num_relations_before << " -> " << num_relations_after << "\n";
+}
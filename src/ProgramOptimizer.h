@@ -0,0 +1,101 @@
+#pragma once
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "DatalogIR.h"
+
+/**
+ * A transformation of a program that preserves
+ * the contents of the output relations
+ */
+class ProgramPass {
+public:
+    virtual ~ProgramPass() {}
+
+    virtual const char *getName() const = 0;
+
+    /**
+     * Returns true if the program changed
+     */
+    virtual bool run(StandardDatalog::Program &program, const std::set<std::string> &outputs) = 0;
+};
+
+/**
+ * Specializes the rules to the facts: a relation is empty if it
+ * has no facts and none of its rules can fire, i.e. each has a
+ * positive atom of an empty relation. Such rules are dropped, and
+ * so are the negated atoms of empty relations (which always hold)
+ */
+class EmptyRelationElimination: public ProgramPass {
+public:
+    const char *getName() const override { return "empty relations"; }
+    bool run(StandardDatalog::Program &program, const std::set<std::string> &outputs) override;
+};
+
+/**
+ * Replaces the positive atoms of a relation defined by a single
+ * non-recursive rule (and no facts) with the body of that rule,
+ * e.g. load(p, q) <<= instrLoad(p, q). Relations used under a
+ * negation are kept, since a negated body is not an atom
+ */
+class RuleInlining: public ProgramPass {
+    unsigned int num_inlined = 0; // for fresh variable names
+
+public:
+    const char *getName() const override { return "inlining"; }
+    bool run(StandardDatalog::Program &program, const std::set<std::string> &outputs) override;
+
+private:
+    /**
+     * Inline a rule into the atom at a position of a body.
+     * Returns false if the atom cannot unify with the head
+     * of the rule (so that the body can never hold)
+     */
+    bool inlineAtom(const StandardDatalog::Formula &rule, const StandardDatalog::Formula &definition,
+                    unsigned int position, StandardDatalog::Formula &result);
+};
+
+/**
+ * Removes the relations that the outputs do not depend on,
+ * together with their rules and facts
+ */
+class DeadRelationElimination: public ProgramPass {
+public:
+    const char *getName() const override { return "dead relations"; }
+    bool run(StandardDatalog::Program &program, const std::set<std::string> &outputs) override;
+};
+
+/**
+ * Runs a pipeline of passes to a fixpoint before a program is
+ * loaded into a backend. Only the output relations may be queried
+ * afterwards, and only with the facts the program was optimized for
+ */
+class ProgramOptimizer {
+    std::set<std::string> outputs;
+    std::vector<std::unique_ptr<ProgramPass>> passes;
+
+    unsigned int num_rules_before = 0;
+    unsigned int num_relations_before = 0;
+    unsigned int num_rules_after = 0;
+    unsigned int num_relations_after = 0;
+
+public:
+    /**
+     * The default pipeline: empty relations, inlining, dead relations
+     */
+    ProgramOptimizer(const std::set<std::string> &outputs);
+
+    void addPass(ProgramPass *pass) { passes.emplace_back(pass); }
+
+    void run(StandardDatalog::Program &program);
+
+    /**
+     * Rules and relations before and after (for -datalog-aa-print-stats)
+     */
+    void printStatistics(llvm::raw_ostream &out) const;
+};
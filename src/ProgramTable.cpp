@@ -0,0 +1,51 @@
+#include "ProgramTable.h"
+
+StandardDatalog::Program ProgramTable::load() const {
+    StandardDatalog::Program program;
+
+    for (unsigned int i = 0; i < num_sorts; i++) {
+        program.addSort(StandardDatalog::Sort(sorts[i].name, sorts[i].size));
+    }
+
+    for (unsigned int i = 0; i < num_relations; i++) {
+        StandardDatalog::SymbolVector sort_vector(sort_names + relations[i].first_sort,
+                                                  sort_names + relations[i].first_sort + relations[i].arity);
+        program.addRelation(StandardDatalog::Relation(relations[i].name, sort_vector));
+    }
+
+    for (unsigned int i = 0; i < num_tops; i++) {
+        program.addTop(relations[tops[i].relation].name, tops[i].column,
+                       tops[i].value, relations[tops[i].domain].name);
+    }
+
+    auto get_atom = [&] (unsigned int i) {
+        StandardDatalog::TermVector args;
+
+        for (unsigned int j = atoms[i].first_term; j < atoms[i].first_term + atoms[i].num_terms; j++) {
+            if (terms[j].variable) {
+                args.push_back(StandardDatalog::Term(Symbol(terms[j].variable)));
+            } else {
+                args.push_back(StandardDatalog::Term(terms[j].value));
+            }
+        }
+
+        StandardDatalog::Formula atom(relations[atoms[i].relation].name, args);
+        return atoms[i].negated ? !atom : atom;
+    };
+
+    for (unsigned int i = 0; i < num_formulas; i++) {
+        StandardDatalog::FormulaVector body;
+
+        for (unsigned int j = formulas[i].first_atom; j < formulas[i].first_atom + formulas[i].num_atoms; j++) {
+            body.push_back(get_atom(j));
+        }
+
+        if (body.empty()) {
+            program.addFormula(get_atom(formulas[i].head));
+        } else {
+            program.addFormula(StandardDatalog::Formula(get_atom(formulas[i].head), body));
+        }
+    }
+
+    return program;
+}
@@ -0,0 +1,67 @@
+/**
+ * A datalog program as constant arrays, generated by datalog-compile
+ * from the DSL (see Compiler/TableEmitter.h), so that the analysis
+ * programs built into the plugin take no work to initialize. The
+ * program itself is only built when an analysis is selected
+ */
+
+#pragma once
+
+#include "DatalogIR.h"
+
+struct ProgramTable {
+    struct Sort {
+        const char *name;
+        unsigned int size;
+    };
+
+    struct Relation {
+        const char *name;
+        unsigned int first_sort; // in sort_names
+        unsigned int arity;
+    };
+
+    struct Top {
+        unsigned int relation;
+        unsigned int column;
+        unsigned int value;
+        unsigned int domain; // relation
+    };
+
+    // a variable, or a value if the name is null
+    struct Term {
+        const char *variable;
+        unsigned int value;
+    };
+
+    struct Atom {
+        unsigned int relation;
+        bool negated;
+        unsigned int first_term; // in terms
+        unsigned int num_terms;
+    };
+
+    // a head and its body, or a fact if the body is empty
+    struct Formula {
+        unsigned int head; // in atoms
+        unsigned int first_atom; // of the body, in atoms
+        unsigned int num_atoms;
+    };
+
+    const Sort *sorts;
+    unsigned int num_sorts;
+
+    const char *const *sort_names; // arguments of the relations
+    const Relation *relations;
+    unsigned int num_relations;
+
+    const Top *tops;
+    unsigned int num_tops;
+
+    const Term *terms;
+    const Atom *atoms;
+    const Formula *formulas;
+    unsigned int num_formulas;
+
+    StandardDatalog::Program load() const;
+};
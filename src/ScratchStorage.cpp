@@ -0,0 +1,177 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ScratchStorage.h"
+
+/**
+ * Scratch files are only needed when the system is short of memory,
+ * so failing to create or map one is not recoverable
+ */
+static void fail(const char *what) {
+    std::cerr << "scratch storage: " << what << ": " << std::strerror(errno) << std::endl;
+    std::abort();
+}
+
+/**
+ * ScratchSpace
+ */
+
+ScratchSpace::ScratchSpace(size_t memory_limit, const std::string &directory):
+    memory_limit(memory_limit), directory(directory) {
+    if (this->directory.empty()) {
+        const char *tmpdir = std::getenv("TMPDIR");
+        this->directory = tmpdir && *tmpdir ? tmpdir : "/tmp";
+    }
+}
+
+bool ScratchSpace::allocate(size_t bytes) {
+    size_t used = heap_bytes.load();
+
+    do {
+        if (memory_limit != 0 && used + bytes > memory_limit) {
+            return false;
+        }
+    } while (!heap_bytes.compare_exchange_weak(used, used + bytes));
+
+    return true;
+}
+
+void ScratchSpace::release(size_t bytes) {
+    heap_bytes -= bytes;
+}
+
+int ScratchSpace::createFile() {
+    std::string path = directory + "/datalog-aa-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+
+    int file = mkstemp(name.data());
+
+    if (file == -1) {
+        fail(("cannot create a file in " + directory).c_str());
+    }
+
+    unlink(name.data());
+    num_files++;
+
+    return file;
+}
+
+void ScratchSpace::addMapped(size_t bytes) {
+    size_t total = mapped_bytes += bytes;
+    size_t peak = peak_mapped_bytes.load();
+
+    while (total > peak && !peak_mapped_bytes.compare_exchange_weak(peak, total));
+}
+
+void ScratchSpace::removeMapped(size_t bytes) {
+    mapped_bytes -= bytes;
+}
+
+/**
+ * ScratchBuffer
+ */
+
+ScratchBuffer::~ScratchBuffer() {
+    reset();
+}
+
+void ScratchBuffer::swap(ScratchBuffer &other) {
+    std::swap(space, other.space);
+    std::swap(data, other.data);
+    std::swap(capacity, other.capacity);
+    std::swap(mapped, other.mapped);
+}
+
+void ScratchBuffer::reserve(size_t new_capacity, size_t size) {
+    assert(size <= capacity && "size out of range");
+
+    if (new_capacity <= capacity) {
+        return;
+    }
+
+    if (!space) {
+        char *new_data = (char *)std::realloc(data, new_capacity);
+
+        if (!new_data) {
+            fail("out of memory");
+        }
+
+        data = new_data;
+        capacity = new_capacity;
+        return;
+    }
+
+    // once mapped, a buffer stays in scratch files
+    if (!isMapped() && space->allocate(new_capacity)) {
+        char *new_data = (char *)std::realloc(data, new_capacity);
+
+        if (!new_data) {
+            fail("out of memory");
+        }
+
+        space->release(capacity);
+        data = new_data;
+        capacity = new_capacity;
+        return;
+    }
+
+    map(new_capacity, size);
+}
+
+void ScratchBuffer::map(size_t new_capacity, size_t size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    new_capacity = (new_capacity + page_size - 1) / page_size * page_size;
+
+    int file = space->createFile();
+
+    if (ftruncate(file, new_capacity) != 0) {
+        fail("cannot resize a file");
+    }
+
+    void *new_data = mmap(NULL, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+
+    if (new_data == MAP_FAILED) {
+        fail("cannot map a file");
+    }
+
+    close(file);
+    std::copy(data, data + size, (char *)new_data);
+
+    if (mapped) {
+        munmap(data, capacity);
+        space->removeMapped(capacity);
+    } else {
+        std::free(data);
+        space->release(capacity);
+    }
+
+    data = (char *)new_data;
+    capacity = new_capacity;
+    mapped = true;
+    space->addMapped(capacity);
+}
+
+void ScratchBuffer::reset() {
+    if (mapped) {
+        munmap(data, capacity);
+        space->removeMapped(capacity);
+        mapped = false;
+    } else {
+        std::free(data);
+
+        if (space) {
+            space->release(capacity);
+        }
+    }
+
+    data = NULL;
+    capacity = 0;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+ * A budget for the memory taken by large arrays (see ScratchArray)
+ *
+ * Arrays are allocated on the heap while the total fits in the limit,
+ * and in memory-mapped files in a scratch directory past it. Mapped
+ * pages are written back and evicted by the kernel under memory
+ * pressure, so evaluation slows down instead of running out of memory
+ */
+class ScratchSpace {
+    size_t memory_limit; // in bytes, 0 for no limit
+    std::string directory;
+
+    std::atomic<size_t> heap_bytes { 0 };
+    std::atomic<size_t> mapped_bytes { 0 };
+    std::atomic<size_t> peak_mapped_bytes { 0 };
+    std::atomic<unsigned int> num_files { 0 };
+
+public:
+    /**
+     * An empty directory means $TMPDIR (or /tmp)
+     */
+    ScratchSpace(size_t memory_limit, const std::string &directory = "");
+
+    size_t getMemoryLimit() const { return memory_limit; }
+    const std::string &getDirectory() const { return directory; }
+
+    /**
+     * Take bytes on the heap from the budget, or return false if over the limit
+     */
+    bool allocate(size_t bytes);
+    void release(size_t bytes);
+
+    /**
+     * Create a file in the scratch directory, already unlinked
+     * so that it's removed when closed, and return its descriptor
+     */
+    int createFile();
+
+    void addMapped(size_t bytes);
+    void removeMapped(size_t bytes);
+
+    size_t getPeakMappedBytes() const { return peak_mapped_bytes; }
+    unsigned int getNumFiles() const { return num_files; }
+};
+
+/**
+ * Untyped storage of a ScratchArray: a block on the heap, or
+ * a shared mapping of a scratch file once the budget is used up
+ *
+ * The file is closed as soon as it's mapped (the mapping keeps it
+ * alive), and growing a mapped buffer maps a new file, so the number
+ * of open files does not grow with the number of buffers
+ */
+class ScratchBuffer {
+    ScratchSpace *space;
+    char *data = NULL;
+    size_t capacity = 0; // in bytes
+    bool mapped = false;
+
+public:
+    /**
+     * Without a space, the buffer is always on the heap
+     */
+    ScratchBuffer(ScratchSpace *space): space(space) {}
+    ~ScratchBuffer();
+
+    ScratchBuffer(ScratchBuffer &&other): space(other.space) { swap(other); }
+    ScratchBuffer(const ScratchBuffer &) = delete;
+    ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+
+    void swap(ScratchBuffer &other);
+
+    char *getData() const { return data; }
+    size_t getCapacity() const { return capacity; }
+    bool isMapped() const { return mapped; }
+
+    /**
+     * Grow to at least the given capacity, keeping the first size bytes
+     */
+    void reserve(size_t new_capacity, size_t size);
+
+    /**
+     * Release all storage
+     */
+    void reset();
+
+private:
+    void map(size_t new_capacity, size_t size);
+};
+
+/**
+ * A growable array of trivially copyable values in a ScratchBuffer,
+ * with the part of the interface of std::vector the tables use
+ */
+template<typename T>
+class ScratchArray {
+    static_assert(std::is_trivially_copyable<T>::value, "values are copied as bytes");
+
+    ScratchBuffer buffer;
+    size_t length = 0;
+
+public:
+    ScratchArray(ScratchSpace *space = NULL): buffer(space) {}
+
+    ScratchArray(ScratchArray &&other): buffer(std::move(other.buffer)), length(other.length) {
+        other.length = 0;
+    }
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    bool isMapped() const { return buffer.isMapped(); }
+
+    T *data() { return (T *)buffer.getData(); }
+    const T *data() const { return (const T *)buffer.getData(); }
+
+    T *begin() { return data(); }
+    T *end() { return data() + length; }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + length; }
+
+    T &operator[](size_t i) {
+        assert(i < length && "index out of range");
+        return data()[i];
+    }
+
+    const T &operator[](size_t i) const {
+        assert(i < length && "index out of range");
+        return data()[i];
+    }
+
+    void reserve(size_t capacity) {
+        if (capacity * sizeof(T) > buffer.getCapacity()) {
+            buffer.reserve(capacity * sizeof(T), length * sizeof(T));
+        }
+    }
+
+    void push_back(const T &value) {
+        append(&value, 1);
+    }
+
+    void append(const T *values, size_t count) {
+        if ((length + count) * sizeof(T) > buffer.getCapacity()) {
+            reserve(std::max(length + count, length * 2));
+        }
+
+        std::copy(values, values + count, data() + length);
+        length += count;
+    }
+
+    void assign(size_t count, const T &value) {
+        length = 0;
+        reserve(count);
+        std::fill(data(), data() + count, value);
+        length = count;
+    }
+
+    /**
+     * Values past the old size are left uninitialized
+     */
+    void resize(size_t count) {
+        reserve(count);
+        length = count;
+    }
+
+    void clear() { length = 0; }
+
+    void swap(ScratchArray &other) {
+        buffer.swap(other.buffer);
+        std::swap(length, other.length);
+    }
+};
@@ -0,0 +1,477 @@
+#include <algorithm>
+
+#include "SetKernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SET_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Scalar kernels
+ */
+
+static size_t intersectScalar(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+
+    while (i < size_a && j < size_b) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+
+    return k;
+}
+
+static size_t mergeScalar(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+
+    while (i < size_a && j < size_b) {
+        if (a[i] < b[j]) {
+            out[k++] = a[i++];
+        } else if (a[i] > b[j]) {
+            out[k++] = b[j++];
+        } else {
+            out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+
+    k = std::copy(a + i, a + size_a, out + k) - out;
+    k = std::copy(b + j, b + size_b, out + k) - out;
+
+    return k;
+}
+
+static size_t differenceScalar(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+
+    while (i < size_a && j < size_b) {
+        if (a[i] < b[j]) {
+            out[k++] = a[i++];
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    return std::copy(a + i, a + size_a, out + k) - out;
+}
+
+static bool intersectsScalar(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b) {
+    size_t i = 0, j = 0;
+
+    while (i < size_a && j < size_b) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#ifdef SET_KERNELS_X86
+
+/**
+ * Shuffles packing the 32-bit lanes selected by a mask
+ * to the front: pshufb controls for 4 lanes, and
+ * vpermd indices for 8 lanes
+ */
+
+struct PackTables {
+    uint8_t shuffles[16][16];
+    uint32_t permutations[256][8];
+
+    PackTables() {
+        for (unsigned int mask = 0; mask < 16; mask++) {
+            unsigned int k = 0;
+
+            for (unsigned int lane = 0; lane < 4; lane++) {
+                if (mask & (1u << lane)) {
+                    for (unsigned int byte = 0; byte < 4; byte++) {
+                        shuffles[mask][k * 4 + byte] = lane * 4 + byte;
+                    }
+
+                    k++;
+                }
+            }
+
+            // the rest is garbage beyond the size returned
+            for (; k < 4; k++) {
+                for (unsigned int byte = 0; byte < 4; byte++) {
+                    shuffles[mask][k * 4 + byte] = 0x80;
+                }
+            }
+        }
+
+        for (unsigned int mask = 0; mask < 256; mask++) {
+            unsigned int k = 0;
+
+            for (unsigned int lane = 0; lane < 8; lane++) {
+                if (mask & (1u << lane)) {
+                    permutations[mask][k++] = lane;
+                }
+            }
+
+            for (; k < 8; k++) {
+                permutations[mask][k] = 0;
+            }
+        }
+    }
+};
+
+static const PackTables pack_tables;
+
+/**
+ * SSE4.2 kernels
+ */
+
+// mask of the lanes of a equal to some lane of b
+__attribute__((target("sse4.2")))
+static inline unsigned int matchSSE(__m128i a, __m128i b) {
+    __m128i match = _mm_cmpeq_epi32(a, b);
+    match = _mm_or_si128(match, _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1))));
+    match = _mm_or_si128(match, _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))));
+    match = _mm_or_si128(match, _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3))));
+
+    return _mm_movemask_ps(_mm_castsi128_ps(match));
+}
+
+// store the lanes of a mask to the front of out, returns their number
+// (a whole block is written if out has room for it before the end)
+__attribute__((target("sse4.2")))
+static inline size_t packSSE(__m128i values, unsigned int mask, uint32_t *out, const uint32_t *end) {
+    __m128i shuffle = _mm_loadu_si128((const __m128i *)pack_tables.shuffles[mask]);
+    __m128i packed = _mm_shuffle_epi8(values, shuffle);
+    size_t count = __builtin_popcount(mask);
+
+    if (out + 4 <= end) {
+        _mm_storeu_si128((__m128i *)out, packed);
+    } else {
+        uint32_t block[4];
+        _mm_storeu_si128((__m128i *)block, packed);
+        std::copy(block, block + count, out);
+    }
+
+    return count;
+}
+
+__attribute__((target("sse4.2")))
+static size_t intersectSSE(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+    const uint32_t *end = out + std::min(size_a, size_b);
+
+    while (i + 4 <= size_a && j + 4 <= size_b) {
+        __m128i block_a = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i block_b = _mm_loadu_si128((const __m128i *)(b + j));
+
+        k += packSSE(block_a, matchSSE(block_a, block_b), out + k, end);
+
+        uint32_t max_a = a[i + 3], max_b = b[j + 3];
+        i += max_a <= max_b ? 4 : 0;
+        j += max_b <= max_a ? 4 : 0;
+    }
+
+    return k + intersectScalar(a + i, size_a - i, b + j, size_b - j, out + k);
+}
+
+__attribute__((target("sse4.2")))
+static size_t differenceSSE(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+    unsigned int found = 0; // lanes of the block of a found in b so far
+
+    while (i + 4 <= size_a && j + 4 <= size_b) {
+        __m128i block_a = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i block_b = _mm_loadu_si128((const __m128i *)(b + j));
+
+        found |= matchSSE(block_a, block_b);
+
+        uint32_t max_a = a[i + 3], max_b = b[j + 3];
+
+        if (max_a <= max_b) {
+            k += packSSE(block_a, ~found & 0xf, out + k, out + size_a);
+            found = 0;
+            i += 4;
+        }
+
+        j += max_b <= max_a ? 4 : 0;
+    }
+
+    // the rest of the block of a may have been found already
+    for (size_t block = i; i < size_a; i++) {
+        while (j < size_b && b[j] < a[i]) {
+            j++;
+        }
+
+        bool in_block = i - block < 4 && (found & (1u << (i - block)));
+
+        if (!in_block && (j == size_b || b[j] != a[i])) {
+            out[k++] = a[i];
+        }
+    }
+
+    return k;
+}
+
+__attribute__((target("sse4.2")))
+static bool intersectsSSE(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b) {
+    size_t i = 0, j = 0;
+
+    while (i + 4 <= size_a && j + 4 <= size_b) {
+        __m128i block_a = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i block_b = _mm_loadu_si128((const __m128i *)(b + j));
+
+        if (matchSSE(block_a, block_b)) {
+            return true;
+        }
+
+        uint32_t max_a = a[i + 3], max_b = b[j + 3];
+        i += max_a <= max_b ? 4 : 0;
+        j += max_b <= max_a ? 4 : 0;
+    }
+
+    return intersectsScalar(a + i, size_a - i, b + j, size_b - j);
+}
+
+// sort a bitonic sequence of 4
+__attribute__((target("sse4.2")))
+static inline __m128i bitonicSortSSE(__m128i values) {
+    __m128i swapped = _mm_shuffle_epi32(values, _MM_SHUFFLE(1, 0, 3, 2));
+    values = _mm_blend_epi16(_mm_min_epu32(values, swapped), _mm_max_epu32(values, swapped), 0xf0);
+
+    swapped = _mm_shuffle_epi32(values, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_blend_epi16(_mm_min_epu32(values, swapped), _mm_max_epu32(values, swapped), 0xcc);
+}
+
+__attribute__((target("sse4.2")))
+static size_t mergeSSE(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    if (size_a < 4 || size_b < 4) {
+        return mergeScalar(a, size_a, b, size_b, out);
+    }
+
+    __m128i low = _mm_loadu_si128((const __m128i *)a);
+    __m128i high = _mm_loadu_si128((const __m128i *)b);
+    size_t i = 4, j = 4, k = 0;
+
+    // anything but the first id
+    uint32_t last = std::min(a[0], b[0]) - 1;
+
+    while (true) {
+        // the 4 smallest of both blocks in low, the 4 largest in high
+        __m128i reversed = _mm_shuffle_epi32(high, _MM_SHUFFLE(0, 1, 2, 3));
+        __m128i min = _mm_min_epu32(low, reversed);
+        __m128i max = _mm_max_epu32(low, reversed);
+
+        low = bitonicSortSSE(min);
+        high = bitonicSortSSE(max);
+
+        // store low without the ids equal to the one before
+        __m128i before = _mm_alignr_epi8(low, _mm_set1_epi32(last), 12);
+        unsigned int duplicates = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(low, before)));
+
+        k += packSSE(low, ~duplicates & 0xf, out + k, out + size_a + size_b);
+        last = _mm_extract_epi32(low, 3);
+
+        // the next block comes from the side with the smaller next id
+        // (all ids left are then at least those stored), unless
+        // that side has less than a block left
+        bool from_a = j == size_b || (i < size_a && a[i] <= b[j]);
+
+        if (from_a ? i + 4 > size_a : j + 4 > size_b) {
+            break;
+        }
+
+        low = _mm_loadu_si128((const __m128i *)(from_a ? a + i : b + j));
+        (from_a ? i : j) += 4;
+    }
+
+    // merge the rest of both sides with the last block
+    uint32_t rest[4];
+    size_t r = 0;
+
+    _mm_storeu_si128((__m128i *)rest, high);
+
+    while (r < 4 || i < size_a || j < size_b) {
+        uint32_t next = ~0u;
+
+        if (r < 4) next = std::min(next, rest[r]);
+        if (i < size_a) next = std::min(next, a[i]);
+        if (j < size_b) next = std::min(next, b[j]);
+
+        if (r < 4 && rest[r] == next) r++;
+        if (i < size_a && a[i] == next) i++;
+        if (j < size_b && b[j] == next) j++;
+
+        if (next != last) {
+            out[k++] = last = next;
+        }
+    }
+
+    return k;
+}
+
+/**
+ * AVX2 kernels (the union is that of SSE4.2)
+ */
+
+__attribute__((target("avx2")))
+static inline unsigned int matchAVX2(__m256i a, __m256i b) {
+    // rotations within the 128-bit lanes of b, and of b with them swapped
+    __m256i swapped = _mm256_permute2x128_si256(b, b, 1);
+
+    __m256i match = _mm256_cmpeq_epi32(a, b);
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1))));
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))));
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3))));
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(a, swapped));
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(swapped, _MM_SHUFFLE(0, 3, 2, 1))));
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(swapped, _MM_SHUFFLE(1, 0, 3, 2))));
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(a, _mm256_shuffle_epi32(swapped, _MM_SHUFFLE(2, 1, 0, 3))));
+
+    return _mm256_movemask_ps(_mm256_castsi256_ps(match));
+}
+
+__attribute__((target("avx2")))
+static inline size_t packAVX2(__m256i values, unsigned int mask, uint32_t *out, const uint32_t *end) {
+    __m256i permutation = _mm256_loadu_si256((const __m256i *)pack_tables.permutations[mask]);
+    __m256i packed = _mm256_permutevar8x32_epi32(values, permutation);
+    size_t count = __builtin_popcount(mask);
+
+    if (out + 8 <= end) {
+        _mm256_storeu_si256((__m256i *)out, packed);
+    } else {
+        uint32_t block[8];
+        _mm256_storeu_si256((__m256i *)block, packed);
+        std::copy(block, block + count, out);
+    }
+
+    return count;
+}
+
+__attribute__((target("avx2")))
+static size_t intersectAVX2(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+    const uint32_t *end = out + std::min(size_a, size_b);
+
+    while (i + 8 <= size_a && j + 8 <= size_b) {
+        __m256i block_a = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i block_b = _mm256_loadu_si256((const __m256i *)(b + j));
+
+        k += packAVX2(block_a, matchAVX2(block_a, block_b), out + k, end);
+
+        uint32_t max_a = a[i + 7], max_b = b[j + 7];
+        i += max_a <= max_b ? 8 : 0;
+        j += max_b <= max_a ? 8 : 0;
+    }
+
+    return k + intersectScalar(a + i, size_a - i, b + j, size_b - j, out + k);
+}
+
+__attribute__((target("avx2")))
+static size_t differenceAVX2(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out) {
+    size_t i = 0, j = 0, k = 0;
+    unsigned int found = 0;
+
+    while (i + 8 <= size_a && j + 8 <= size_b) {
+        __m256i block_a = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i block_b = _mm256_loadu_si256((const __m256i *)(b + j));
+
+        found |= matchAVX2(block_a, block_b);
+
+        uint32_t max_a = a[i + 7], max_b = b[j + 7];
+
+        if (max_a <= max_b) {
+            k += packAVX2(block_a, ~found & 0xff, out + k, out + size_a);
+            found = 0;
+            i += 8;
+        }
+
+        j += max_b <= max_a ? 8 : 0;
+    }
+
+    for (size_t block = i; i < size_a; i++) {
+        while (j < size_b && b[j] < a[i]) {
+            j++;
+        }
+
+        bool in_block = i - block < 8 && (found & (1u << (i - block)));
+
+        if (!in_block && (j == size_b || b[j] != a[i])) {
+            out[k++] = a[i];
+        }
+    }
+
+    return k;
+}
+
+__attribute__((target("avx2")))
+static bool intersectsAVX2(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b) {
+    size_t i = 0, j = 0;
+
+    while (i + 8 <= size_a && j + 8 <= size_b) {
+        __m256i block_a = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i block_b = _mm256_loadu_si256((const __m256i *)(b + j));
+
+        if (matchAVX2(block_a, block_b)) {
+            return true;
+        }
+
+        uint32_t max_a = a[i + 7], max_b = b[j + 7];
+        i += max_a <= max_b ? 8 : 0;
+        j += max_b <= max_a ? 8 : 0;
+    }
+
+    return intersectsScalar(a + i, size_a - i, b + j, size_b - j);
+}
+
+#endif // SET_KERNELS_X86
+
+static const SetKernels scalar_kernels = {
+    "scalar", intersectScalar, mergeScalar, differenceScalar, intersectsScalar
+};
+
+#ifdef SET_KERNELS_X86
+static const SetKernels sse_kernels = {
+    "sse4.2", intersectSSE, mergeSSE, differenceSSE, intersectsSSE
+};
+
+static const SetKernels avx2_kernels = {
+    "avx2", intersectAVX2, mergeSSE, differenceAVX2, intersectsAVX2
+};
+#endif
+
+std::vector<const SetKernels *> SetKernels::getSupported() {
+    std::vector<const SetKernels *> supported = { &scalar_kernels };
+
+#ifdef SET_KERNELS_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse4.2")) {
+        supported.push_back(&sse_kernels);
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        supported.push_back(&avx2_kernels);
+    }
+#endif
+
+    return supported;
+}
+
+const SetKernels &SetKernels::get() {
+    static const SetKernels *kernels = getSupported().back();
+    return *kernels;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Kernels on sorted sets of 32-bit ids (strictly increasing arrays)
+ *
+ * Each kernel writes its result to an output array, which must have room
+ * for the largest possible result (the smaller input for an intersection,
+ * the first for a difference and both for a union), and returns its size.
+ * The output must not overlap the inputs
+ *
+ * The SSE4.2 and AVX2 versions compare blocks of 4 or 8 ids of both
+ * inputs all against all, then pack the ids kept with a shuffle, and
+ * the union merges blocks of 4 with a bitonic network. On other targets,
+ * or CPUs without these extensions, scalar versions are used
+ */
+struct SetKernels {
+    const char *name;
+
+    size_t (*intersect)(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out);
+    size_t (*merge)(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out);
+    size_t (*difference)(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b, uint32_t *out);
+
+    /**
+     * If the sets have an id in common (without materializing the intersection)
+     */
+    bool (*intersects)(const uint32_t *a, size_t size_a, const uint32_t *b, size_t size_b);
+
+    /**
+     * The kernels of the widest extension the CPU supports, chosen once
+     */
+    static const SetKernels &get();
+
+    /**
+     * All kernels the CPU supports, from scalar to the widest
+     */
+    static std::vector<const SetKernels *> getSupported();
+};
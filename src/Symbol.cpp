@@ -0,0 +1,70 @@
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Symbol.h"
+
+std::atomic<const std::string *> Symbol::chunks[Symbol::MAX_CHUNKS];
+
+namespace {
+    /**
+     * Ids of the names interned, and the chunks of
+     * names they are stored in (id 0 is not stored)
+     */
+    struct SymbolTable {
+        std::mutex mutex;
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<std::string *> chunks;
+        uint32_t num_symbols = 1;
+    };
+
+    // constructed on first use, since symbols are
+    // created by the initializers of other statics
+    SymbolTable &getTable() {
+        static SymbolTable table;
+        return table;
+    }
+}
+
+uint32_t Symbol::intern(const std::string &name) {
+    if (name.empty()) {
+        return 0;
+    }
+
+    SymbolTable &table = getTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    auto found = table.ids.find(name);
+
+    if (found != table.ids.end()) {
+        return found->second;
+    }
+
+    uint32_t id = table.num_symbols++;
+    unsigned int chunk = id >> CHUNK_BITS;
+
+    assert(chunk < MAX_CHUNKS && "too many symbols");
+
+    if (chunk == table.chunks.size()) {
+        table.chunks.push_back(new std::string[1 << CHUNK_BITS]);
+        chunks[chunk].store(table.chunks.back(), std::memory_order_release);
+    }
+
+    table.chunks[chunk][id & ((1 << CHUNK_BITS) - 1)] = name;
+    table.ids.insert(std::make_pair(name, id));
+
+    return id;
+}
+
+const std::string &Symbol::getEmptyName() {
+    static const std::string empty;
+    return empty;
+}
+
+size_t Symbol::getNumSymbols() {
+    SymbolTable &table = getTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    return table.num_symbols;
+}
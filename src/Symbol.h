@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+/**
+ * A name interned in a global symbol table, copied and compared for
+ * equality as a 32-bit id (the symbol type of StandardDatalog)
+ *
+ * Symbols convert to and from strings, so that code written for
+ * strings keeps working. They are ordered by their ids, i.e. in the
+ * order they were first interned, which is not the same from one
+ * process to another: where the order is seen, entries are sorted
+ * by name (see sortByName). Interning takes a lock, but looking up
+ * the name of a symbol does not, and names are never freed
+ */
+class Symbol {
+    static const unsigned int CHUNK_BITS = 12;
+    static const unsigned int MAX_CHUNKS = 1 << 16;
+
+    // names by id, in chunks that never move once allocated
+    static std::atomic<const std::string *> chunks[MAX_CHUNKS];
+
+    uint32_t id = 0; // of the empty name
+
+    static uint32_t intern(const std::string &name);
+    static const std::string &getEmptyName();
+
+public:
+    Symbol() {}
+    Symbol(const std::string &name): id(intern(name)) {}
+    Symbol(const char *name): id(intern(name)) {}
+
+    uint32_t getID() const { return id; }
+
+    const std::string &str() const {
+        if (id == 0) {
+            return getEmptyName();
+        }
+
+        return chunks[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & ((1 << CHUNK_BITS) - 1)];
+    }
+
+    operator const std::string &() const { return str(); }
+
+    bool empty() const { return id == 0; }
+    const char *c_str() const { return str().c_str(); }
+
+    /**
+     * Number of distinct names interned so far
+     */
+    static size_t getNumSymbols();
+
+    bool operator==(const Symbol &other) const { return id == other.id; }
+    bool operator!=(const Symbol &other) const { return id != other.id; }
+
+    bool operator<(const Symbol &other) const { return id < other.id; }
+    bool operator>(const Symbol &other) const { return other < *this; }
+    bool operator<=(const Symbol &other) const { return !(other < *this); }
+    bool operator>=(const Symbol &other) const { return !(*this < other); }
+};
+
+inline bool operator==(const Symbol &symbol, const std::string &name) { return symbol.str() == name; }
+inline bool operator==(const std::string &name, const Symbol &symbol) { return symbol.str() == name; }
+inline bool operator==(const Symbol &symbol, const char *name) { return symbol.str() == name; }
+inline bool operator==(const char *name, const Symbol &symbol) { return symbol.str() == name; }
+inline bool operator!=(const Symbol &symbol, const std::string &name) { return symbol.str() != name; }
+inline bool operator!=(const std::string &name, const Symbol &symbol) { return symbol.str() != name; }
+inline bool operator!=(const Symbol &symbol, const char *name) { return symbol.str() != name; }
+inline bool operator!=(const char *name, const Symbol &symbol) { return symbol.str() != name; }
+
+inline std::string operator+(const Symbol &symbol, const std::string &suffix) { return symbol.str() + suffix; }
+inline std::string operator+(const std::string &prefix, const Symbol &symbol) { return prefix + symbol.str(); }
+inline std::string operator+(const Symbol &symbol, const char *suffix) { return symbol.str() + suffix; }
+inline std::string operator+(const char *prefix, const Symbol &symbol) { return prefix + symbol.str(); }
+
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &out, const Symbol &symbol) { return out << symbol.str(); }
+inline std::ostream &operator<<(std::ostream &out, const Symbol &symbol) { return out << symbol.str(); }
+
+/**
+ * Entries of a map keyed by symbols, in the order of their names
+ */
+template<typename T>
+std::vector<const std::pair<const Symbol, T> *> sortByName(const std::map<Symbol, T> &map) {
+    std::vector<const std::pair<const Symbol, T> *> entries;
+
+    for (auto const &entry: map) {
+        entries.push_back(&entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [] (const std::pair<const Symbol, T> *a,
+                                                  const std::pair<const Symbol, T> *b) {
+        return a->first.str() < b->first.str();
+    });
+
+    return entries;
+}
+
+namespace std {
+    template<>
+    struct hash<Symbol> {
+        size_t operator()(const Symbol &symbol) const { return symbol.getID(); }
+    };
+}
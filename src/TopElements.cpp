@@ -0,0 +1,310 @@
+#include <cassert>
+#include <map>
+#include <set>
+
+#include "TopElements.h"
+
+#define MAX_OCCURRENCES 16
+
+using Formula = StandardDatalog::Formula;
+using FormulaVector = StandardDatalog::FormulaVector;
+using Term = StandardDatalog::Term;
+using TermVector = StandardDatalog::TermVector;
+
+TopElements::TopElements(const StandardDatalog::Program &program, bool expand):
+    program(program), expand(expand) {
+    for (auto const &item: program.getSorts()) {
+        rewritten.addSort(item.second);
+    }
+
+    // the same relations, without their tops
+    for (auto const &item: program.getRelations()) {
+        rewritten.addRelation(StandardDatalog::Relation(item.first, item.second.getArgumentSortNames()));
+    }
+
+    for (auto const &item: program.getFacts()) {
+        rewritten.addFacts(item.second);
+    }
+
+    for (auto const &formula: program.getFormulas()) {
+        if (formula.isAtom() || expand) {
+            rewritten.addFormula(formula);
+        } else {
+            rewriteRule(formula);
+        }
+    }
+
+    if (expand) {
+        for (auto const &item: program.getRelations()) {
+            addExpansion(item.second);
+        }
+    }
+}
+
+bool TopElements::hasTops(const StandardDatalog::Program &program) {
+    for (auto const &item: program.getRelations()) {
+        if (!item.second.getTops().empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TopElements::printStatistics(llvm::raw_ostream &out) const {
+    if (expand) {
+        out << "top elements: expanded by " << num_variants << " rules\n";
+    } else {
+        out << "top elements: " << num_rules << " rules -> " << num_variants << "\n";
+    }
+}
+
+const TopElements::Top *TopElements::getTop(const std::string &relation, unsigned int column) const {
+    auto const &tops = program.getRelation(relation).getTops();
+    auto found = tops.find(column);
+
+    return found == tops.end() ? NULL : &found->second;
+}
+
+bool TopElements::isExcluded(const std::string &relation, const std::string &domain) const {
+    if (program.hasFacts(domain)) {
+        return false;
+    }
+
+    bool has_rules = false;
+
+    for (auto const &formula: program.getFormulas()) {
+        if (formula.getRelationName() != domain) {
+            continue;
+        }
+
+        if (formula.isAtom() || !formula.getArgument(0).isVariable()) {
+            return false;
+        }
+
+        const std::string &value = formula.getArgument(0).getVariable();
+        bool excluded = false;
+
+        for (auto const &atom: formula.getBody()) {
+            excluded |= atom.isNegated() && atom.getRelationName() == relation && atom.getArity() == 1 &&
+                        atom.getArgument(0).isVariable() && atom.getArgument(0).getVariable() == value;
+        }
+
+        if (!excluded) {
+            return false;
+        }
+
+        has_rules = true;
+    }
+
+    return has_rules;
+}
+
+bool TopElements::isUniversal(const Formula &rule, const std::string &variable, const Top &top) const {
+    auto is_same = [&] (const Top *other) {
+        return other && other->value == top.value && other->domain == top.domain;
+    };
+
+    for (unsigned int col = 0; col < rule.getArity(); col++) {
+        const Term &term = rule.getArgument(col);
+
+        if (term.isVariable() && term.getVariable() == variable &&
+            !is_same(getTop(rule.getRelationName(), col))) {
+            return false;
+        }
+    }
+
+    for (auto const &atom: rule.getBody()) {
+        for (unsigned int col = 0; col < atom.getArity(); col++) {
+            const Term &term = atom.getArgument(col);
+
+            if (!term.isVariable() || term.getVariable() != variable) {
+                continue;
+            }
+
+            if (atom.isNegated() ? !isExcluded(atom.getRelationName(), top.domain) :
+                                   !is_same(getTop(atom.getRelationName(), col))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// user symbols cannot start with an underscore (see DatalogDSL.h)
+
+std::string TopElements::getGuard(const Top &top) {
+    std::string name = "_top_" + top.domain + "_" + std::to_string(top.value);
+
+    if (!rewritten.hasRelation(name)) {
+        rewritten.addRelation(StandardDatalog::Relation(name, program.getRelation(top.domain).getArgumentSortNames()));
+        rewritten.addFormula(Formula(name, TermVector { Term(top.value) }));
+    }
+
+    return name;
+}
+
+void TopElements::addExpansion(const StandardDatalog::Relation &relation) {
+    unsigned int arity = relation.getArgumentSortNames().size();
+
+    for (auto const &item: relation.getTops()) {
+        TermVector head_args, body_args;
+
+        for (unsigned int col = 0; col < arity; col++) {
+            Term term("x" + std::to_string(col));
+
+            head_args.push_back(term);
+            body_args.push_back(col == item.first ? Term(item.second.value) : term);
+        }
+
+        FormulaVector body {
+            Formula(relation.getName(), body_args),
+            Formula(item.second.domain, TermVector { head_args[item.first] })
+        };
+
+        rewritten.addFormula(Formula(Formula(relation.getName(), head_args), body));
+        num_variants++;
+    }
+}
+
+void TopElements::rewriteRule(const Formula &rule) {
+    const FormulaVector &body = rule.getBody();
+    std::vector<Occurrence> occurrences;
+
+    for (unsigned int i = 0; i < body.size(); i++) {
+        if (body[i].isNegated()) {
+            continue;
+        }
+
+        for (unsigned int col = 0; col < body[i].getArity(); col++) {
+            const Top *top = getTop(body[i].getRelationName(), col);
+            const Term &term = body[i].getArgument(col);
+
+            // an explicit top only matches top rows
+            if (top && (term.isVariable() || term.getValue() != top->value)) {
+                occurrences.push_back(Occurrence { i, col, top });
+            }
+        }
+    }
+
+    assert(occurrences.size() <= MAX_OCCURRENCES && "too many top columns in a rule");
+
+    num_rules++;
+
+    for (unsigned int mask = 0; mask < (1u << occurrences.size()); mask++) {
+        addVariant(rule, occurrences, mask);
+    }
+}
+
+void TopElements::addVariant(const Formula &rule, const std::vector<Occurrence> &occurrences,
+                             unsigned int mask) {
+    const FormulaVector &body = rule.getBody();
+    std::vector<TermVector> args;
+    FormulaVector extra; // domain atoms and guards
+
+    for (auto const &atom: body) {
+        args.push_back(atom.getArguments());
+    }
+
+    // occurrences of each variable
+    std::map<std::string, std::vector<unsigned int>> variables;
+
+    for (unsigned int k = 0; k < occurrences.size(); k++) {
+        const Occurrence &occurrence = occurrences[k];
+        const Term &term = body[occurrence.atom].getArgument(occurrence.column);
+
+        if (term.isVariable()) {
+            variables[term.getVariable()].push_back(k);
+        } else if (mask & (1u << k)) {
+            args[occurrence.atom][occurrence.column] = Term(occurrence.top->value);
+            extra.push_back(Formula(occurrence.top->domain, TermVector { term }));
+        }
+    }
+
+    for (auto const &item: variables) {
+        const std::string &variable = item.first;
+        const Top &top = *occurrences[item.second[0]].top;
+        std::set<std::string> domains;
+        unsigned int num_positive = 0;
+        unsigned int num_matched = 0;
+
+        for (auto const &atom: body) {
+            for (auto const &term: atom.getArguments()) {
+                num_positive += !atom.isNegated() && term.isVariable() && term.getVariable() == variable;
+            }
+        }
+
+        for (unsigned int k: item.second) {
+            num_matched += (mask >> k) & 1;
+        }
+
+        // only in top columns, so it can be the top value itself
+        bool only_top = num_positive == item.second.size();
+        bool universal = only_top && isUniversal(rule, variable, top);
+
+        if (num_matched == 0) {
+            if (only_top && !universal) {
+                extra.push_back(!Formula(getGuard(top), TermVector { Term(variable) }));
+            }
+
+            continue;
+        }
+
+        // the rule as is derives the same with the top value
+        if (num_matched == item.second.size() && universal) {
+            return;
+        }
+
+        for (unsigned int k: item.second) {
+            if (mask & (1u << k)) {
+                const Occurrence &occurrence = occurrences[k];
+
+                args[occurrence.atom][occurrence.column] = Term(occurrence.top->value);
+                domains.insert(occurrence.top->domain);
+            }
+        }
+
+        for (auto const &domain: domains) {
+            extra.push_back(Formula(domain, TermVector { Term(variable) }));
+        }
+    }
+
+    FormulaVector new_body;
+
+    for (unsigned int i = 0; i < body.size(); i++) {
+        Formula atom(body[i].getRelationName(), args[i]);
+        new_body.push_back(body[i].isNegated() ? !atom : atom);
+
+        if (!body[i].isNegated()) {
+            continue;
+        }
+
+        // a negated tuple must not be covered by a top row either
+        std::vector<std::pair<unsigned int, unsigned int>> top_columns;
+
+        for (auto const &item: program.getRelation(body[i].getRelationName()).getTops()) {
+            const Term &term = args[i][item.first];
+
+            if (term.isVariable() || term.getValue() != item.second.value) {
+                top_columns.push_back(std::make_pair(item.first, item.second.value));
+            }
+        }
+
+        for (unsigned int subset = 1; subset < (1u << top_columns.size()); subset++) {
+            TermVector top_args = args[i];
+
+            for (unsigned int j = 0; j < top_columns.size(); j++) {
+                if (subset & (1u << j)) {
+                    top_args[top_columns[j].first] = Term(top_columns[j].second);
+                }
+            }
+
+            new_body.push_back(!Formula(body[i].getRelationName(), top_args));
+        }
+    }
+
+    new_body.insert(new_body.end(), extra.begin(), extra.end());
+    rewritten.addFormula(Formula(Formula(rule.getRelationName(), rule.getArguments()), new_body));
+    num_variants++;
+}
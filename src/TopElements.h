@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DatalogIR.h"
+
+/**
+ * Rewrites the top values of relation columns (see Program::addTop)
+ * into rules over plain values, so that any backend can store them
+ *
+ * A tuple with the top value T of a column stands for the tuples with
+ * every value of the domain D of the top in that column, which then
+ * need not be derived one by one (T must not be in D). Each rule is
+ * split into variants by which occurrences of its variables in top
+ * columns of positive atoms match a top row:
+ *   - none: the rule is kept as is. A variable only in top columns may
+ *     still be T there, which derives the tuples for all of D at once:
+ *     T goes on into the head if all head columns of the variable are
+ *     tops with the same T, and its negated atoms hold for all of D
+ *     (D is only defined by rules negating that relation on their
+ *     value). Otherwise the variable is guarded against T by a relation
+ *     holding only T, and the next case covers all of its occurrences
+ *   - some: those take T and the variable ranges over D instead, e.g.
+ *     pointsToIndirectly(x, z) :- pointsTo(x, y), pointsTo(y, z) gets
+ *     pointsToIndirectly(x, z) :- pointsTo(x, T), D(y), pointsTo(y, z)
+ * Constants in top columns get a variant matching T the same way, and
+ * negated atoms on top columns also check for the top row.
+ *
+ * The rewritten program has no tops left: its top values are ordinary
+ * constants, and a query has to read them as the whole domain. The
+ * new relations start with an underscore, which the DSL reserves
+ *
+ * With expand set, the rules are kept and each tuple with a top is
+ * copied to every value of the domain instead, as a baseline that
+ * derives the same tuples as if the top was not there
+ */
+class TopElements {
+    using Top = StandardDatalog::Relation::Top;
+
+    /**
+     * A variable or constant in a top column of a positive atom
+     */
+    struct Occurrence {
+        unsigned int atom; // in the body
+        unsigned int column;
+        const Top *top;
+    };
+
+    const StandardDatalog::Program &program;
+    StandardDatalog::Program rewritten;
+
+    bool expand;
+    unsigned int num_rules = 0;
+    unsigned int num_variants = 0;
+
+public:
+    TopElements(const StandardDatalog::Program &program, bool expand = false);
+
+    const StandardDatalog::Program &getProgram() const { return rewritten; }
+
+    static bool hasTops(const StandardDatalog::Program &program);
+
+    void printStatistics(llvm::raw_ostream &out) const;
+
+private:
+    const Top *getTop(const std::string &relation, unsigned int column) const;
+
+    /**
+     * If a negated relation never holds in a domain, i.e. each rule of
+     * the domain negates it on its value (and the domain has no facts)
+     */
+    bool isExcluded(const std::string &relation, const std::string &domain) const;
+
+    /**
+     * If a variable only in top columns (of the same top) carries the
+     * top value through a rule: into top columns of the head only, and
+     * with negated atoms excluded from the domain
+     */
+    bool isUniversal(const StandardDatalog::Formula &rule, const std::string &variable, const Top &top) const;
+
+    /**
+     * Relation holding only the top value, declared on first use
+     */
+    std::string getGuard(const Top &top);
+
+    /**
+     * R(..., y, ...) <<= R(..., T, ...) & D(y) for each top column
+     */
+    void addExpansion(const StandardDatalog::Relation &relation);
+
+    void rewriteRule(const StandardDatalog::Formula &rule);
+
+    /**
+     * Add the variant of a rule whose occurrences in the
+     * mask match top rows, unless another variant covers it
+     */
+    void addVariant(const StandardDatalog::Formula &rule, const std::vector<Occurrence> &occurrences,
+                    unsigned int mask);
+};
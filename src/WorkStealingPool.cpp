@@ -0,0 +1,119 @@
+#include <cassert>
+
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned int num_threads): remaining(0) {
+    assert(num_threads > 0 && "need at least one thread");
+
+    for (unsigned int i = 0; i < num_threads; i++) {
+        workers.emplace_back(new Worker());
+    }
+
+    // worker 0 is the thread calling run()
+    for (unsigned int i = 1; i < num_threads; i++) {
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wake_up.notify_all();
+
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::run(std::vector<Task> &tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    if (workers.size() == 1) {
+        for (auto &task: tasks) {
+            task(0);
+        }
+
+        return;
+    }
+
+    remaining = tasks.size();
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+        Worker &worker = *workers[i % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(&tasks[i]);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+
+    wake_up.notify_all();
+
+    while (runOne(0));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] () { return remaining == 0; });
+}
+
+void WorkStealingPool::workerLoop(unsigned int id) {
+    unsigned long seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_up.wait(lock, [&] () { return stopping || generation != seen_generation; });
+
+            if (stopping) {
+                return;
+            }
+
+            seen_generation = generation;
+        }
+
+        while (runOne(id));
+    }
+}
+
+bool WorkStealingPool::runOne(unsigned int id) {
+    Task *task = NULL;
+
+    {
+        Worker &own = *workers[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+        }
+    }
+
+    for (unsigned int i = 1; !task && i < workers.size(); i++) {
+        Worker &victim = *workers[(id + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    (*task)(id);
+
+    if (--remaining == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.notify_all();
+    }
+
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fork-join pool of worker threads
+ *
+ * Each worker owns a deque of tasks, popping from its own
+ * back and stealing from the front of the others when it
+ * runs out of work. The thread calling run() acts as worker 0
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void (unsigned int /* worker */)>;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task *> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake_up;
+    std::condition_variable finished;
+
+    unsigned long generation = 0;
+    std::atomic<size_t> remaining;
+    bool stopping = false;
+
+public:
+    WorkStealingPool(unsigned int num_threads);
+    ~WorkStealingPool();
+
+    unsigned int getNumThreads() const { return workers.size(); }
+
+    /**
+     * Run all tasks and wait for them to finish
+     */
+    void run(std::vector<Task> &tasks);
+
+private:
+    void workerLoop(unsigned int id);
+
+    /**
+     * Pop a task from the worker's own deque or steal
+     * one from another worker. Returns false if no task
+     * is left anywhere
+     */
+    bool runOne(unsigned int id);
+};
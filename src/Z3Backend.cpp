@@ -1,5 +1,6 @@
 #include <cassert>
 #include <iostream>
+#include <set>
 
 #include "z3++.h"
 
@@ -41,7 +42,7 @@ void Z3Backend::initRelationTable() {
 
         z3::sort_vector sorts(*context);
 
-        for (const std::string &sort_name: relation.getArgumentSortNames()) {
+        for (const Symbol &sort_name: relation.getArgumentSortNames()) {
             auto found = sort_table.find(sort_name);
             assert(found != sort_table.end() && "sort doesn't exist");
             sorts.push_back(found->second);
@@ -58,32 +59,107 @@ void Z3Backend::initRelationTable() {
  * Replace the current environment with a new program
  */
 void Z3Backend::load(const StandardDatalog::Program &program) {
+    // objects of the previous context go before it
+    relation_table.clear();
+    sort_table.clear();
+    fixedpoint.reset();
+
     context.reset(new z3::context());
     fixedpoint.reset(new z3::fixedpoint(*context));
 
     this->program = program;
+    answer_cache.clear();
     var_counter = 0;
+    rule_counter = 0;
 
     initSortTable();
     initRelationTable();
 
-    unsigned int rule_counter = 0;
+    for (auto const &formula: program.getFormulas()) {
+        addRule(formula);
+    }
+
+    for (auto const &item: program.getFacts()) {
+        for (size_t i = 0; i < item.second->size(); i++) {
+            addRule(item.second->getFormula(i));
+        }
+    }
+}
+
+void Z3Backend::addRule(const StandardDatalog::Formula &formula) {
+    // scan for variables
+    z3::expr rule = emitFormula(formula);
+
+    std::string rule_name = RULE_NAME_PREFIX + formula.getRelationName() + "-" + std::to_string(rule_counter);
+    rule_counter++;
+
+    fixedpoint->add_rule(rule, context->str_symbol(rule_name.c_str()));
+}
+
+void Z3Backend::addFacts(const StandardDatalog::FormulaVector &facts) {
+    answer_cache.clear();
+
+    for (auto const &fact: facts) {
+        assert(fact.isAtom() && !fact.isNegated() && "only facts can be added");
+
+        program.addFormula(fact);
+        addRule(fact);
+    }
+}
+
+void Z3Backend::retractFacts(const StandardDatalog::FormulaVector &facts) {
+    using Tuple = std::pair<Symbol, std::vector<unsigned int>>;
+
+    auto get_tuple = [] (const StandardDatalog::Formula &fact) {
+        Tuple tuple(fact.getRelationName(), {});
+
+        for (auto const &term: fact.getArguments()) {
+            assert(!term.isVariable() && "facts must be ground");
+            tuple.second.push_back(term.getValue());
+        }
+
+        return tuple;
+    };
+
+    std::set<Tuple> retracted;
+
+    for (auto const &fact: facts) {
+        assert(fact.isAtom() && !fact.isNegated() && "only facts can be retracted");
+        retracted.insert(get_tuple(fact));
+    }
+
+    StandardDatalog::Program rest;
+
+    for (auto const &item: program.getSorts()) {
+        rest.addSort(item.second);
+    }
+
+    for (auto const &item: program.getRelations()) {
+        rest.addRelation(item.second);
+    }
 
     for (auto const &formula: program.getFormulas()) {
-        // scan for variables
+        rest.addFormula(formula);
+    }
 
-        z3::expr rule = emitFormula(formula);
+    for (auto const &item: program.getFacts()) {
+        const StandardDatalog::FactTable &table = *item.second;
 
-        std::string rule_name = RULE_NAME_PREFIX + formula.getRelationName() + "-" + std::to_string(rule_counter);
-        rule_counter++;
+        for (size_t i = 0; i < table.size(); i++) {
+            const unsigned int *row = table.getRow(i);
 
-        fixedpoint->add_rule(rule, context->str_symbol(rule_name.c_str()));
+            if (!retracted.count(Tuple(item.first, std::vector<unsigned int>(row, row + table.getArity())))) {
+                rest.addFact(item.first, row);
+            }
+        }
     }
+
+    load(rest);
 }
 
-z3::expr Z3Backend::emitAtom(std::map<std::string, z3::expr> &var_table,
+z3::expr Z3Backend::emitAtom(std::map<Symbol, z3::expr> &var_table,
                              const StandardDatalog::Formula &atom) {
-    std::string relation_name = atom.getRelationName();
+    const Symbol &relation_name = atom.getRelationName();
     const StandardDatalog::Relation &relation = program.getRelation(relation_name);
 
     z3::expr_vector args(*context);
@@ -96,7 +172,7 @@ z3::expr Z3Backend::emitAtom(std::map<std::string, z3::expr> &var_table,
             
             args.push_back(var_table.at(term.getVariable()));
         } else {
-            const std::string &arg_sort_name = relation.getArgumentSortName(idx);
+            const Symbol &arg_sort_name = relation.getArgumentSortName(idx);
             unsigned int bit_size = sort_table.at(arg_sort_name).bv_size();
             z3::expr expr = context->bv_val(term.getValue(), bit_size);
         
@@ -121,7 +197,7 @@ z3::expr Z3Backend::emitFormula(const StandardDatalog::Formula &formula) {
     // ==> forall (vars...) (f1 /\ f2 /\ f3 /\ ...) => head
     
     // collect all (free) variables
-    std::map<std::string, z3::expr> var_table;
+    std::map<Symbol, z3::expr> var_table;
     collectVariablesInFormula(var_table, formula);
 
     z3::expr head = emitAtom(var_table, formula);
@@ -152,7 +228,7 @@ z3::expr Z3Backend::emitFormula(const StandardDatalog::Formula &formula) {
     return rule;
 }
 
-void Z3Backend::collectVariablesInFormula(std::map<std::string, z3::expr> &var_table,
+void Z3Backend::collectVariablesInFormula(std::map<Symbol, z3::expr> &var_table,
                                           const StandardDatalog::Formula &formula) {
     for (unsigned int idx = 0; idx < formula.getArguments().size(); idx++) {
         collectVariablesInTerm(var_table, formula, idx);
@@ -165,17 +241,17 @@ void Z3Backend::collectVariablesInFormula(std::map<std::string, z3::expr> &var_t
     }
 }
 
-void Z3Backend::collectVariablesInTerm(std::map<std::string, z3::expr> &var_table,
+void Z3Backend::collectVariablesInTerm(std::map<Symbol, z3::expr> &var_table,
                                        const StandardDatalog::Formula &parent,
                                        unsigned int index) {
 
     const StandardDatalog::Term &term = parent.getArgument(index);
 
     if (term.isVariable()) {
-        std::string var = term.getVariable();
+        const Symbol &var = term.getVariable();
 
         if (var_table.find(var) == var_table.end()) {
-            const std::string &arg_sort_name =
+            const Symbol &arg_sort_name =
                 program.getRelation(parent.getRelationName()).getArgumentSortName(index);
 
             z3::sort var_sort = sort_table.at(arg_sort_name);
@@ -190,7 +266,24 @@ void Z3Backend::collectVariablesInTerm(std::map<std::string, z3::expr> &var_tabl
     }
 }
 
+std::vector<unsigned int> Z3Backend::getTuple(const StandardDatalog::Formula &formula) {
+    std::vector<unsigned int> tuple;
+
+    for (auto const &term: formula.getArguments()) {
+        assert(!term.isVariable() && "query must be ground");
+        tuple.push_back(term.getValue());
+    }
+
+    return tuple;
+}
+
 bool Z3Backend::query(const StandardDatalog::Formula &formula) {
+    auto cached = answer_cache.find(formula.getRelationName());
+
+    if (cached != answer_cache.end()) {
+        return cached->second.count(getTuple(formula)) != formula.isNegated();
+    }
+
     // TODO: need to make sure that the formula has no variable
 
     z3::expr query_expr = emitFormula(formula);
@@ -208,7 +301,27 @@ bool Z3Backend::query(const StandardDatalog::Formula &formula) {
     return result == z3::sat;
 }
 
-StandardDatalog::FormulaVector Z3Backend::query(const std::string &relation_name) {
+std::vector<bool> Z3Backend::query(const StandardDatalog::FormulaVector &formulas) {
+    std::vector<bool> answers;
+
+    for (auto const &formula: formulas) {
+        const Symbol &relation_name = formula.getRelationName();
+
+        if (!answer_cache.count(relation_name)) {
+            std::set<std::vector<unsigned int>> &tuples = answer_cache[relation_name];
+
+            for (auto const &fact: query(relation_name)) {
+                tuples.insert(getTuple(fact));
+            }
+        }
+
+        answers.push_back(query(formula));
+    }
+
+    return answers;
+}
+
+StandardDatalog::FormulaVector Z3Backend::query(const Symbol &relation_name) {
     assert(relation_table.find(relation_name) != relation_table.end() &&
            "relation does not exist");
 
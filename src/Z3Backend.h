@@ -1,6 +1,10 @@
 #pragma once
 
+#include <map>
 #include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
 
 #include "z3++.h"
 
@@ -9,12 +13,18 @@
 class Z3Backend: public StandardDatalog::Backend {
     std::unique_ptr<z3::context> context;
     std::unique_ptr<z3::fixedpoint> fixedpoint;
-    StandardDatalog::Program program;
+    StandardDatalog::Program program; // shares the rules and facts loaded, to retract facts
 
-    std::map<std::string, z3::sort> sort_table;
-    std::map<std::string, z3::func_decl> relation_table;
+    std::unordered_map<Symbol, z3::sort> sort_table;
+    std::unordered_map<Symbol, z3::func_decl> relation_table;
 
     unsigned int var_counter;
+    unsigned int rule_counter;
+
+    // relations materialized to answer ground queries in
+    // batches, until the facts change (see query(FormulaVector))
+    std::unordered_map<Symbol, std::set<std::vector<unsigned int>>> answer_cache;
+
 public:
     virtual ~Z3Backend() {
         Z3_finalize_memory();
@@ -22,11 +32,31 @@ public:
 
     virtual void load(const StandardDatalog::Program &program) override;
     virtual bool query(const StandardDatalog::Formula &formula) override;
-    virtual std::vector<StandardDatalog::Formula> query(const std::string &relation_name) override;
+    virtual std::vector<StandardDatalog::Formula> query(const Symbol &relation_name) override;
+
+    /**
+     * Each relation queried is solved once and kept, so the
+     * formulas are answered without a query to z3 each
+     */
+    virtual std::vector<bool> query(const StandardDatalog::FormulaVector &formulas) override;
+
+    /**
+     * The fixedpoint engine solves the program on each query, so
+     * added facts are simply added as rules. Rules cannot be removed
+     * though, so retracting facts loads the rest of the program again
+     */
+    virtual bool isIncremental() const override { return true; }
+    virtual void addFacts(const StandardDatalog::FormulaVector &facts) override;
+    virtual void retractFacts(const StandardDatalog::FormulaVector &facts) override;
 
 private:
     static unsigned int log2(unsigned int x);
 
+    /**
+     * Ground tuple of a formula
+     */
+    static std::vector<unsigned int> getTuple(const StandardDatalog::Formula &formula);
+
     /**
      * Compute the minimum sort required populate
      * the sort table
@@ -41,18 +71,20 @@ private:
     /**
      * Same as emitFormula, but ignores the body
      */
-    z3::expr emitAtom(std::map<std::string, z3::expr> &var_table,
+    z3::expr emitAtom(std::map<Symbol, z3::expr> &var_table,
                       const StandardDatalog::Formula &atom);
 
     z3::expr emitFormula(const StandardDatalog::Formula &formula);
 
+    void addRule(const StandardDatalog::Formula &formula);
+
     /**
      * Collect variables in formula and create z3 sorts/variables for them
      */
-    void collectVariablesInFormula(std::map<std::string, z3::expr> &var_table,
+    void collectVariablesInFormula(std::map<Symbol, z3::expr> &var_table,
                                    const StandardDatalog::Formula &formula);
 
-    void collectVariablesInTerm(std::map<std::string, z3::expr> &var_table,
+    void collectVariablesInTerm(std::map<Symbol, z3::expr> &var_table,
                                 const StandardDatalog::Formula &parent,
                                 unsigned int index);
 
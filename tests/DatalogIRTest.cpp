@@ -0,0 +1,188 @@
+/**
+ * Usage: datalog-ir-test <case>
+ *
+ * Builds one of the small programs below and prints what the IR
+ * says about it, to be checked by the lit tests in ir/
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "ProgramImage.h"
+
+#include "DatalogDSL.h"
+
+using namespace llvm;
+
+static void printWellFormed(const StandardDatalog::Program &program) {
+    if (program.isWellFormed(outs())) {
+        outs() << "well-formed\n";
+    } else {
+        outs() << "not well-formed\n";
+    }
+}
+
+/**
+ * Open an image in memory (aligned to 8 bytes), and print its program
+ */
+static void printImage(const std::vector<uint64_t> &words, size_t size) {
+    ProgramImage image;
+
+    if (image.open(reinterpret_cast<const char *>(words.data()), size, outs())) {
+        outs() << image.load();
+    }
+}
+
+static std::map<std::string, std::function<void ()>> cases = {
+    {
+        "stratified",
+        [] () {
+            printWellFormed(BEGIN
+                sort(V, 16);
+                rel(vertex, V);
+                rel(edge, V, V);
+                rel(path, V, V);
+                rel(unreachable, V, V);
+                var(x); var(y); var(z);
+
+                path(x, y) <<= edge(x, y);
+                path(x, z) <<= path(x, y) & edge(y, z);
+                unreachable(x, y) <<= vertex(x) & vertex(y) & !path(x, y);
+
+                fact edge(1, 2);
+            END);
+        }
+    },
+    {
+        "not-stratified",
+        [] () {
+            printWellFormed(BEGIN
+                sort(V, 16);
+                rel(vertex, V);
+                rel(even, V);
+                rel(odd, V);
+                var(x);
+
+                even(x) <<= vertex(x) & !odd(x);
+                odd(x) <<= vertex(x) & !even(x);
+            END);
+        }
+    },
+    {
+        "not-range-restricted",
+        [] () {
+            printWellFormed(BEGIN
+                sort(V, 16);
+                rel(vertex, V);
+                rel(edge, V, V);
+                rel(complete, V, V);
+                rel(isolated, V);
+                var(x); var(y);
+
+                complete(x, y) <<= vertex(x);
+                isolated(x) <<= vertex(x) & !edge(x, y);
+            END);
+        }
+    },
+    {
+        "duplicate-facts",
+        [] () {
+            StandardDatalog::Program program = BEGIN
+                sort(V, 16);
+                rel(edge, V, V);
+
+                fact edge(1, 2);
+                fact edge(1, 2);
+            END;
+
+            const StandardDatalog::Relation &edge = program.getRelation("edge");
+
+            outs() << "after the DSL: " << program.getNumFacts() << " facts, "
+                   << program.getNumDuplicateFacts() << " duplicates\n";
+
+            outs() << "add edge(2, 3): " << program.addFact(edge, 2, 3) << "\n";
+            outs() << "add edge(2, 3) again: " << program.addFact(edge, 2, 3) << "\n";
+
+            // enough rows to grow the index a few times
+            for (unsigned int i = 0; i < 100; i++) {
+                program.addFact(edge, i % 16, i / 16);
+                program.addFact(edge, i % 16, i / 16);
+            }
+
+            outs() << "after 100 twice: " << program.getNumFacts() << " facts, "
+                   << program.getNumDuplicateFacts() << " duplicates\n";
+
+            program.setDropDuplicateFacts(false);
+            outs() << "keeping duplicates, add edge(2, 3): " << program.addFact(edge, 2, 3) << "\n";
+
+            program.setDropDuplicateFacts(true);
+            outs() << "dropping them again, add edge(2, 3): " << program.addFact(edge, 2, 3) << "\n";
+            outs() << "add edge(15, 15): " << program.addFact(edge, 15, 15) << "\n";
+
+            outs() << "in the end: " << program.getNumFacts() << " facts, "
+                   << program.getNumDuplicateFacts() << " duplicates\n";
+        }
+    },
+    {
+        "image",
+        [] () {
+            StandardDatalog::Program program = BEGIN
+                sort(V, 16);
+                rel(edge, V, V);
+                rel(path, V, V);
+                var(x); var(y); var(z);
+
+                path(x, y) <<= edge(x, y);
+                path(x, z) <<= path(x, y) & edge(y, z);
+
+                fact edge(1, 2);
+                fact edge(2, 3);
+            END;
+
+            std::string text;
+            raw_string_ostream out(text);
+
+            ProgramImage::write(program, out);
+            out.flush();
+
+            std::vector<uint64_t> words((text.size() + 7) / 8);
+            std::memcpy(words.data(), text.data(), text.size());
+
+            outs() << "as written:\n";
+            printImage(words, text.size());
+
+            // as read on a machine of the other byte order
+            uint32_t swapped = 0x04030201;
+            std::memcpy(reinterpret_cast<char *>(words.data()) + offsetof(ProgramImage::Header, byte_order),
+                        &swapped, sizeof(swapped));
+
+            outs() << "swapped:\n";
+            printImage(words, text.size());
+
+            std::memcpy(words.data(), "NOTIMAGE", 8);
+
+            outs() << "without the magic:\n";
+            printImage(words, text.size());
+        }
+    },
+};
+
+#include "DatalogDSL.h" // toggle dsl off
+
+int main(int argc, char **argv) {
+    auto found = argc == 2 ? cases.find(argv[1]) : cases.end();
+
+    if (found == cases.end()) {
+        errs() << "usage: " << argv[0] << " <case>\n";
+        return 1;
+    }
+
+    found->second();
+    return 0;
+}
@@ -1,7 +1,23 @@
 ; RUN: %opt -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-jit -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-reorder-joins=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-optimize=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-join-strategy=leapfrog -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-memory-limit=1 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-update-functions=allocate,main -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=distributed -datalog-aa-processes=3 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=bdd -S < %s 2>&1 | FileCheck %s
+; RUN: not %opt -datalog-aa-backend=bdd -datalog-aa-bdd-order=Foo -S < %s 2>&1 | FileCheck %s --check-prefix=BAD-ORDER
+; RUN: %opt -datalog-aa-backend=compiled -datalog-aa-compiled-fallback=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-dump-program=%t.image -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-load-program=%t.image -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=compiled -datalog-aa-compiled-fallback=false -datalog-aa-load-program=%t.image -S < %s 2>&1 | FileCheck %s
 
 @not.me = global i32 0
 
+; BAD-ORDER: domain Foo does not exist in the BDD variable ordering (the domains are Object0,
+
 ; CHECK-DAG: @main::%c -> @allocate::%a::aff(1)
 ; CHECK-DAG: @allocate::%v -> @main::%b::aff(1)
 ; CHECK-DAG: @allocate::%r -> @allocate::%a::aff(1)
@@ -1,4 +1,14 @@
 ; RUN: %opt -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-jit -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-reorder-joins=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-optimize=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-join-strategy=leapfrog -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-memory-limit=1 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-update-functions=main -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=distributed -datalog-aa-processes=3 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=bdd -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=compiled -datalog-aa-compiled-fallback=false -S < %s 2>&1 | FileCheck %s
 
 @str.1 = constant [14 x i8] c"string object\00"
 @str.1.p = global i8* getelementptr inbounds ([14 x i8], [14 x i8]* @str.1, i32 0, i32 0)
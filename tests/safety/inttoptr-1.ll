@@ -1,4 +1,18 @@
 ; RUN: %opt -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-jit -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-reorder-joins=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-optimize=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-join-strategy=leapfrog -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-memory-limit=1 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-update-functions=main -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-top-elements=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=distributed -datalog-aa-processes=3 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=bdd -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=compiled -datalog-aa-compiled-fallback=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-dump-program=%t.image -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-load-program=%t.image -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=compiled -datalog-aa-compiled-fallback=false -datalog-aa-load-program=%t.image -S < %s 2>&1 | FileCheck %s
 
 ; declare void @llvm.memcpy.p0i8.p0i8.i32(i8*, i8*, i32, i1)
 declare void @unknown(i8*, i8*)
@@ -1,4 +1,17 @@
 ; RUN: %opt -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-jit -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-reorder-joins=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-optimize=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-join-strategy=leapfrog -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-memory-limit=1 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-update-functions=main -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=distributed -datalog-aa-processes=3 -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=bdd -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=compiled -datalog-aa-compiled-fallback=false -S < %s 2>&1 | FileCheck %s
+; RUN: %opt -datalog-aa-backend=native -datalog-aa-query=@main::%b.p1i32 -S < %s 2>&1 | FileCheck %s --check-prefix=QUERY
+; RUN: %opt -datalog-aa-query=@main::%a -datalog-aa-query-relation=alias -S < %s 2>&1 | FileCheck %s --check-prefix=ALIAS
+; RUN: %opt -datalog-aa-ground-queries=100 -S < %s 2>&1 | FileCheck %s --check-prefix=GROUND
 
 declare i8* @malloc(i32)
 declare void @llvm.memcpy.p0i8.p0i8.i32(i8*, i8*, i32, i1)
@@ -17,6 +30,20 @@ entry:
     ; CHECK-DAG: @main::%a.p0i32 -> @main::%a::aff(1)
     ; CHECK-DAG: @main::%b.p1i32 -> @main::%b::aff(1)
 
+    ; QUERY: ================== query
+    ; QUERY-NEXT: @main::%b.p1i32 -> @main::%b::aff(1)
+    ; QUERY-NEXT: ================== query
+
+    ; ALIAS: ================== query
+    ; ALIAS-DAG: @main::%a alias @main::%a
+    ; ALIAS-DAG: @main::%a alias @main::%a.p0i32
+    ; ALIAS-DAG: @main::%a alias @main::%b::aff(1)
+    ; ALIAS-DAG: @main::%a alias @main::%c::aff(1)
+    ; ALIAS: ================== query
+
+    ; GROUND-NOT: answered differently
+    ; GROUND: ground queries: 100 of alias
+
     %a.p0i32 = bitcast i8* %a to i32*
     %b.p1i32 = bitcast i8* %b to i32**
 